@@ -4,8 +4,15 @@ cbuffer constants : register(b0)
 {
     float2 window_size;
     float2 texture_size;
+    float2 offset;
+    uint   sample_mode;
 }
 
+// Keep in sync with SampleMode in renderer_d3d11.cpp
+#define SAMPLE_MODE_COLOR          0
+#define SAMPLE_MODE_DISTANCE_FIELD 1
+#define SAMPLE_MODE_COVERAGE       2
+
 struct InputData
 {
     float2 position   : POS;
@@ -34,8 +41,10 @@ Interpolators vs_main(InputData i)
     pos.y *= -1;
     pos = (pos + 1) / 2;
     pos *= window_size;
-    pos.x = clamp(pos.x, i.dst_rect.x, i.dst_rect.x + i.dst_rect.z);
-    pos.y = clamp(pos.y, i.dst_rect.y, i.dst_rect.y + i.dst_rect.w);
+    float4 dst_rect = i.dst_rect;
+    dst_rect.xy += offset;
+    pos.x = clamp(pos.x, dst_rect.x, dst_rect.x + dst_rect.z);
+    pos.y = clamp(pos.y, dst_rect.y, dst_rect.y + dst_rect.w);
     pos /= window_size;
     pos *= 2;
     pos -= 1;
@@ -54,9 +63,21 @@ Interpolators vs_main(InputData i)
 Texture2D    tex  : register(t0);
 SamplerState samp : register(s0);
 
+// Output is premultiplied alpha. Textures are premultiplied when loaded and so is the tint,
+// additive sprites have zero tint alpha so that the blend only adds their color.
 float4 ps_main(Interpolators interp) : SV_TARGET
 {
 #ifndef ERROR_SHADER
+    if (sample_mode == SAMPLE_MODE_DISTANCE_FIELD)
+    {
+        // Distance fields are scaled to any size, so sample them bilinearly and smooth the edge over one screen pixel
+        float distance = tex.Sample(samp, interp.pixel / texture_size).r;
+        float edge_width = max(fwidth(distance), 1e-4);
+        float edge = 128.0 / 255.0; // SDF_ONEDGE_VALUE in sdf.h
+        float coverage = smoothstep(edge - edge_width, edge + edge_width, distance);
+        return interp.color * coverage;
+    }
+
     // TODO: Toggle allow switching between fat pixel and regular bilinear
     // "fat pixel" or smooth pixel art shader courtesy of https://www.shadertoy.com/view/MlB3D3
     float2 pixel = floor(interp.pixel) + 0.5; // emulate point filtering
@@ -68,6 +89,13 @@ float4 ps_main(Interpolators interp) : SV_TARGET
     pixel += clampedGradient * gradient * 0.5; // add some aa
 #endif
 
+    if (sample_mode == SAMPLE_MODE_COVERAGE)
+    {
+        // One channel atlases store coverage in red, the color comes from the tint
+        float coverage = tex.Sample(samp, pixel / texture_size).r;
+        return interp.color * coverage;
+    }
+
     float4 tex_col = tex.Sample(samp, pixel / texture_size);
 
     float4 color = interp.color * tex_col;
@@ -0,0 +1,84 @@
+#include "arena.h"
+#include "platform.h"
+
+namespace bstr::core {
+
+Arena::Arena(usz reserve_size)
+{
+    m_reserved = (usz)align_forwards(reserve_size, PAGE_SIZE);
+    m_base = (u8*)platform::reserve_memory(m_reserved);
+    if (!m_base)
+    {
+        LOG_ERROR("Could not reserve {} bytes for an arena", m_reserved);
+        m_reserved = 0;
+    }
+}
+
+Arena::~Arena()
+{
+    if (m_base)
+    {
+        platform::release_memory(m_base);
+    }
+}
+
+Arena::Arena(Arena&& other)
+{
+    *this = move(other);
+}
+
+Arena& Arena::operator=(Arena&& other)
+{
+    if (this != &other)
+    {
+        if (m_base)
+        {
+            platform::release_memory(m_base);
+        }
+        m_base = other.m_base;
+        m_reserved = other.m_reserved;
+        m_committed = other.m_committed;
+        m_used = other.m_used;
+        m_peak_used = other.m_peak_used;
+
+        other.m_base = nullptr;
+        other.m_reserved = 0;
+        other.m_committed = 0;
+        other.m_used = 0;
+        other.m_peak_used = 0;
+    }
+    return *this;
+}
+
+void* Arena::allocate(usz size, usz alignment)
+{
+    usz offset = (usz)(align_forwards((uptr)m_base + m_used, alignment) - (uptr)m_base);
+    usz end = offset + size;
+    if (end > m_reserved || end < offset)
+    {
+        return nullptr;
+    }
+
+    if (end > m_committed)
+    {
+        usz new_committed = min((usz)align_forwards(end, ARENA_COMMIT_SIZE), m_reserved);
+        if (!platform::commit_memory(m_base + m_committed, new_committed - m_committed))
+        {
+            return nullptr;
+        }
+        m_committed = new_committed;
+    }
+
+    m_used = end;
+    m_peak_used = max(m_peak_used, m_used);
+    void* result = m_base + offset;
+    return result;
+}
+
+void Arena::rewind(ArenaMark mark)
+{
+    ASSERT(mark.offset <= m_used, "rewinding an arena forwards");
+    m_used = mark.offset;
+}
+
+}
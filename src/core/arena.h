@@ -0,0 +1,130 @@
+#pragma once
+
+#include "def.h"
+#include "non_null.h"
+#include "utils.h"
+#include "containers/string.h"
+#include "containers/vector.h"
+
+namespace bstr::core {
+
+// Address space reserved up front, it costs nothing until it is committed
+static constexpr usz ARENA_DEFAULT_RESERVE_SIZE = 1 * GiB;
+// Memory is committed in steps of this, so that growing does not call into the OS for every allocation
+static constexpr usz ARENA_COMMIT_SIZE = 64 * KiB;
+
+// Position in an arena to rewind back to
+struct ArenaMark
+{
+    usz offset{};
+};
+
+// Linear allocator over a range of reserved virtual memory. Pages are committed as the arena grows and
+// never move, so pointers stay valid until the arena is rewound past them. Single allocations are never freed,
+// everything allocated after a mark is freed at once by rewinding to it. Not thread safe.
+class Arena {
+public:
+    Arena() = default;
+    explicit Arena(usz reserve_size);
+    ~Arena();
+
+    Arena(Arena&& other);
+    Arena& operator=(Arena&& other);
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Memory from the first use of the arena is zeroed, memory reused after a rewind is not.
+    // Returns nullptr if the reservation is used up.
+    void* allocate(usz size, usz alignment = alignof(std::max_align_t));
+
+    template<typename T>
+    T* allocate_array(usz count)
+    {
+        T* result = (T*)allocate(sizeof(T) * count, alignof(T));
+        return result;
+    }
+
+    ArenaMark mark() const { return { m_used }; }
+    void rewind(ArenaMark mark);
+    void reset() { rewind({}); }
+
+    usz used() const { return m_used; }
+    usz peak_used() const { return m_peak_used; }
+    usz committed() const { return m_committed; }
+    usz reserved() const { return m_reserved; }
+
+private:
+    u8* m_base{};
+    usz m_reserved{};
+    usz m_committed{};
+    usz m_used{};
+    usz m_peak_used{};
+};
+
+// Rewinds the arena to where it was when the scope was entered, for scratch memory inside a function
+class ArenaScope {
+public:
+    explicit ArenaScope(Arena& arena)
+        : m_arena(arena)
+        , m_mark(arena.mark())
+    {
+    }
+    ~ArenaScope()
+    {
+        m_arena.rewind(m_mark);
+    }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    Arena& m_arena;
+    ArenaMark m_mark;
+};
+
+// Standard allocator on top of an arena. Deallocating does nothing, the memory is freed when the arena is rewound,
+// so containers that use it must not outlive the next rewind past them.
+template<typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    // Implicit, so that a container can be constructed straight from the arena
+    ArenaAllocator(non_null<Arena> arena)
+        : m_arena(arena)
+    {
+    }
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other)
+        : m_arena(other.arena())
+    {
+    }
+
+    T* allocate(usz count)
+    {
+        T* result = m_arena->allocate_array<T>(count);
+        ASSERT(result, "arena is out of reserved memory");
+        return result;
+    }
+
+    void deallocate(T*, usz)
+    {
+    }
+
+    Arena* arena() const { return m_arena; }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return m_arena == other.arena(); }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return m_arena != other.arena(); }
+
+private:
+    Arena* m_arena{};
+};
+
+template<typename T>
+using arena_vector = ::std::vector<T, ArenaAllocator<T>>;
+using arena_string = ::std::basic_string<char, ::std::char_traits<char>, ArenaAllocator<char>>;
+
+}
@@ -1,5 +1,6 @@
 #include "asefile.h"
 
+#include "profiler.h"
 #include "utils.h"
 
 #include "containers/common.h"
@@ -244,6 +245,9 @@ struct AseCelChunk {
 	// 		compressed with ZLIB method(see NOTE.3)
 };
 
+// Cels of pixel art sprites are small, up to this they are decompressed on the stack
+static constexpr usz CEL_INLINE_PIXEL_BYTES = 32 * 32 * 4;
+
 class AsepriteLoader {
 public:
 	explicit AsepriteLoader(const char* filename, non_null<AseFile> ase_file)
@@ -318,6 +322,7 @@ AseFile AseFile::load_from_file(const char* filename)
 
 void AsepriteLoader::load()
 {
+	PROFILE_SCOPE("AsepriteLoader::load");
 	m_file_data = read_entire_file_as_bytes(m_filename);
 	load_header();
 	load_frames();
@@ -434,7 +439,7 @@ void AsepriteLoader::load_cel(DWORD chunk_size)
 			load_from_file(width_in_pixels);
 			WORD height_in_pixels;
 			load_from_file(height_in_pixels);
-			vector<BYTE> pixel_bytes;
+			small_vector<BYTE, CEL_INLINE_PIXEL_BYTES> pixel_bytes;
 			// ZEXTERN int ZEXPORT uncompress(Bytef * dest, uLongf * destLen,
 			// 	const Bytef * source, uLong sourceLen);
 			// /*
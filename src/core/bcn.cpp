@@ -0,0 +1,581 @@
+#include "bcn.h"
+#include "simd.h"
+#include "utils.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace bstr::core {
+
+static constexpr u32 BLOCK_DIM = 4;
+static constexpr u32 BLOCK_PIXELS = BLOCK_DIM * BLOCK_DIM;
+
+// Interpolation weights of 4-bit BC7 indices, out of 64
+static constexpr u32 BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static usz block_bytes(BlockCompression compression)
+{
+    switch (compression)
+    {
+    case BlockCompression_BC1: return 8;
+    case BlockCompression_BC3: return 16;
+    case BlockCompression_BC7: return 16;
+    default: break;
+    }
+    ASSERT_UNREACHED();
+    return 0;
+}
+
+usz block_compressed_size(BlockCompression compression, u32 width, u32 height)
+{
+    if (compression == BlockCompression_None)
+    {
+        return (usz)width * height * 4;
+    }
+    usz blocks_x = (width + BLOCK_DIM - 1) / BLOCK_DIM;
+    usz blocks_y = (height + BLOCK_DIM - 1) / BLOCK_DIM;
+    usz result = blocks_x * blocks_y * block_bytes(compression);
+    return result;
+}
+
+u32 get_block_padded_dimension(BlockCompression compression, u32 size)
+{
+    u32 result = compression == BlockCompression_None ? size : (u32)align_forwards(size, BLOCK_DIM);
+    return result;
+}
+
+//
+// Endpoint search
+//
+
+// Per channel minimum and maximum of the 16 pixels of a block
+static void find_block_bounds(const u8* block, u8 out_min[4], u8 out_max[4])
+{
+    __m128i p0 = _mm_loadu_si128((const __m128i*)(block + 0));
+    __m128i p1 = _mm_loadu_si128((const __m128i*)(block + 16));
+    __m128i p2 = _mm_loadu_si128((const __m128i*)(block + 32));
+    __m128i p3 = _mm_loadu_si128((const __m128i*)(block + 48));
+
+    __m128i lo = _mm_min_epu8(_mm_min_epu8(p0, p1), _mm_min_epu8(p2, p3));
+    __m128i hi = _mm_max_epu8(_mm_max_epu8(p0, p1), _mm_max_epu8(p2, p3));
+    lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+    hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+    lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+    hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    u32 min_rgba = (u32)_mm_cvtsi128_si32(lo);
+    u32 max_rgba = (u32)_mm_cvtsi128_si32(hi);
+    memcpy(out_min, &min_rgba, 4);
+    memcpy(out_max, &max_rgba, 4);
+}
+
+// Dot products of each pixel of a block with dir
+static void project_block(const u8* block, const s32 dir[4], s32 out_dots[BLOCK_PIXELS])
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i dir16 = _mm_setr_epi16(
+        (s16)dir[0], (s16)dir[1], (s16)dir[2], (s16)dir[3],
+        (s16)dir[0], (s16)dir[1], (s16)dir[2], (s16)dir[3]);
+
+    for (u32 row = 0; row < BLOCK_DIM; ++row)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(block + row * 16));
+        // (r*dr + g*dg, b*db + a*da) for each pixel
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), dir16);
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), dir16);
+        __m128 lo_ps = _mm_castsi128_ps(lo);
+        __m128 hi_ps = _mm_castsi128_ps(hi);
+        __m128i even = _mm_castps_si128(_mm_shuffle_ps(lo_ps, hi_ps, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i odd = _mm_castps_si128(_mm_shuffle_ps(lo_ps, hi_ps, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm_storeu_si128((__m128i*)(out_dots + row * 4), _mm_add_epi32(even, odd));
+    }
+}
+
+// The bounding box diagonal only follows the colors if the channels grow together. Channels that go against
+// the channel with the largest range have their min and max swapped, so that the endpoints are on the right diagonal.
+static void orient_endpoints(const u8* block, u32 channel_count, u8 e0[4], u8 e1[4])
+{
+    u32 main_channel = 0;
+    for (u32 c = 1; c < channel_count; ++c)
+    {
+        if (e1[c] - e0[c] > e1[main_channel] - e0[main_channel])
+        {
+            main_channel = c;
+        }
+    }
+
+    s32 mean[4] = {};
+    for (u32 i = 0; i < BLOCK_PIXELS; ++i)
+    {
+        for (u32 c = 0; c < channel_count; ++c)
+        {
+            mean[c] += block[i * 4 + c];
+        }
+    }
+
+    for (u32 c = 0; c < channel_count; ++c)
+    {
+        if (c == main_channel)
+        {
+            continue;
+        }
+        s32 covariance = 0;
+        for (u32 i = 0; i < BLOCK_PIXELS; ++i)
+        {
+            s32 dm = (s32)block[i * 4 + main_channel] * (s32)BLOCK_PIXELS - mean[main_channel];
+            s32 dc = (s32)block[i * 4 + c] * (s32)BLOCK_PIXELS - mean[c];
+            covariance += (dm / 16) * (dc / 16);
+        }
+        if (covariance < 0)
+        {
+            u8 temp = e0[c];
+            e0[c] = e1[c];
+            e1[c] = temp;
+        }
+    }
+}
+
+//
+// BC1
+//
+
+static u16 pack_565(const u8 rgb[3])
+{
+    u32 r = ((u32)rgb[0] * 31 + 127) / 255;
+    u32 g = ((u32)rgb[1] * 63 + 127) / 255;
+    u32 b = ((u32)rgb[2] * 31 + 127) / 255;
+    u16 result = (u16)((r << 11) | (g << 5) | b);
+    return result;
+}
+
+static void unpack_565(u16 color, u8 out_rgb[3])
+{
+    u32 r = (color >> 11) & 31;
+    u32 g = (color >> 5) & 63;
+    u32 b = color & 31;
+    out_rgb[0] = (u8)((r << 3) | (r >> 2));
+    out_rgb[1] = (u8)((g << 2) | (g >> 4));
+    out_rgb[2] = (u8)((b << 3) | (b >> 2));
+}
+
+// Always in the four color mode, which is also the only mode of the color block of BC3
+static void encode_bc1_colors(const u8* block, u8* out)
+{
+    u8 e0[4], e1[4];
+    find_block_bounds(block, e0, e1);
+    u32 rgb_channels = 3;
+    orient_endpoints(block, rgb_channels, e0, e1);
+
+    // Inset the bounding box a little, its corners are rarely in the block
+    for (u32 c = 0; c < 3; ++c)
+    {
+        s32 inset = ((s32)e1[c] - (s32)e0[c]) / 16;
+        e0[c] = (u8)((s32)e0[c] + inset);
+        e1[c] = (u8)((s32)e1[c] - inset);
+    }
+
+    u16 c0 = pack_565(e1);
+    u16 c1 = pack_565(e0);
+    if (c0 < c1)
+    {
+        u16 temp = c0;
+        c0 = c1;
+        c1 = temp;
+    }
+
+    u32 indices = 0;
+    if (c0 != c1)
+    {
+        u8 rgb0[3], rgb1[3];
+        unpack_565(c0, rgb0);
+        unpack_565(c1, rgb1);
+        s32 dir[4] = { rgb1[0] - rgb0[0], rgb1[1] - rgb0[1], rgb1[2] - rgb0[2], 0 };
+        s32 start = rgb0[0] * dir[0] + rgb0[1] * dir[1] + rgb0[2] * dir[2];
+        s32 length = rgb1[0] * dir[0] + rgb1[1] * dir[1] + rgb1[2] * dir[2] - start;
+
+        s32 dots[BLOCK_PIXELS];
+        project_block(block, dir, dots);
+
+        // Palette order along the line is c0, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1, c1
+        static constexpr u32 INDEX_FROM_STEP[4] = { 0, 2, 3, 1 };
+        for (u32 i = 0; i < BLOCK_PIXELS; ++i)
+        {
+            s32 distance = max(dots[i] - start, 0);
+            s32 step = min((distance * 6 + length) / (2 * length), 3);
+            indices |= INDEX_FROM_STEP[step] << (i * 2);
+        }
+    }
+
+    memcpy(out + 0, &c0, 2);
+    memcpy(out + 2, &c1, 2);
+    memcpy(out + 4, &indices, 4);
+}
+
+static void decode_bc1_colors(const u8* in, bool allow_three_colors, u8* out_block)
+{
+    u16 c0, c1;
+    u32 indices;
+    memcpy(&c0, in + 0, 2);
+    memcpy(&c1, in + 2, 2);
+    memcpy(&indices, in + 4, 4);
+
+    u8 palette[4][4] = {};
+    unpack_565(c0, palette[0]);
+    unpack_565(c1, palette[1]);
+    palette[0][3] = 255;
+    palette[1][3] = 255;
+    for (u32 c = 0; c < 3; ++c)
+    {
+        if (c0 > c1 || !allow_three_colors)
+        {
+            palette[2][c] = (u8)((2 * palette[0][c] + palette[1][c]) / 3);
+            palette[3][c] = (u8)((palette[0][c] + 2 * palette[1][c]) / 3);
+        }
+        else
+        {
+            palette[2][c] = (u8)((palette[0][c] + palette[1][c]) / 2);
+            palette[3][c] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = (c0 > c1 || !allow_three_colors) ? 255 : 0;
+
+    for (u32 i = 0; i < BLOCK_PIXELS; ++i)
+    {
+        memcpy(out_block + i * 4, palette[(indices >> (i * 2)) & 3], 4);
+    }
+}
+
+//
+// BC3
+//
+
+static void encode_bc3_alpha(const u8* block, u8* out)
+{
+    u8 a0 = 0;
+    u8 a1 = 255;
+    for (u32 i = 0; i < BLOCK_PIXELS; ++i)
+    {
+        a0 = max(a0, block[i * 4 + 3]);
+        a1 = min(a1, block[i * 4 + 3]);
+    }
+
+    u64 indices = 0;
+    if (a0 != a1)
+    {
+        // Eight alpha mode, a0 > a1. Palette order from a0 to a1 is 0, 2, 3, 4, 5, 6, 7, 1.
+        s32 length = a0 - a1;
+        for (u32 i = 0; i < BLOCK_PIXELS; ++i)
+        {
+            s32 distance = a0 - block[i * 4 + 3];
+            u64 step = (u64)((distance * 14 + length) / (2 * length));
+            u64 index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+            indices |= index << (i * 3);
+        }
+    }
+
+    out[0] = a0;
+    out[1] = a1;
+    for (u32 i = 0; i < 6; ++i)
+    {
+        out[2 + i] = (u8)(indices >> (i * 8));
+    }
+}
+
+static void decode_bc3_alpha(const u8* in, u8* out_block)
+{
+    u32 a0 = in[0];
+    u32 a1 = in[1];
+    u64 indices = 0;
+    for (u32 i = 0; i < 6; ++i)
+    {
+        indices |= (u64)in[2 + i] << (i * 8);
+    }
+
+    u8 palette[8];
+    palette[0] = (u8)a0;
+    palette[1] = (u8)a1;
+    if (a0 > a1)
+    {
+        for (u32 i = 1; i < 7; ++i)
+        {
+            palette[i + 1] = (u8)(((7 - i) * a0 + i * a1) / 7);
+        }
+    }
+    else
+    {
+        for (u32 i = 1; i < 5; ++i)
+        {
+            palette[i + 1] = (u8)(((5 - i) * a0 + i * a1) / 5);
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    for (u32 i = 0; i < BLOCK_PIXELS; ++i)
+    {
+        out_block[i * 4 + 3] = palette[(indices >> (i * 3)) & 7];
+    }
+}
+
+//
+// BC7 mode 6: one subset, RGBA endpoints of 7 bits and a unique p-bit each, 4-bit indices
+//
+
+struct Bc7Bits
+{
+    u64 lo{};
+    u64 hi{};
+    u32 position{};
+
+    void write(u32 value, u32 bit_count)
+    {
+        for (u32 i = 0; i < bit_count; ++i, ++position)
+        {
+            u64 bit = (value >> i) & 1;
+            if (position < 64) lo |= bit << position;
+            else hi |= bit << (position - 64);
+        }
+    }
+
+    u32 read(u32 bit_count)
+    {
+        u32 result = 0;
+        for (u32 i = 0; i < bit_count; ++i, ++position)
+        {
+            u64 bit = position < 64 ? (lo >> position) & 1 : (hi >> (position - 64)) & 1;
+            result |= (u32)bit << i;
+        }
+        return result;
+    }
+};
+
+// Each color channel is at most 1 off with either p-bit, so with this weight the p-bit that keeps alpha exact
+// always wins. Otherwise the color of e.g. dark opaque endpoints picks p-bit 0 and alpha decodes to 254.
+static constexpr s32 BC7_ALPHA_ERROR_WEIGHT = 4;
+
+// Picks the p-bit that reconstructs the endpoint best
+static void quantize_bc7_endpoint(const u8 endpoint[4], u8 out_quantized[4], u32* out_p_bit, u8 out_reconstructed[4])
+{
+    s32 best_error = -1;
+    for (u32 p = 0; p < 2; ++p)
+    {
+        s32 error = 0;
+        u8 quantized[4], reconstructed[4];
+        for (u32 c = 0; c < 4; ++c)
+        {
+            s32 q = ((s32)endpoint[c] - (s32)p + 1) / 2;
+            q = q < 0 ? 0 : q > 127 ? 127 : q;
+            quantized[c] = (u8)q;
+            reconstructed[c] = (u8)((q << 1) | p);
+            s32 diff = (s32)reconstructed[c] - (s32)endpoint[c];
+            error += diff * diff * (c == 3 ? BC7_ALPHA_ERROR_WEIGHT : 1);
+        }
+        if (best_error < 0 || error < best_error)
+        {
+            best_error = error;
+            memcpy(out_quantized, quantized, 4);
+            memcpy(out_reconstructed, reconstructed, 4);
+            *out_p_bit = p;
+        }
+    }
+}
+
+static void encode_bc7_mode6(const u8* block, u8* out)
+{
+    u8 e0[4], e1[4];
+    find_block_bounds(block, e0, e1);
+    u32 rgba_channels = 4;
+    orient_endpoints(block, rgba_channels, e0, e1);
+
+    u8 q0[4], q1[4], r0[4], r1[4];
+    u32 p0, p1;
+    quantize_bc7_endpoint(e0, q0, &p0, r0);
+    quantize_bc7_endpoint(e1, q1, &p1, r1);
+
+    u32 indices[BLOCK_PIXELS] = {};
+    s32 dir[4] = { r1[0] - r0[0], r1[1] - r0[1], r1[2] - r0[2], r1[3] - r0[3] };
+    s32 start = r0[0] * dir[0] + r0[1] * dir[1] + r0[2] * dir[2] + r0[3] * dir[3];
+    s32 length = r1[0] * dir[0] + r1[1] * dir[1] + r1[2] * dir[2] + r1[3] * dir[3] - start;
+    if (length > 0)
+    {
+        s32 dots[BLOCK_PIXELS];
+        project_block(block, dir, dots);
+        for (u32 i = 0; i < BLOCK_PIXELS; ++i)
+        {
+            s32 distance = min(max(dots[i] - start, 0), length);
+            s32 weight = (s32)(((s64)distance * 64 + length / 2) / length);
+            u32 index = 0;
+            while (index < 15 && abs((s32)BC7_WEIGHTS4[index + 1] - weight) <= abs((s32)BC7_WEIGHTS4[index] - weight))
+            {
+                index += 1;
+            }
+            indices[i] = index;
+        }
+    }
+
+    // The top bit of the first index is implicitly zero, flip the endpoints if it is not.
+    // The weights are symmetric, so that is the same as flipping every index.
+    if (indices[0] & 8)
+    {
+        for (u32 c = 0; c < 4; ++c)
+        {
+            u8 temp = q0[c];
+            q0[c] = q1[c];
+            q1[c] = temp;
+        }
+        u32 temp = p0;
+        p0 = p1;
+        p1 = temp;
+        for (u32 i = 0; i < BLOCK_PIXELS; ++i)
+        {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    Bc7Bits bits;
+    bits.write(1 << 6, 7);
+    for (u32 c = 0; c < 4; ++c)
+    {
+        bits.write(q0[c], 7);
+        bits.write(q1[c], 7);
+    }
+    bits.write(p0, 1);
+    bits.write(p1, 1);
+    bits.write(indices[0], 3);
+    for (u32 i = 1; i < BLOCK_PIXELS; ++i)
+    {
+        bits.write(indices[i], 4);
+    }
+    ASSERT(bits.position == 128, "BC7 block is not 128 bits");
+
+    memcpy(out + 0, &bits.lo, 8);
+    memcpy(out + 8, &bits.hi, 8);
+}
+
+static bool decode_bc7_mode6(const u8* in, u8* out_block)
+{
+    Bc7Bits bits;
+    memcpy(&bits.lo, in + 0, 8);
+    memcpy(&bits.hi, in + 8, 8);
+    if (bits.read(7) != (1 << 6))
+    {
+        memset(out_block, 0, BLOCK_PIXELS * 4);
+        return false;
+    }
+
+    u32 e0[4], e1[4];
+    for (u32 c = 0; c < 4; ++c)
+    {
+        e0[c] = bits.read(7) << 1;
+        e1[c] = bits.read(7) << 1;
+    }
+    u32 p0 = bits.read(1);
+    u32 p1 = bits.read(1);
+    for (u32 c = 0; c < 4; ++c)
+    {
+        e0[c] |= p0;
+        e1[c] |= p1;
+    }
+
+    for (u32 i = 0; i < BLOCK_PIXELS; ++i)
+    {
+        u32 weight = BC7_WEIGHTS4[bits.read(i == 0 ? 3 : 4)];
+        for (u32 c = 0; c < 4; ++c)
+        {
+            out_block[i * 4 + c] = (u8)(((64 - weight) * e0[c] + weight * e1[c] + 32) >> 6);
+        }
+    }
+    return true;
+}
+
+//
+// Images
+//
+
+void encode_block_compressed(BlockCompression compression, non_null<const u8> pixels, u32 width, u32 height, non_null<u8> out_blocks)
+{
+    ASSERT(compression != BlockCompression_None, "");
+    ASSERT(width > 0 && height > 0, "");
+
+    usz bytes_per_block = block_bytes(compression);
+    u8* out = out_blocks;
+    for (u32 block_y = 0; block_y < height; block_y += BLOCK_DIM)
+    {
+        for (u32 block_x = 0; block_x < width; block_x += BLOCK_DIM)
+        {
+            // Blocks over the edge repeat the last row and column
+            alignas(16) u8 block[BLOCK_PIXELS * 4];
+            for (u32 y = 0; y < BLOCK_DIM; ++y)
+            {
+                u32 src_y = min(block_y + y, height - 1);
+                for (u32 x = 0; x < BLOCK_DIM; ++x)
+                {
+                    u32 src_x = min(block_x + x, width - 1);
+                    memcpy(block + (y * BLOCK_DIM + x) * 4, pixels + ((usz)src_y * width + src_x) * 4, 4);
+                }
+            }
+
+            switch (compression)
+            {
+            case BlockCompression_BC1:
+                encode_bc1_colors(block, out);
+                break;
+            case BlockCompression_BC3:
+                encode_bc3_alpha(block, out);
+                encode_bc1_colors(block, out + 8);
+                break;
+            case BlockCompression_BC7:
+                encode_bc7_mode6(block, out);
+                break;
+            default:
+                ASSERT_UNREACHED();
+                break;
+            }
+            out += bytes_per_block;
+        }
+    }
+}
+
+bool decode_block_compressed(BlockCompression compression, non_null<const u8> blocks, u32 width, u32 height, non_null<u8> out_pixels)
+{
+    ASSERT(compression != BlockCompression_None, "");
+
+    bool result = true;
+    usz bytes_per_block = block_bytes(compression);
+    const u8* in = blocks;
+    for (u32 block_y = 0; block_y < height; block_y += BLOCK_DIM)
+    {
+        for (u32 block_x = 0; block_x < width; block_x += BLOCK_DIM)
+        {
+            u8 block[BLOCK_PIXELS * 4];
+            switch (compression)
+            {
+            case BlockCompression_BC1:
+                decode_bc1_colors(in, true, block);
+                break;
+            case BlockCompression_BC3:
+                decode_bc1_colors(in + 8, false, block);
+                decode_bc3_alpha(in, block);
+                break;
+            case BlockCompression_BC7:
+                result &= decode_bc7_mode6(in, block);
+                break;
+            default:
+                ASSERT_UNREACHED();
+                break;
+            }
+            in += bytes_per_block;
+
+            u32 block_width = min(BLOCK_DIM, width - block_x);
+            u32 block_height = min(BLOCK_DIM, height - block_y);
+            for (u32 y = 0; y < block_height; ++y)
+            {
+                memcpy(out_pixels + ((usz)(block_y + y) * width + block_x) * 4, block + y * BLOCK_DIM * 4, block_width * 4);
+            }
+        }
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "def.h"
+#include "non_null.h"
+
+namespace bstr::core {
+
+// Block compressed texture formats. Images are encoded in 4x4 pixel blocks, partial blocks at the right and
+// bottom edges are filled by repeating the edge pixels.
+enum BlockCompression : u32 {
+    BlockCompression_None,
+    BlockCompression_BC1, // RGB, 8 bytes per block. Alpha is dropped.
+    BlockCompression_BC3, // RGBA, 16 bytes per block, alpha is stored separately from the colors
+    BlockCompression_BC7, // RGBA, 16 bytes per block. The encoder only uses mode 6.
+};
+
+// For BlockCompression_None the size of RGBA8 pixels
+usz block_compressed_size(BlockCompression compression, u32 width, u32 height);
+
+// Compressed images are stored padded to whole blocks, and their mip levels are made from the padded size.
+// Returns the stored width or height of an image that is size pixels wide or high.
+u32 get_block_padded_dimension(BlockCompression compression, u32 size);
+
+// Encodes RGBA8 pixels to block_compressed_size bytes of blocks.
+// Endpoints are searched from the bounding box of the block, with SSE2 used for the bounds and the projections.
+void encode_block_compressed(BlockCompression compression, non_null<const u8> pixels, u32 width, u32 height, non_null<u8> out_blocks);
+
+// Decodes blocks to RGBA8 pixels, e.g. for devices that cannot sample the format.
+// BC7 blocks of other modes than 6 decode to transparent black and make this return false.
+bool decode_block_compressed(BlockCompression compression, non_null<const u8> blocks, u32 width, u32 height, non_null<u8> out_pixels);
+
+}
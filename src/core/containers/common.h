@@ -3,6 +3,8 @@
 #include "span.h"
 #include "string_view.h"
 #include "vector.h"
+#include "small_vector.h"
+#include "fixed_vector.h"
 #include "hashmap.h"
 #include "pair.h"
 #include "string.h"
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "def.h"
+#include "utils.h"
+#include "relocate.h"
+
+#include <initializer_list>
+
+namespace bstr::core::containers {
+
+// Vector with room for N elements inside of itself and never more, it never allocates.
+// Going over the capacity is a bug, use small_vector when the size cannot be bounded.
+template<class T, usz N>
+class fixed_vector {
+	static_assert(N > 0, "fixed_vector needs room for at least one element");
+
+public:
+	using value_type = T;
+	using iterator = T*;
+	using const_iterator = const T*;
+
+	fixed_vector() = default;
+
+	explicit fixed_vector(usz count)
+	{
+		resize(count);
+	}
+
+	fixed_vector(::std::initializer_list<T> values)
+	{
+		for (const T& value : values)
+		{
+			push_back(value);
+		}
+	}
+
+	~fixed_vector()
+	{
+		clear();
+	}
+
+	fixed_vector(const fixed_vector& other)
+	{
+		for (const T& value : other)
+		{
+			push_back(value);
+		}
+	}
+
+	fixed_vector& operator=(const fixed_vector& other)
+	{
+		if (this != &other)
+		{
+			clear();
+			for (const T& value : other)
+			{
+				push_back(value);
+			}
+		}
+		return *this;
+	}
+
+	fixed_vector(fixed_vector&& other)
+	{
+		relocate(other.data(), other.m_size, data());
+		m_size = other.m_size;
+		other.m_size = 0;
+	}
+
+	fixed_vector& operator=(fixed_vector&& other)
+	{
+		if (this != &other)
+		{
+			clear();
+			relocate(other.data(), other.m_size, data());
+			m_size = other.m_size;
+			other.m_size = 0;
+		}
+		return *this;
+	}
+
+	template<class... Args>
+	T& emplace_back(Args&&... args)
+	{
+		ASSERT(m_size < N, "fixed_vector is full");
+		T* result = new (data() + m_size) T(forward<Args>(args)...);
+		m_size += 1;
+		return *result;
+	}
+
+	void push_back(const T& value) { emplace_back(value); }
+	void push_back(T&& value) { emplace_back(move(value)); }
+
+	void pop_back()
+	{
+		ASSERT(m_size > 0, "fixed_vector is empty");
+		m_size -= 1;
+		data()[m_size].~T();
+	}
+
+	// Keeps the order of the rest, returns the element after the erased one
+	T* erase(const T* position)
+	{
+		usz index = (usz)(position - data());
+		ASSERT(index < m_size, "fixed_vector erase out of bounds");
+		for (usz i = index; i + 1 < m_size; ++i)
+		{
+			data()[i] = move(data()[i + 1]);
+		}
+		pop_back();
+		return data() + index;
+	}
+
+	void resize(usz count)
+	{
+		ASSERT(count <= N, "fixed_vector is full");
+		while (m_size > count)
+		{
+			pop_back();
+		}
+		while (m_size < count)
+		{
+			emplace_back();
+		}
+	}
+
+	void clear()
+	{
+		destroy_range(data(), m_size);
+		m_size = 0;
+	}
+
+	T* data() { return (T*)m_storage; }
+	const T* data() const { return (const T*)m_storage; }
+	usz size() const { return m_size; }
+	static constexpr usz capacity() { return N; }
+	bool empty() const { return m_size == 0; }
+	bool full() const { return m_size == N; }
+
+	T& operator[](usz i) { ASSERT(i < m_size, "fixed_vector out of bounds"); return data()[i]; }
+	const T& operator[](usz i) const { ASSERT(i < m_size, "fixed_vector out of bounds"); return data()[i]; }
+	T& front() { return (*this)[0]; }
+	const T& front() const { return (*this)[0]; }
+	T& back() { return (*this)[m_size - 1]; }
+	const T& back() const { return (*this)[m_size - 1]; }
+
+	T* begin() { return data(); }
+	T* end() { return data() + m_size; }
+	const T* begin() const { return data(); }
+	const T* end() const { return data() + m_size; }
+
+private:
+	usz m_size = 0;
+	alignas(T) u8 m_storage[N * sizeof(T)];
+};
+
+}
+
+using bstr::core::containers::fixed_vector;
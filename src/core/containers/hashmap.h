@@ -1,12 +1,530 @@
 #pragma once
 
-#include <unordered_map>
+#include "def.h"
+#include "simd.h"
+#include "utils.h"
+#include "pair.h"
+#include "string.h"
+#include "string_view.h"
+
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
 
 namespace bstr::core::containers {
 
-template<class K, class V>
-using hash_map = ::std::unordered_map<K, V>;
+// Spreads the bits of an integer hash, so that both the low bits that pick the group and the 7 bits kept in
+// the control bytes differ for keys that only differ in a few bits, e.g. sequential ids
+inline u64 mix_hash_bits(u64 value)
+{
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdull;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53ull;
+	value ^= value >> 33;
+	return value;
+}
+
+template<class K, class = void>
+struct default_hash {
+	u64 operator()(const K& key) const { return mix_hash_bits((u64)::std::hash<K>{}(key)); }
+};
+
+template<class K>
+struct default_hash<K, ::std::enable_if_t<::std::is_integral_v<K> || ::std::is_enum_v<K> || ::std::is_pointer_v<K>>> {
+	u64 operator()(K key) const { return mix_hash_bits((u64)key); }
+};
+
+// Strings can be looked up with anything that converts to a string_view, without making a string first
+struct string_hash {
+	using is_transparent = void;
+	u64 operator()(string_view str) const { return hash_bytes(str.data(), str.size()); }
+};
+
+template<>
+struct default_hash<string> : string_hash {
+};
+
+template<>
+struct default_hash<string_view> : string_hash {
+};
+
+namespace hash_map_detail {
+
+static constexpr usz GROUP_WIDTH = 16;
+static constexpr usz MIN_CAPACITY = GROUP_WIDTH;
+
+// Full slots store the low 7 bits of the hash, so the high bit tells full slots apart from the rest
+enum Ctrl : s8 {
+	Ctrl_Empty = -128,
+	Ctrl_Deleted = -2,
+};
+
+// Control bytes of GROUP_WIDTH slots, compared all at once. Bit i of a mask is set for slot i.
+struct Group {
+	__m128i ctrl;
+
+	explicit Group(const s8* ctrl_bytes)
+		: ctrl(_mm_load_si128((const __m128i*)ctrl_bytes))
+	{
+	}
+
+	u32 match(s8 h2) const { return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)); }
+	u32 match_empty() const { return match(Ctrl_Empty); }
+	u32 match_empty_or_deleted() const { return (u32)_mm_movemask_epi8(ctrl); }
+};
+
+// Keeps the table at most 7/8 full, so that every probe finds an empty slot soon
+inline usz max_load(usz capacity)
+{
+	return capacity - capacity / 8;
+}
+
+inline usz capacity_for(usz count)
+{
+	usz result = MIN_CAPACITY;
+	while (max_load(result) < count)
+	{
+		result *= 2;
+	}
+	return result;
+}
+
+}
+
+// Open addressing hash map in the style of Swiss tables. Control bytes and slots are in two flat arrays
+// of one allocation. A lookup compares the 7 hash bits kept for 16 slots with one SSE2 compare and only
+// looks at the keys that match, groups are probed quadratically until one has an empty slot.
+// Erasing leaves elements where they are, so iterators and references to other elements stay valid,
+// inserting invalidates them if the table grows. Keys must not be changed through iterators.
+template<class K, class V, class Hash = default_hash<K>, class Eq = ::std::equal_to<>>
+class hash_map {
+public:
+	using key_type = K;
+	using mapped_type = V;
+	using value_type = pair<K, V>;
+
+	template<bool IsConst>
+	class iterator_base {
+	public:
+		using iterator_category = ::std::forward_iterator_tag;
+		using value_type = typename hash_map::value_type;
+		using difference_type = sptr;
+		using reference = ::std::conditional_t<IsConst, const value_type&, value_type&>;
+		using pointer = ::std::conditional_t<IsConst, const value_type*, value_type*>;
+
+		iterator_base() = default;
+
+		// Non-const iterators convert to const ones
+		template<bool OtherIsConst, class = ::std::enable_if_t<IsConst && !OtherIsConst>>
+		iterator_base(const iterator_base<OtherIsConst>& other)
+			: m_ctrl(other.m_ctrl)
+			, m_ctrl_end(other.m_ctrl_end)
+			, m_slot(other.m_slot)
+		{
+		}
+
+		reference operator*() const { return *m_slot; }
+		pointer operator->() const { return m_slot; }
+
+		iterator_base& operator++()
+		{
+			++m_ctrl;
+			++m_slot;
+			skip_to_full();
+			return *this;
+		}
+
+		iterator_base operator++(int)
+		{
+			iterator_base result = *this;
+			++*this;
+			return result;
+		}
+
+		bool operator==(const iterator_base& other) const { return m_ctrl == other.m_ctrl; }
+		bool operator!=(const iterator_base& other) const { return m_ctrl != other.m_ctrl; }
+
+	private:
+		friend class hash_map;
+		template<bool> friend class iterator_base;
+
+		iterator_base(const s8* ctrl, const s8* ctrl_end, value_type* slot)
+			: m_ctrl(ctrl)
+			, m_ctrl_end(ctrl_end)
+			, m_slot(slot)
+		{
+		}
+
+		void skip_to_full()
+		{
+			while (m_ctrl != m_ctrl_end && *m_ctrl < 0)
+			{
+				++m_ctrl;
+				++m_slot;
+			}
+		}
+
+		const s8* m_ctrl{};
+		const s8* m_ctrl_end{};
+		value_type* m_slot{};
+	};
+
+	using iterator = iterator_base<false>;
+	using const_iterator = iterator_base<true>;
+
+	hash_map() = default;
+
+	hash_map(::std::initializer_list<value_type> values)
+	{
+		reserve(values.size());
+		for (const value_type& value : values)
+		{
+			insert(value);
+		}
+	}
+
+	~hash_map()
+	{
+		destroy_and_free();
+	}
+
+	hash_map(const hash_map& other)
+	{
+		reserve(other.size());
+		for (const value_type& value : other)
+		{
+			insert(value);
+		}
+	}
+
+	hash_map& operator=(const hash_map& other)
+	{
+		if (this != &other)
+		{
+			clear();
+			reserve(other.size());
+			for (const value_type& value : other)
+			{
+				insert(value);
+			}
+		}
+		return *this;
+	}
+
+	hash_map(hash_map&& other)
+	{
+		*this = move(other);
+	}
+
+	hash_map& operator=(hash_map&& other)
+	{
+		if (this != &other)
+		{
+			destroy_and_free();
+			m_ctrl = other.m_ctrl;
+			m_slots = other.m_slots;
+			m_capacity = other.m_capacity;
+			m_size = other.m_size;
+			m_growth_left = other.m_growth_left;
+
+			other.m_ctrl = nullptr;
+			other.m_slots = nullptr;
+			other.m_capacity = 0;
+			other.m_size = 0;
+			other.m_growth_left = 0;
+		}
+		return *this;
+	}
+
+	iterator begin()
+	{
+		iterator result(m_ctrl, m_ctrl + m_capacity, m_slots);
+		result.skip_to_full();
+		return result;
+	}
+	iterator end() { return iterator(m_ctrl + m_capacity, m_ctrl + m_capacity, m_slots + m_capacity); }
+	const_iterator begin() const { return const_cast<hash_map*>(this)->begin(); }
+	const_iterator end() const { return const_cast<hash_map*>(this)->end(); }
+
+	usz size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	usz capacity() const { return m_capacity; }
+
+	// Destroys the elements but keeps the memory
+	void clear()
+	{
+		destroy_elements();
+		if (m_capacity > 0)
+		{
+			memset(m_ctrl, hash_map_detail::Ctrl_Empty, m_capacity);
+		}
+		m_size = 0;
+		m_growth_left = hash_map_detail::max_load(m_capacity);
+	}
+
+	// Makes room for count elements, so that inserting up to that many does not grow the table
+	void reserve(usz count)
+	{
+		if (count > m_size + m_growth_left)
+		{
+			resize(hash_map_detail::capacity_for(count));
+		}
+	}
+
+	iterator find(const K& key) { return find_impl(key); }
+	const_iterator find(const K& key) const { return const_cast<hash_map*>(this)->find_impl(key); }
+	template<class Q, class H = Hash, class = typename H::is_transparent>
+	iterator find(const Q& key) { return find_impl(key); }
+	template<class Q, class H = Hash, class = typename H::is_transparent>
+	const_iterator find(const Q& key) const { return const_cast<hash_map*>(this)->find_impl(key); }
+
+	bool contains(const K& key) const { return find(key) != end(); }
+	template<class Q, class H = Hash, class = typename H::is_transparent>
+	bool contains(const Q& key) const { return find(key) != end(); }
+
+	usz count(const K& key) const { return contains(key) ? 1 : 0; }
+
+	// Does nothing if the key is already in the map, otherwise constructs the value from args
+	template<class KeyArg, class... Args>
+	pair<iterator, bool> try_emplace(KeyArg&& key, Args&&... args)
+	{
+		pair<usz, bool> slot = find_or_prepare_insert(key);
+		if (!slot.second)
+		{
+			new (m_slots + slot.first) value_type{ K(forward<KeyArg>(key)), V(forward<Args>(args)...) };
+		}
+		pair<iterator, bool> result = { iterator_at(slot.first), !slot.second };
+		return result;
+	}
+
+	pair<iterator, bool> insert(const value_type& value) { return try_emplace(value.first, value.second); }
+	pair<iterator, bool> insert(value_type&& value) { return try_emplace(move(value.first), move(value.second)); }
+
+	V& operator[](const K& key) { return try_emplace(key).first->second; }
+	V& operator[](K&& key) { return try_emplace(move(key)).first->second; }
+
+	usz erase(const K& key) { return erase_impl(key); }
+	template<class Q, class H = Hash, class = typename H::is_transparent>
+	usz erase(const Q& key) { return erase_impl(key); }
+
+	// Returns the iterator to the element after the erased one
+	iterator erase(const_iterator it)
+	{
+		usz index = (usz)(it.m_ctrl - m_ctrl);
+		erase_at(index);
+		iterator result = iterator_at(index);
+		result.skip_to_full();
+		return result;
+	}
+	iterator erase(iterator it) { return erase(const_iterator(it)); }
+
+private:
+	static s8 get_h2(u64 hash) { return (s8)(hash & 0x7f); }
+	static u64 get_h1(u64 hash) { return hash >> 7; }
+
+	iterator iterator_at(usz index) { return iterator(m_ctrl + index, m_ctrl + m_capacity, m_slots + index); }
+
+	template<class Q>
+	iterator find_impl(const Q& key)
+	{
+		if (m_size == 0)
+		{
+			return end();
+		}
+		return find_with_hash(key, Hash{}(key));
+	}
+
+	template<class Q>
+	iterator find_with_hash(const Q& key, u64 hash)
+	{
+		s8 h2 = get_h2(hash);
+		usz group_mask = m_capacity / hash_map_detail::GROUP_WIDTH - 1;
+		usz group_index = (usz)get_h1(hash) & group_mask;
+		for (usz step = 1;; ++step)
+		{
+			usz group_start = group_index * hash_map_detail::GROUP_WIDTH;
+			hash_map_detail::Group group(m_ctrl + group_start);
+			for (u32 match = group.match(h2); match != 0; match &= match - 1)
+			{
+				usz index = group_start + count_trailing_zeros(match);
+				if (Eq{}(m_slots[index].first, key))
+				{
+					return iterator_at(index);
+				}
+			}
+			if (group.match_empty() != 0)
+			{
+				return end();
+			}
+			group_index = (group_index + step) & group_mask;
+		}
+	}
+
+	// First slot that is empty or deleted in the probe sequence of the hash
+	usz find_insert_slot(u64 hash) const
+	{
+		usz group_mask = m_capacity / hash_map_detail::GROUP_WIDTH - 1;
+		usz group_index = (usz)get_h1(hash) & group_mask;
+		for (usz step = 1;; ++step)
+		{
+			usz group_start = group_index * hash_map_detail::GROUP_WIDTH;
+			u32 available = hash_map_detail::Group(m_ctrl + group_start).match_empty_or_deleted();
+			if (available != 0)
+			{
+				return group_start + count_trailing_zeros(available);
+			}
+			group_index = (group_index + step) & group_mask;
+		}
+	}
+
+	// Index of the key and true if it is in the map, otherwise the index of a slot that is marked full for it
+	template<class Q>
+	pair<usz, bool> find_or_prepare_insert(const Q& key)
+	{
+		u64 hash = Hash{}(key);
+		if (m_size > 0)
+		{
+			iterator it = find_with_hash(key, hash);
+			if (it != end())
+			{
+				pair<usz, bool> result = { (usz)(it.m_ctrl - m_ctrl), true };
+				return result;
+			}
+		}
+
+		usz index = m_capacity > 0 ? find_insert_slot(hash) : 0;
+		if (m_capacity == 0 || (m_growth_left == 0 && m_ctrl[index] == hash_map_detail::Ctrl_Empty))
+		{
+			// With mostly deleted slots rehashing at the same size is enough to make room
+			bool can_rehash_in_place = m_capacity > 0 && m_size * 32 <= m_capacity * 25;
+			resize(can_rehash_in_place ? m_capacity : hash_map_detail::capacity_for(m_size + 1));
+			index = find_insert_slot(hash);
+		}
+
+		if (m_ctrl[index] == hash_map_detail::Ctrl_Empty)
+		{
+			m_growth_left -= 1;
+		}
+		m_ctrl[index] = get_h2(hash);
+		m_size += 1;
+		pair<usz, bool> result = { index, false };
+		return result;
+	}
+
+	template<class Q>
+	usz erase_impl(const Q& key)
+	{
+		iterator it = find_impl(key);
+		if (it == end())
+		{
+			return 0;
+		}
+		erase_at((usz)(it.m_ctrl - m_ctrl));
+		return 1;
+	}
+
+	void erase_at(usz index)
+	{
+		m_slots[index].~value_type();
+		m_size -= 1;
+
+		// A group that has an empty slot has never been full, so no probe has gone past it and the slot can be
+		// reused as empty. Otherwise a probe for another key may pass through, and the slot is left deleted.
+		usz group_start = index & ~(hash_map_detail::GROUP_WIDTH - 1);
+		if (hash_map_detail::Group(m_ctrl + group_start).match_empty() != 0)
+		{
+			m_ctrl[index] = hash_map_detail::Ctrl_Empty;
+			m_growth_left += 1;
+		}
+		else
+		{
+			m_ctrl[index] = hash_map_detail::Ctrl_Deleted;
+		}
+	}
+
+	static usz get_alignment()
+	{
+		usz result = max(hash_map_detail::GROUP_WIDTH, alignof(value_type));
+		return result;
+	}
+
+	// Control bytes first, then the slots
+	static usz get_slots_offset(usz capacity)
+	{
+		usz result = (usz)align_forwards(capacity, alignof(value_type));
+		return result;
+	}
+
+	void resize(usz new_capacity)
+	{
+		s8* old_ctrl = m_ctrl;
+		value_type* old_slots = m_slots;
+		usz old_capacity = m_capacity;
+
+		usz slots_offset = get_slots_offset(new_capacity);
+		u8* memory = (u8*)::operator new(slots_offset + new_capacity * sizeof(value_type), ::std::align_val_t(get_alignment()));
+		m_ctrl = (s8*)memory;
+		m_slots = (value_type*)(memory + slots_offset);
+		m_capacity = new_capacity;
+		memset(m_ctrl, hash_map_detail::Ctrl_Empty, new_capacity);
+		m_growth_left = hash_map_detail::max_load(new_capacity) - m_size;
+
+		for (usz i = 0; i < old_capacity; ++i)
+		{
+			if (old_ctrl[i] >= 0)
+			{
+				u64 hash = Hash{}(old_slots[i].first);
+				usz index = find_insert_slot(hash);
+				m_ctrl[index] = get_h2(hash);
+				new (m_slots + index) value_type(move(old_slots[i]));
+				old_slots[i].~value_type();
+			}
+		}
+
+		if (old_ctrl)
+		{
+			::operator delete(old_ctrl, ::std::align_val_t(get_alignment()));
+		}
+	}
+
+	void destroy_elements()
+	{
+		if (!::std::is_trivially_destructible_v<value_type>)
+		{
+			for (usz i = 0; i < m_capacity; ++i)
+			{
+				if (m_ctrl[i] >= 0)
+				{
+					m_slots[i].~value_type();
+				}
+			}
+		}
+	}
+
+	void destroy_and_free()
+	{
+		destroy_elements();
+		if (m_ctrl)
+		{
+			::operator delete(m_ctrl, ::std::align_val_t(get_alignment()));
+		}
+		m_ctrl = nullptr;
+		m_slots = nullptr;
+		m_capacity = 0;
+		m_size = 0;
+		m_growth_left = 0;
+	}
+
+	s8* m_ctrl{};
+	value_type* m_slots{};
+	usz m_capacity{};
+	usz m_size{};
+	usz m_growth_left{};
+};
 
 }
 
-using bstr::core::containers::hash_map;
\ No newline at end of file
+using bstr::core::containers::hash_map;
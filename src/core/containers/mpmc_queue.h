@@ -0,0 +1,168 @@
+#pragma once
+
+#include "def.h"
+#include "out_ptr.h"
+#include "utils.h"
+#include "queue_waiter.h"
+
+#include <atomic>
+#include <new>
+
+namespace bstr::core::containers {
+
+// Bounded lock-free queue for any number of producers and consumers (Vyukov). Every cell has a sequence
+// number that says whether it is ready to be written or read on the current lap, so a push or pop is one
+// compare and swap on its end of the queue. The ends are on cache lines of their own.
+template<typename T>
+class mpmc_queue {
+public:
+	// Capacity is rounded up to a power of two
+	explicit mpmc_queue(usz capacity)
+	{
+		capacity = next_power_of_two(max(capacity, (usz)2));
+		m_cells = (Cell*)::operator new(capacity * sizeof(Cell), ::std::align_val_t(alignof(Cell)));
+		for (usz i = 0; i < capacity; ++i)
+		{
+			new (&m_cells[i]) Cell();
+			m_cells[i].sequence.store(i, ::std::memory_order_relaxed);
+		}
+		m_mask = capacity - 1;
+	}
+
+	~mpmc_queue()
+	{
+		usz push_position = m_push_position.load(::std::memory_order_relaxed);
+		for (usz position = m_pop_position.load(::std::memory_order_relaxed); position != push_position; ++position)
+		{
+			::std::launder((T*)m_cells[position & m_mask].storage)->~T();
+		}
+		for (usz i = 0; i <= m_mask; ++i)
+		{
+			m_cells[i].~Cell();
+		}
+		::operator delete(m_cells, ::std::align_val_t(alignof(Cell)));
+	}
+
+	mpmc_queue(const mpmc_queue&) = delete;
+	mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+	// Returns false if the queue is full, value is then left as it was
+	bool try_push(const T& value) { return try_emplace(value); }
+	bool try_push(T&& value) { return try_emplace(move(value)); }
+
+	template<typename... Args>
+	bool try_emplace(Args&&... args)
+	{
+		usz position = m_push_position.load(::std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell& cell = m_cells[position & m_mask];
+			usz sequence = cell.sequence.load(::std::memory_order_acquire);
+			sptr difference = (sptr)sequence - (sptr)position;
+			if (difference == 0)
+			{
+				if (m_push_position.compare_exchange_weak(position, position + 1, ::std::memory_order_relaxed))
+				{
+					new (cell.storage) T(forward<Args>(args)...);
+					cell.sequence.store(position + 1, ::std::memory_order_release);
+					m_waiter.notify_all();
+					return true;
+				}
+			}
+			else if (difference < 0)
+			{
+				return false;
+			}
+			else
+			{
+				position = m_push_position.load(::std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Returns false if the queue is empty
+	bool try_pop(out_ptr<T> out_value)
+	{
+		usz position = m_pop_position.load(::std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell& cell = m_cells[position & m_mask];
+			usz sequence = cell.sequence.load(::std::memory_order_acquire);
+			sptr difference = (sptr)sequence - (sptr)(position + 1);
+			if (difference == 0)
+			{
+				if (m_pop_position.compare_exchange_weak(position, position + 1, ::std::memory_order_relaxed))
+				{
+					T* value = ::std::launder((T*)cell.storage);
+					*out_value = move(*value);
+					value->~T();
+					// The cell is free for the push one lap later
+					cell.sequence.store(position + m_mask + 1, ::std::memory_order_release);
+					m_waiter.notify_all();
+					return true;
+				}
+			}
+			else if (difference < 0)
+			{
+				return false;
+			}
+			else
+			{
+				position = m_pop_position.load(::std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Blocks while the queue is full
+	void push(T&& value)
+	{
+		while (!try_emplace(move(value)))
+		{
+			m_waiter.wait([this] { return !full(); });
+		}
+	}
+
+	// Blocks while the queue is empty
+	void pop(out_ptr<T> out_value)
+	{
+		while (!try_pop(out_value))
+		{
+			m_waiter.wait([this] { return !empty(); });
+		}
+	}
+
+	// Only a hint while other threads push and pop
+	bool empty() const
+	{
+		usz position = m_pop_position.load(::std::memory_order_relaxed);
+		usz sequence = m_cells[position & m_mask].sequence.load(::std::memory_order_acquire);
+		return (sptr)sequence - (sptr)(position + 1) < 0;
+	}
+
+	// Only a hint while other threads push and pop
+	bool full() const
+	{
+		usz position = m_push_position.load(::std::memory_order_relaxed);
+		usz sequence = m_cells[position & m_mask].sequence.load(::std::memory_order_acquire);
+		return (sptr)sequence - (sptr)position < 0;
+	}
+
+	usz capacity() const { return m_mask + 1; }
+
+private:
+	struct Cell
+	{
+		::std::atomic<usz> sequence{};
+		alignas(T) u8 storage[sizeof(T)];
+	};
+
+	Cell* m_cells{};
+	usz m_mask{};
+	alignas(CACHE_LINE_SIZE) ::std::atomic<usz> m_push_position{};
+	alignas(CACHE_LINE_SIZE) ::std::atomic<usz> m_pop_position{};
+	alignas(CACHE_LINE_SIZE) queue_waiter m_waiter;
+};
+
+}
+
+using bstr::core::containers::mpmc_queue;
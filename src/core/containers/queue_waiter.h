@@ -0,0 +1,48 @@
+#pragma once
+
+#include "def.h"
+#include "utils.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+namespace bstr::core::containers {
+
+// Blocking for the lock-free queues. Threads that wait sleep on a condition variable, threads that
+// change the queue only touch it when someone is waiting, so queues cost nothing extra when nobody blocks.
+class queue_waiter {
+public:
+	// Returns when ready() is true. ready() reads the queue and is called with the lock held.
+	template<typename Func>
+	void wait(Func&& ready)
+	{
+		::std::unique_lock lock(m_mutex);
+		m_waiting_count.fetch_add(1, ::std::memory_order_relaxed);
+		// Pairs with the fence in notify_all, either the waiter sees the change or the notifier sees the waiter
+		::std::atomic_thread_fence(::std::memory_order_seq_cst);
+		m_condition.wait(lock, forward<Func>(ready));
+		m_waiting_count.fetch_sub(1, ::std::memory_order_relaxed);
+	}
+
+	// Called after every change to the queue
+	void notify_all()
+	{
+		::std::atomic_thread_fence(::std::memory_order_seq_cst);
+		if (m_waiting_count.load(::std::memory_order_relaxed) > 0)
+		{
+			// A waiter that has checked ready() but not started waiting yet holds the lock
+			{
+				::std::lock_guard lock(m_mutex);
+			}
+			m_condition.notify_all();
+		}
+	}
+
+private:
+	::std::atomic<u32> m_waiting_count{};
+	::std::mutex m_mutex;
+	::std::condition_variable m_condition;
+};
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "def.h"
+
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+namespace bstr::core::containers {
+
+// Types that can be moved to another address by copying their bytes, without running the move constructor
+// and the destructor. Specialize for types that are not trivially copyable but do not point into themselves,
+// e.g. most types that only own heap memory.
+template<class T>
+struct is_trivially_relocatable : ::std::bool_constant<::std::is_trivially_copyable_v<T>> {
+};
+
+// Moves count elements from src to uninitialized dst, src is left uninitialized. The ranges must not overlap.
+template<class T>
+void relocate(T* src, usz count, T* dst)
+{
+	if constexpr (is_trivially_relocatable<T>::value)
+	{
+		if (count > 0)
+		{
+			memcpy((void*)dst, (const void*)src, count * sizeof(T));
+		}
+	}
+	else
+	{
+		for (usz i = 0; i < count; ++i)
+		{
+			new (dst + i) T(::std::move(src[i]));
+			src[i].~T();
+		}
+	}
+}
+
+template<class T>
+void destroy_range(T* first, usz count)
+{
+	if constexpr (!::std::is_trivially_destructible_v<T>)
+	{
+		for (usz i = 0; i < count; ++i)
+		{
+			first[i].~T();
+		}
+	}
+}
+
+}
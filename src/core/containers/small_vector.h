@@ -0,0 +1,229 @@
+#pragma once
+
+#include "def.h"
+#include "utils.h"
+#include "relocate.h"
+
+#include <initializer_list>
+#include <new>
+
+namespace bstr::core::containers {
+
+// Vector with room for N elements inside of itself, it only allocates when it grows past that.
+// For temporaries and members that are almost always small. Growing relocates the elements with memcpy
+// when the type allows it.
+template<class T, usz N>
+class small_vector {
+	static_assert(N > 0, "use vector when there is no room for inline elements");
+
+public:
+	using value_type = T;
+	using iterator = T*;
+	using const_iterator = const T*;
+
+	small_vector() = default;
+
+	explicit small_vector(usz count)
+	{
+		resize(count);
+	}
+
+	small_vector(::std::initializer_list<T> values)
+	{
+		reserve(values.size());
+		for (const T& value : values)
+		{
+			push_back(value);
+		}
+	}
+
+	~small_vector()
+	{
+		clear();
+		free_heap_data();
+	}
+
+	small_vector(const small_vector& other)
+	{
+		reserve(other.m_size);
+		for (const T& value : other)
+		{
+			push_back(value);
+		}
+	}
+
+	small_vector& operator=(const small_vector& other)
+	{
+		if (this != &other)
+		{
+			clear();
+			reserve(other.m_size);
+			for (const T& value : other)
+			{
+				push_back(value);
+			}
+		}
+		return *this;
+	}
+
+	small_vector(small_vector&& other)
+	{
+		take(other);
+	}
+
+	small_vector& operator=(small_vector&& other)
+	{
+		if (this != &other)
+		{
+			clear();
+			free_heap_data();
+			take(other);
+		}
+		return *this;
+	}
+
+	template<class... Args>
+	T& emplace_back(Args&&... args)
+	{
+		if (m_size == m_capacity)
+		{
+			// The new element is constructed before the old ones move, the arguments may refer to them
+			usz new_capacity = m_capacity * 2;
+			T* new_data = allocate(new_capacity);
+			T* result = new (new_data + m_size) T(forward<Args>(args)...);
+			move_to(new_data, new_capacity);
+			m_size += 1;
+			return *result;
+		}
+
+		T* result = new (m_data + m_size) T(forward<Args>(args)...);
+		m_size += 1;
+		return *result;
+	}
+
+	void push_back(const T& value) { emplace_back(value); }
+	void push_back(T&& value) { emplace_back(move(value)); }
+
+	void pop_back()
+	{
+		ASSERT(m_size > 0, "small_vector is empty");
+		m_size -= 1;
+		m_data[m_size].~T();
+	}
+
+	// Keeps the order of the rest, returns the element after the erased one
+	T* erase(const T* position)
+	{
+		usz index = (usz)(position - m_data);
+		ASSERT(index < m_size, "small_vector erase out of bounds");
+		for (usz i = index; i + 1 < m_size; ++i)
+		{
+			m_data[i] = move(m_data[i + 1]);
+		}
+		pop_back();
+		return m_data + index;
+	}
+
+	void reserve(usz capacity)
+	{
+		if (capacity > m_capacity)
+		{
+			move_to(allocate(capacity), capacity);
+		}
+	}
+
+	void resize(usz count)
+	{
+		reserve(count);
+		while (m_size > count)
+		{
+			pop_back();
+		}
+		while (m_size < count)
+		{
+			new (m_data + m_size) T();
+			m_size += 1;
+		}
+	}
+
+	// Keeps the memory, like vector
+	void clear()
+	{
+		destroy_range(m_data, m_size);
+		m_size = 0;
+	}
+
+	T* data() { return m_data; }
+	const T* data() const { return m_data; }
+	usz size() const { return m_size; }
+	usz capacity() const { return m_capacity; }
+	bool empty() const { return m_size == 0; }
+	bool is_inline() const { return m_data == inline_data(); }
+
+	T& operator[](usz i) { ASSERT(i < m_size, "small_vector out of bounds"); return m_data[i]; }
+	const T& operator[](usz i) const { ASSERT(i < m_size, "small_vector out of bounds"); return m_data[i]; }
+	T& front() { return (*this)[0]; }
+	const T& front() const { return (*this)[0]; }
+	T& back() { return (*this)[m_size - 1]; }
+	const T& back() const { return (*this)[m_size - 1]; }
+
+	T* begin() { return m_data; }
+	T* end() { return m_data + m_size; }
+	const T* begin() const { return m_data; }
+	const T* end() const { return m_data + m_size; }
+
+private:
+	T* inline_data() { return (T*)m_inline; }
+	const T* inline_data() const { return (const T*)m_inline; }
+
+	static T* allocate(usz capacity)
+	{
+		T* result = (T*)::operator new(capacity * sizeof(T), ::std::align_val_t(alignof(T)));
+		return result;
+	}
+
+	void free_heap_data()
+	{
+		if (!is_inline())
+		{
+			::operator delete(m_data, ::std::align_val_t(alignof(T)));
+			m_data = inline_data();
+			m_capacity = N;
+		}
+	}
+
+	void move_to(T* new_data, usz new_capacity)
+	{
+		relocate(m_data, m_size, new_data);
+		free_heap_data();
+		m_data = new_data;
+		m_capacity = new_capacity;
+	}
+
+	// other is left empty and inline
+	void take(small_vector& other)
+	{
+		if (other.is_inline())
+		{
+			relocate(other.m_data, other.m_size, inline_data());
+		}
+		else
+		{
+			m_data = other.m_data;
+			m_capacity = other.m_capacity;
+			other.m_data = other.inline_data();
+			other.m_capacity = N;
+		}
+		m_size = other.m_size;
+		other.m_size = 0;
+	}
+
+	T* m_data = inline_data();
+	usz m_size = 0;
+	usz m_capacity = N;
+	alignas(T) u8 m_inline[N * sizeof(T)];
+};
+
+}
+
+using bstr::core::containers::small_vector;
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "def.h"
+#include "out_ptr.h"
+#include "utils.h"
+#include "queue_waiter.h"
+
+#include <atomic>
+#include <new>
+
+namespace bstr::core::containers {
+
+// Bounded wait-free ring for exactly one producer thread and one consumer thread. Each side keeps a copy
+// of the other side's index and only reloads it when the ring looks full or empty, so the index cache
+// lines only move between cores when they have to.
+template<typename T>
+class spsc_queue {
+public:
+	// Capacity is rounded up to a power of two
+	explicit spsc_queue(usz capacity)
+	{
+		capacity = next_power_of_two(max(capacity, (usz)2));
+		m_slots = (Slot*)::operator new(capacity * sizeof(Slot), ::std::align_val_t(alignof(Slot)));
+		m_mask = capacity - 1;
+	}
+
+	~spsc_queue()
+	{
+		usz tail = m_tail.load(::std::memory_order_relaxed);
+		for (usz head = m_head.load(::std::memory_order_relaxed); head != tail; ++head)
+		{
+			::std::launder((T*)m_slots[head & m_mask].storage)->~T();
+		}
+		::operator delete(m_slots, ::std::align_val_t(alignof(Slot)));
+	}
+
+	spsc_queue(const spsc_queue&) = delete;
+	spsc_queue& operator=(const spsc_queue&) = delete;
+
+	// Producer only. Returns false if the queue is full, value is then left as it was.
+	bool try_push(const T& value) { return try_emplace(value); }
+	bool try_push(T&& value) { return try_emplace(move(value)); }
+
+	template<typename... Args>
+	bool try_emplace(Args&&... args)
+	{
+		usz tail = m_tail.load(::std::memory_order_relaxed);
+		if (tail - m_cached_head > m_mask)
+		{
+			m_cached_head = m_head.load(::std::memory_order_acquire);
+			if (tail - m_cached_head > m_mask)
+			{
+				return false;
+			}
+		}
+		new (m_slots[tail & m_mask].storage) T(forward<Args>(args)...);
+		m_tail.store(tail + 1, ::std::memory_order_release);
+		m_waiter.notify_all();
+		return true;
+	}
+
+	// Consumer only. Returns false if the queue is empty.
+	bool try_pop(out_ptr<T> out_value)
+	{
+		usz head = m_head.load(::std::memory_order_relaxed);
+		if (head == m_cached_tail)
+		{
+			m_cached_tail = m_tail.load(::std::memory_order_acquire);
+			if (head == m_cached_tail)
+			{
+				return false;
+			}
+		}
+		T* value = ::std::launder((T*)m_slots[head & m_mask].storage);
+		*out_value = move(*value);
+		value->~T();
+		m_head.store(head + 1, ::std::memory_order_release);
+		m_waiter.notify_all();
+		return true;
+	}
+
+	// Producer only. Blocks while the queue is full.
+	void push(T&& value)
+	{
+		while (!try_emplace(move(value)))
+		{
+			m_waiter.wait([this] { return m_tail.load(::std::memory_order_relaxed) - m_head.load(::std::memory_order_acquire) <= m_mask; });
+		}
+	}
+
+	// Consumer only. Blocks while the queue is empty.
+	void pop(out_ptr<T> out_value)
+	{
+		while (!try_pop(out_value))
+		{
+			m_waiter.wait([this] { return m_head.load(::std::memory_order_relaxed) != m_tail.load(::std::memory_order_acquire); });
+		}
+	}
+
+	// Exact on either side, a hint on any other thread
+	usz size() const { return m_tail.load(::std::memory_order_acquire) - m_head.load(::std::memory_order_acquire); }
+	bool empty() const { return size() == 0; }
+	usz capacity() const { return m_mask + 1; }
+
+private:
+	struct Slot
+	{
+		alignas(T) u8 storage[sizeof(T)];
+	};
+
+	Slot* m_slots{};
+	usz m_mask{};
+
+	// Written by the consumer
+	alignas(CACHE_LINE_SIZE) ::std::atomic<usz> m_head{};
+	usz m_cached_tail{};
+
+	// Written by the producer
+	alignas(CACHE_LINE_SIZE) ::std::atomic<usz> m_tail{};
+	usz m_cached_head{};
+
+	alignas(CACHE_LINE_SIZE) queue_waiter m_waiter;
+};
+
+}
+
+using bstr::core::containers::spsc_queue;
@@ -59,5 +59,6 @@ static constexpr auto TiB = 1024ull * GiB; // Tebibyte
 static constexpr auto PiB = 1024ull * TiB; // Pebibyte
 
 static constexpr auto PAGE_SIZE = 4 * KiB;
+static constexpr usz CACHE_LINE_SIZE = 64;
 
 }
\ No newline at end of file
@@ -0,0 +1,411 @@
+#include "image.h"
+#include "simd.h"
+#include "utils.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace bstr::core {
+
+void expand_r8_to_rgba8(non_null<const u8> src, non_null<u32> dst, usz count)
+{
+    usz i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i values = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo16 = _mm_unpacklo_epi8(values, values);
+        __m128i hi16 = _mm_unpackhi_epi8(values, values);
+        _mm_storeu_si128((__m128i*)(dst + i + 0), _mm_unpacklo_epi16(lo16, lo16));
+        _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(lo16, lo16));
+        _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpacklo_epi16(hi16, hi16));
+        _mm_storeu_si128((__m128i*)(dst + i + 12), _mm_unpackhi_epi16(hi16, hi16));
+    }
+    for (; i < count; ++i)
+    {
+        u32 value = src[i];
+        dst[i] = value * 0x01010101u;
+    }
+}
+
+// x * a / 255 rounded to nearest, exact for any 16-bit product
+static inline __m128i div255_epu16(__m128i x)
+{
+    __m128i t = _mm_add_epi16(x, _mm_set1_epi16(128));
+    __m128i result = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    return result;
+}
+
+static inline __m128i premultiply_pixels_epu16(__m128i pixels)
+{
+    // Broadcast alpha to every channel of its pixel, and multiply alpha itself by 255 so it stays the same
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i alpha_mask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    __m128i factors = _mm_or_si128(_mm_andnot_si128(alpha_mask, alpha), _mm_and_si128(alpha_mask, _mm_set1_epi16(255)));
+    __m128i result = div255_epu16(_mm_mullo_epi16(pixels, factors));
+    return result;
+}
+
+void premultiply_alpha(non_null<u32> pixels, usz count)
+{
+    __m128i zero = _mm_setzero_si128();
+    usz i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i values = _mm_loadu_si128((const __m128i*)(pixels + i));
+        __m128i lo = premultiply_pixels_epu16(_mm_unpacklo_epi8(values, zero));
+        __m128i hi = premultiply_pixels_epu16(_mm_unpackhi_epi8(values, zero));
+        _mm_storeu_si128((__m128i*)(pixels + i), _mm_packus_epi16(lo, hi));
+    }
+    for (; i < count; ++i)
+    {
+        u32 value = pixels[i];
+        u32 a = value >> 24;
+        u32 result = value & 0xff000000u;
+        for (u32 shift = 0; shift < 24; shift += 8)
+        {
+            u32 t = ((value >> shift) & 0xff) * a + 128;
+            result |= ((t + (t >> 8)) >> 8) << shift;
+        }
+        pixels[i] = result;
+    }
+}
+
+u32 get_mip_count(u32 width, u32 height)
+{
+    u32 size = max(width, height);
+    u32 result = 1;
+    while (size > 1)
+    {
+        size >>= 1;
+        result += 1;
+    }
+    return result;
+}
+
+u32 get_mip_dimension(u32 size, u32 level)
+{
+    u32 result = max(size >> level, 1u);
+    return result;
+}
+
+usz get_mip_chain_size(BlockCompression compression, u32 width, u32 height, u32 mip_count)
+{
+    usz result = 0;
+    for (u32 level = 0; level < mip_count; ++level)
+    {
+        result += block_compressed_size(compression, get_mip_dimension(width, level), get_mip_dimension(height, level));
+    }
+    return result;
+}
+
+static constexpr u32 LINEAR_TO_SRGB_TABLE_SIZE = 4096;
+
+struct SrgbTables
+{
+    f32 srgb_to_linear[256];
+    u8 linear_to_srgb[LINEAR_TO_SRGB_TABLE_SIZE];
+
+    SrgbTables()
+    {
+        for (u32 i = 0; i < 256; ++i)
+        {
+            f32 c = (f32)i / 255.f;
+            srgb_to_linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (u32 i = 0; i < LINEAR_TO_SRGB_TABLE_SIZE; ++i)
+        {
+            f32 c = (f32)i / (f32)(LINEAR_TO_SRGB_TABLE_SIZE - 1);
+            f32 srgb = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.f / 2.4f) - 0.055f;
+            linear_to_srgb[i] = (u8)(srgb * 255.f + 0.5f);
+        }
+    }
+};
+
+static const SrgbTables& get_srgb_tables()
+{
+    static const SrgbTables tables;
+    return tables;
+}
+
+// Pixels are filtered as four floats RGBA, linear and premultiplied
+static void load_level(const u8* pixels, usz count, u32 flags, f32* out)
+{
+    const SrgbTables& tables = get_srgb_tables();
+    __m128 scale = _mm_set1_ps(1.f / 255.f);
+    for (usz i = 0; i < count; ++i)
+    {
+        const u8* p = pixels + i * 4;
+        __m128 color;
+        if (flags & MipFlags_Srgb)
+        {
+            color = _mm_setr_ps(
+                tables.srgb_to_linear[p[0]], tables.srgb_to_linear[p[1]], tables.srgb_to_linear[p[2]], (f32)p[3] / 255.f);
+        }
+        else
+        {
+            __m128i rgba = _mm_cvtsi32_si128(*(const s32*)p);
+            rgba = _mm_unpacklo_epi16(_mm_unpacklo_epi8(rgba, _mm_setzero_si128()), _mm_setzero_si128());
+            color = _mm_mul_ps(_mm_cvtepi32_ps(rgba), scale);
+        }
+        if (!(flags & MipFlags_Premultiplied))
+        {
+            __m128 alpha = _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 3, 3, 3));
+            __m128 premultiplied = _mm_mul_ps(color, alpha);
+            color = _mm_shuffle_ps(premultiplied, _mm_unpackhi_ps(premultiplied, color), _MM_SHUFFLE(3, 0, 1, 0));
+        }
+        _mm_storeu_ps(out + i * 4, color);
+    }
+}
+
+static void store_level(const f32* colors, usz count, u32 flags, u8* out_pixels)
+{
+    const SrgbTables& tables = get_srgb_tables();
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.f);
+    for (usz i = 0; i < count; ++i)
+    {
+        __m128 color = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(colors + i * 4), zero), one);
+        __m128 alpha = _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 3, 3, 3));
+        if (!(flags & MipFlags_Premultiplied))
+        {
+            // Fully transparent pixels stay black
+            __m128 has_alpha = _mm_cmpgt_ps(alpha, zero);
+            __m128 straight = _mm_and_ps(_mm_div_ps(color, _mm_or_ps(alpha, _mm_andnot_ps(has_alpha, one))), has_alpha);
+            straight = _mm_min_ps(straight, one);
+            color = _mm_shuffle_ps(straight, _mm_unpackhi_ps(straight, color), _MM_SHUFFLE(3, 0, 1, 0));
+        }
+
+        alignas(16) f32 c[4];
+        _mm_store_ps(c, color);
+        u8* p = out_pixels + i * 4;
+        if (flags & MipFlags_Srgb)
+        {
+            for (u32 channel = 0; channel < 3; ++channel)
+            {
+                p[channel] = tables.linear_to_srgb[(u32)(c[channel] * (f32)(LINEAR_TO_SRGB_TABLE_SIZE - 1) + 0.5f)];
+            }
+        }
+        else
+        {
+            for (u32 channel = 0; channel < 3; ++channel)
+            {
+                p[channel] = (u8)(c[channel] * 255.f + 0.5f);
+            }
+        }
+        p[3] = (u8)(c[3] * 255.f + 0.5f);
+    }
+}
+
+static constexpr u32 KAISER_TAPS = 8;
+
+static f32 bessel_i0(f32 x)
+{
+    f32 result = 1.f;
+    f32 term = 1.f;
+    for (u32 k = 1; k < 16; ++k)
+    {
+        f32 half_x_over_k = x / (2.f * (f32)k);
+        term *= half_x_over_k * half_x_over_k;
+        result += term;
+    }
+    return result;
+}
+
+// Weights of the source pixels 2i-3 .. 2i+4 for output pixel i. The filter is centered between
+// source pixels 2i and 2i+1, with a radius of 4 source pixels.
+static void get_kaiser_weights(f32 out_weights[KAISER_TAPS])
+{
+    const f32 pi = 3.14159265358979f;
+    const f32 kaiser_alpha = 4.f;
+    f32 sum = 0.f;
+    for (u32 tap = 0; tap < KAISER_TAPS; ++tap)
+    {
+        f32 d = (f32)tap - 3.5f;
+        f32 x = d / 2.f;
+        f32 sinc = fabsf(x) < 1e-6f ? 1.f : sinf(pi * x) / (pi * x);
+        f32 t = d / 4.f;
+        f32 window = bessel_i0(kaiser_alpha * sqrtf(max(1.f - t * t, 0.f))) / bessel_i0(kaiser_alpha);
+        out_weights[tap] = sinc * window;
+        sum += out_weights[tap];
+    }
+    for (u32 tap = 0; tap < KAISER_TAPS; ++tap)
+    {
+        out_weights[tap] /= sum;
+    }
+}
+
+// Source pixel of tap 0 of output pixel i is 2i - KAISER_FIRST_TAP
+static constexpr u32 KAISER_FIRST_TAP = 3;
+
+static inline __m128 load_pixel(const f32* pixels, usz index)
+{
+    __m128 result = _mm_loadu_ps(pixels + index * 4);
+    return result;
+}
+
+static inline __m128 filter_kaiser_clamped(const f32* src_row, u32 src_width, u32 i, const __m128 weights[KAISER_TAPS])
+{
+    __m128 result = _mm_setzero_ps();
+    for (u32 tap = 0; tap < KAISER_TAPS; ++tap)
+    {
+        s32 x = (s32)(2 * i + tap) - (s32)KAISER_FIRST_TAP;
+        x = x < 0 ? 0 : x >= (s32)src_width ? (s32)src_width - 1 : x;
+        result = _mm_add_ps(result, _mm_mul_ps(load_pixel(src_row, (usz)x), weights[tap]));
+    }
+    return result;
+}
+
+// Halves the width of height rows. Only the output pixels at the ends of a row read past the edge,
+// the ones between them are filtered two at a time without clamping.
+static void downsample_rows(
+    const f32* src, f32* dst, u32 src_width, u32 dst_width, u32 height, MipFilter filter, const __m128 weights[KAISER_TAPS])
+{
+    if (src_width == 1)
+    {
+        memcpy(dst, src, (usz)height * 4 * sizeof(f32));
+        return;
+    }
+
+    // Output pixels whose every tap is inside the row
+    u32 interior_begin = min(KAISER_FIRST_TAP / 2 + 1, dst_width);
+    u32 interior_end = src_width >= KAISER_TAPS - KAISER_FIRST_TAP ? (src_width - (KAISER_TAPS - KAISER_FIRST_TAP)) / 2 + 1 : 0;
+    interior_end = max(min(interior_end, dst_width), interior_begin);
+
+    __m128 half = _mm_set1_ps(0.5f);
+    for (u32 y = 0; y < height; ++y)
+    {
+        const f32* src_row = src + (usz)y * src_width * 4;
+        f32* dst_row = dst + (usz)y * dst_width * 4;
+        if (filter == MipFilter_Box)
+        {
+            for (u32 i = 0; i < dst_width; ++i)
+            {
+                __m128 sum = _mm_add_ps(load_pixel(src_row, 2 * i), load_pixel(src_row, 2 * i + 1));
+                _mm_storeu_ps(dst_row + (usz)i * 4, _mm_mul_ps(sum, half));
+            }
+            continue;
+        }
+
+        u32 i = 0;
+        for (; i < interior_begin; ++i)
+        {
+            _mm_storeu_ps(dst_row + (usz)i * 4, filter_kaiser_clamped(src_row, src_width, i, weights));
+        }
+        // The taps of output pixel i + 1 are those of i moved by two source pixels
+        for (; i + 2 <= interior_end; i += 2)
+        {
+            const f32* taps = src_row + (usz)(2 * i - KAISER_FIRST_TAP) * 4;
+            __m128 sum0 = _mm_setzero_ps();
+            __m128 sum1 = _mm_setzero_ps();
+            for (u32 tap = 0; tap < KAISER_TAPS; ++tap)
+            {
+                sum0 = _mm_add_ps(sum0, _mm_mul_ps(load_pixel(taps, tap), weights[tap]));
+                sum1 = _mm_add_ps(sum1, _mm_mul_ps(load_pixel(taps, tap + 2), weights[tap]));
+            }
+            _mm_storeu_ps(dst_row + (usz)i * 4, sum0);
+            _mm_storeu_ps(dst_row + (usz)(i + 1) * 4, sum1);
+        }
+        for (; i < dst_width; ++i)
+        {
+            _mm_storeu_ps(dst_row + (usz)i * 4, filter_kaiser_clamped(src_row, src_width, i, weights));
+        }
+    }
+}
+
+// Halves the height. Every output row is a weighted sum of whole source rows, so the rows are clamped
+// to the image once per output row and the sum runs over all the floats of the row.
+static void downsample_columns(
+    const f32* src, f32* dst, u32 width, u32 src_height, u32 dst_height, MipFilter filter, const __m128 weights[KAISER_TAPS])
+{
+    usz row_floats = (usz)width * 4;
+    if (src_height == 1)
+    {
+        memcpy(dst, src, row_floats * sizeof(f32));
+        return;
+    }
+
+    __m128 half = _mm_set1_ps(0.5f);
+    for (u32 y = 0; y < dst_height; ++y)
+    {
+        f32* dst_row = dst + y * row_floats;
+        if (filter == MipFilter_Box)
+        {
+            const f32* row0 = src + (usz)(2 * y) * row_floats;
+            const f32* row1 = row0 + row_floats;
+            for (usz i = 0; i < row_floats; i += 4)
+            {
+                __m128 sum = _mm_add_ps(_mm_loadu_ps(row0 + i), _mm_loadu_ps(row1 + i));
+                _mm_storeu_ps(dst_row + i, _mm_mul_ps(sum, half));
+            }
+            continue;
+        }
+
+        const f32* rows[KAISER_TAPS];
+        for (u32 tap = 0; tap < KAISER_TAPS; ++tap)
+        {
+            s32 row = (s32)(2 * y + tap) - (s32)KAISER_FIRST_TAP;
+            row = row < 0 ? 0 : row >= (s32)src_height ? (s32)src_height - 1 : row;
+            rows[tap] = src + (usz)row * row_floats;
+        }
+        for (usz i = 0; i < row_floats; i += 4)
+        {
+            __m128 sum = _mm_setzero_ps();
+            for (u32 tap = 0; tap < KAISER_TAPS; ++tap)
+            {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[tap] + i), weights[tap]));
+            }
+            _mm_storeu_ps(dst_row + i, sum);
+        }
+    }
+}
+
+void generate_mip_chain(non_null<const u8> pixels, u32 width, u32 height, MipFilter filter, u32 flags, non_null<u8> out_chain)
+{
+    ASSERT(width > 0 && height > 0, "");
+
+    usz level_size = (usz)width * height * 4;
+    memcpy(out_chain, pixels, level_size);
+
+    // Four floats per pixel
+    vector<f32> level((usz)width * height * 4);
+    vector<f32> half_width;
+    vector<f32> next_level;
+    load_level(pixels, (usz)width * height, flags, level.data());
+
+    __m128 weights[KAISER_TAPS] = {};
+    if (filter == MipFilter_Kaiser)
+    {
+        f32 kaiser_weights[KAISER_TAPS];
+        get_kaiser_weights(kaiser_weights);
+        for (u32 tap = 0; tap < KAISER_TAPS; ++tap)
+        {
+            weights[tap] = _mm_set1_ps(kaiser_weights[tap]);
+        }
+    }
+
+    u8* out = out_chain + level_size;
+    u32 mip_count = get_mip_count(width, height);
+    u32 level_width = width;
+    u32 level_height = height;
+    for (u32 mip = 1; mip < mip_count; ++mip)
+    {
+        u32 next_width = max(level_width / 2, 1u);
+        u32 next_height = max(level_height / 2, 1u);
+
+        // Separable, first the rows and then the columns
+        half_width.resize((usz)next_width * level_height * 4);
+        downsample_rows(level.data(), half_width.data(), level_width, next_width, level_height, filter, weights);
+        next_level.resize((usz)next_width * next_height * 4);
+        downsample_columns(half_width.data(), next_level.data(), next_width, level_height, next_height, filter, weights);
+
+        usz pixel_count = (usz)next_width * next_height;
+        store_level(next_level.data(), pixel_count, flags, out);
+        out += pixel_count * 4;
+
+        level.swap(next_level);
+        level_width = next_width;
+        level_height = next_height;
+    }
+}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "def.h"
+#include "non_null.h"
+#include "bcn.h"
+
+namespace bstr::core {
+
+// Pixel conversion kernels for image and texture data. Pixels are RGBA8 packed into u32 in memory order,
+// so r is the lowest byte.
+
+// Replicates each 8-bit value to all four channels, e.g. to use a one channel font atlas
+// where a one channel texture format is not available.
+void expand_r8_to_rgba8(non_null<const u8> src, non_null<u32> dst, usz count);
+
+// Multiplies the colors of count RGBA8 pixels by their alpha in place, rounded to nearest.
+// Done to images when they are loaded, the renderer blends premultiplied colors.
+void premultiply_alpha(non_null<u32> pixels, usz count);
+
+enum MipFilter : u32 {
+    MipFilter_Box, // Average of 2x2 pixels, fast but blurs and aliases a little
+    MipFilter_Kaiser, // 8 tap Kaiser windowed sinc, sharper
+};
+
+enum MipFlags : u32 {
+    MipFlags_None = 0,
+    MipFlags_Srgb = 1 << 0, // Pixels are sRGB encoded and are filtered in linear space
+    MipFlags_Premultiplied = 1 << 1, // Colors are already multiplied by alpha, otherwise they are weighted by alpha when filtering
+};
+
+// Levels down to 1x1, each level is half the size of the previous one rounded down
+u32 get_mip_count(u32 width, u32 height);
+u32 get_mip_dimension(u32 size, u32 level);
+
+// Bytes of mip_count levels stored one after another, compressed with compression
+usz get_mip_chain_size(BlockCompression compression, u32 width, u32 height, u32 mip_count);
+
+// Writes every level of the chain to out_chain, starting with a copy of the pixels.
+// out_chain must have get_mip_chain_size(BlockCompression_None, width, height, get_mip_count(width, height)) bytes.
+// Each level is filtered from the previous one in floating point, so the error does not add up.
+void generate_mip_chain(non_null<const u8> pixels, u32 width, u32 height, MipFilter filter, u32 flags, non_null<u8> out_chain);
+
+}
@@ -0,0 +1,275 @@
+#include "image_cache.h"
+#include "utils.h"
+
+#include "zlib.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace bstr::core {
+
+static constexpr u32 IMAGE_CACHE_MAGIC = 0x474D4942; // "BIMG"
+
+CachedImage::~CachedImage()
+{
+    platform::unmap_file(&m_mapping);
+}
+
+CachedImage::CachedImage(CachedImage&& other)
+{
+    *this = move(other);
+}
+
+CachedImage& CachedImage::operator=(CachedImage&& other)
+{
+    if (this != &other)
+    {
+        platform::unmap_file(&m_mapping);
+        m_mapping = other.m_mapping;
+        m_decompressed = move(other.m_decompressed);
+        m_pixels = other.m_pixels;
+        m_width = other.m_width;
+        m_height = other.m_height;
+        m_compression = other.m_compression;
+        m_mip_count = other.m_mip_count;
+
+        other.m_mapping = {};
+        other.m_pixels = nullptr;
+        other.m_width = 0;
+        other.m_height = 0;
+    }
+    return *this;
+}
+
+ImageCache::ImageCache(string directory)
+    : m_directory(move(directory))
+{
+    if (!platform::create_directory(m_directory.c_str()))
+    {
+        LOG_ERROR("Could not create image cache directory {}", m_directory);
+    }
+}
+
+// Written to a temporary file first, so that a crash never leaves a partial cache file behind.
+// An image loaded from the old file may still map it, in which case the old file stays until the next write.
+static bool write_cache_file(const string& filename, const void* header, usz header_size, const void* data, usz data_size)
+{
+    string temp_filename = filename + ".tmp";
+    FILE* file = fopen(temp_filename.c_str(), "wb");
+    if (!file)
+    {
+        LOG_ERROR("Could not write image cache file {}", temp_filename);
+        return false;
+    }
+    bool written = fwrite(header, header_size, 1, file) == 1
+        && (data_size == 0 || fwrite(data, 1, data_size, file) == data_size);
+    fclose(file);
+
+    if (!written)
+    {
+        LOG_ERROR("Could not write image cache file {}", temp_filename);
+        remove(temp_filename.c_str());
+        return false;
+    }
+    if (!platform::replace_file(temp_filename.c_str(), filename.c_str()))
+    {
+        LOG_WARN("Image cache file {} is in use, not replaced", filename);
+        remove(temp_filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+string ImageCache::make_index_filename(const char* source_filename) const
+{
+    string canonical_path = platform::get_canonical_path(source_filename);
+    if (canonical_path.empty())
+    {
+        canonical_path = source_filename;
+    }
+    u64 path_hash = hash_bytes(canonical_path.data(), canonical_path.size());
+    string result = fmt::format("{}{}{:016x}.index", m_directory, platform::PATH_DELIMITER, path_hash);
+    return result;
+}
+
+string ImageCache::make_image_filename(u64 source_hash, u32 flags, BlockCompression compression) const
+{
+    // Zlib is only how the file is stored, the same contents either way
+    u32 content_flags = flags & ~ImageCacheFlags_Zlib;
+    u64 image_hash = hash_bytes(&source_hash, sizeof(source_hash));
+    image_hash = hash_bytes(&content_flags, sizeof(content_flags), image_hash);
+    image_hash = hash_bytes(&compression, sizeof(compression), image_hash);
+    string result = fmt::format("{}{}{:016x}.image", m_directory, platform::PATH_DELIMITER, image_hash);
+    return result;
+}
+
+bool ImageCache::get_source_hash(const char* source_filename, out_ptr<u64> out_hash) const
+{
+    u64 source_size = platform::get_file_size(source_filename);
+    u64 source_modify_time = platform::get_file_modify_time(source_filename);
+
+    ImageCacheIndexEntry entry = {};
+    string index_filename = make_index_filename(source_filename);
+    FILE* file = fopen(index_filename.c_str(), "rb");
+    if (file)
+    {
+        if (fread(&entry, sizeof(entry), 1, file) != 1)
+        {
+            entry = {};
+        }
+        fclose(file);
+    }
+    bool is_up_to_date = entry.magic == IMAGE_CACHE_MAGIC
+        && entry.version == IMAGE_CACHE_VERSION
+        && entry.source_size == source_size
+        && entry.source_modify_time == source_modify_time;
+    if (is_up_to_date)
+    {
+        *out_hash = entry.source_hash;
+        return true;
+    }
+
+    // e.g. after a fresh checkout only the time differs, then the contents hash the same as before
+    vector<u8> source_data = read_entire_file_as_bytes(source_filename);
+    if (source_data.empty())
+    {
+        return false;
+    }
+    u64 source_hash = hash_bytes(source_data.data(), source_data.size());
+    store_index(source_filename, source_hash, source_data.size());
+    *out_hash = source_hash;
+    return true;
+}
+
+void ImageCache::store_index(const char* source_filename, u64 source_hash, u64 source_size) const
+{
+    ImageCacheIndexEntry entry = {};
+    entry.magic = IMAGE_CACHE_MAGIC;
+    entry.version = IMAGE_CACHE_VERSION;
+    entry.source_hash = source_hash;
+    entry.source_modify_time = platform::get_file_modify_time(source_filename);
+    entry.source_size = source_size;
+    write_cache_file(make_index_filename(source_filename), &entry, sizeof(entry), nullptr, 0);
+}
+
+bool ImageCache::load(non_null<const char> source_filename, u32 flags, BlockCompression compression, out_ptr<CachedImage> out_image) const
+{
+    u64 source_hash;
+    if (!get_source_hash(source_filename, &source_hash))
+    {
+        return false;
+    }
+    string image_filename = make_image_filename(source_hash, flags, compression);
+
+    CachedImage image;
+    if (!platform::map_file_read_only(image_filename.c_str(), &image.m_mapping))
+    {
+        return false;
+    }
+
+    ImageCacheHeader header;
+    if (image.m_mapping.size < sizeof(header))
+    {
+        return false;
+    }
+    memcpy(&header, image.m_mapping.data, sizeof(header));
+
+    bool is_valid_header = header.magic == IMAGE_CACHE_MAGIC
+        && header.version == IMAGE_CACHE_VERSION
+        && header.source_hash == source_hash
+        && header.compression == compression
+        && (header.flags & ~ImageCacheFlags_Zlib) == (flags & ~ImageCacheFlags_Zlib)
+        && header.stored_size <= image.m_mapping.size - sizeof(header);
+    if (!is_valid_header)
+    {
+        return false;
+    }
+    u32 padded_width = get_block_padded_dimension(compression, header.width);
+    u32 padded_height = get_block_padded_dimension(compression, header.height);
+    u32 expected_mip_count = (flags & ImageCacheFlags_Mipmapped) ? get_mip_count(padded_width, padded_height) : 1;
+    if (header.mip_count != expected_mip_count)
+    {
+        return false;
+    }
+    usz pixels_size = get_mip_chain_size(compression, padded_width, padded_height, header.mip_count);
+    if (!(header.flags & ImageCacheFlags_Zlib) && header.stored_size != pixels_size)
+    {
+        return false;
+    }
+
+    const u8* stored = image.m_mapping.data + sizeof(header);
+    if (header.flags & ImageCacheFlags_Zlib)
+    {
+        image.m_decompressed.resize(pixels_size);
+        uLongf decompressed_size = (uLongf)pixels_size;
+        int res = uncompress(image.m_decompressed.data(), &decompressed_size, stored, (uLong)header.stored_size);
+        if (res != Z_OK || decompressed_size != pixels_size)
+        {
+            LOG_ERROR("Corrupted image cache file {}", image_filename);
+            return false;
+        }
+        platform::unmap_file(&image.m_mapping);
+        image.m_pixels = image.m_decompressed.data();
+    }
+    else
+    {
+        image.m_pixels = stored;
+    }
+    image.m_width = header.width;
+    image.m_height = header.height;
+    image.m_compression = compression;
+    image.m_mip_count = header.mip_count;
+
+    *out_image = move(image);
+    return true;
+}
+
+void ImageCache::store(
+    non_null<const char> source_filename,
+    const vector<u8>& source_data,
+    non_null<const u8> pixels, u32 width, u32 height, u32 flags, BlockCompression compression) const
+{
+    u32 padded_width = get_block_padded_dimension(compression, width);
+    u32 padded_height = get_block_padded_dimension(compression, height);
+    u32 mip_count = (flags & ImageCacheFlags_Mipmapped) ? get_mip_count(padded_width, padded_height) : 1;
+    usz pixels_size = get_mip_chain_size(compression, padded_width, padded_height, mip_count);
+
+    const u8* stored = pixels;
+    usz stored_size = pixels_size;
+    vector<u8> compressed;
+    if (flags & ImageCacheFlags_Zlib)
+    {
+        uLongf compressed_size = compressBound((uLong)pixels_size);
+        compressed.resize(compressed_size);
+        int res = compress2(compressed.data(), &compressed_size, pixels, (uLong)pixels_size, Z_BEST_SPEED);
+        if (res == Z_OK)
+        {
+            stored = compressed.data();
+            stored_size = compressed_size;
+        }
+        else
+        {
+            flags &= ~ImageCacheFlags_Zlib;
+        }
+    }
+
+    u64 source_hash = hash_bytes(source_data.data(), source_data.size());
+
+    ImageCacheHeader header = {};
+    header.magic = IMAGE_CACHE_MAGIC;
+    header.version = IMAGE_CACHE_VERSION;
+    header.source_hash = source_hash;
+    header.width = width;
+    header.height = height;
+    header.flags = flags;
+    header.compression = compression;
+    header.mip_count = mip_count;
+    header.stored_size = stored_size;
+
+    if (write_cache_file(make_image_filename(source_hash, flags, compression), &header, sizeof(header), stored, stored_size))
+    {
+        store_index(source_filename, source_hash, source_data.size());
+    }
+}
+
+}
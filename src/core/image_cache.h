@@ -0,0 +1,113 @@
+#pragma once
+
+#include "def.h"
+#include "bcn.h"
+#include "image.h"
+#include "non_null.h"
+#include "out_ptr.h"
+#include "platform.h"
+#include "containers/string.h"
+#include "containers/vector.h"
+
+namespace bstr::core {
+
+// Bump when the layout of the files or the pixel data changes, older cache files are then ignored
+static constexpr u32 IMAGE_CACHE_VERSION = 4;
+
+enum ImageCacheFlags : u32 {
+    ImageCacheFlags_None = 0,
+    ImageCacheFlags_Premultiplied = 1 << 0, // Color channels are multiplied by alpha
+    ImageCacheFlags_Zlib = 1 << 1, // Pixels are stored compressed, otherwise they are used straight from the mapping
+    ImageCacheFlags_Mipmapped = 1 << 2, // Every mip level is stored, largest first
+};
+
+// Header at the start of each image file, followed by the pixels
+struct ImageCacheHeader
+{
+    u32 magic{};
+    u32 version{};
+    u64 source_hash{}; // Of the contents of the source the pixels were decoded from
+
+    u32 width{}; // Of the image, compressed pixels are stored padded to get_block_padded_dimension
+    u32 height{};
+    u32 flags{};
+    u32 compression{}; // BlockCompression of the pixels
+    u32 mip_count{};
+    u32 reserved{};
+    u64 stored_size{}; // Bytes after the header
+};
+static_assert(sizeof(ImageCacheHeader) % 16 == 0, "pixels after the header should stay aligned");
+
+// The whole index file of a source path. The source is hashed again only if its size or modify time has changed.
+struct ImageCacheIndexEntry
+{
+    u32 magic{};
+    u32 version{};
+    u64 source_hash{};
+    u64 source_modify_time{};
+    u64 source_size{};
+};
+
+// RGBA8 pixels or compressed blocks of a cached image, either mapped from the cache file or decompressed from it
+class CachedImage {
+public:
+    CachedImage() = default;
+    ~CachedImage();
+
+    CachedImage(CachedImage&& other);
+    CachedImage& operator=(CachedImage&& other);
+    CachedImage(const CachedImage&) = delete;
+    CachedImage& operator=(const CachedImage&) = delete;
+
+    const u8* pixels() const { return m_pixels; }
+    u32 width() const { return m_width; }
+    u32 height() const { return m_height; }
+    BlockCompression compression() const { return m_compression; }
+    u32 mip_count() const { return m_mip_count; }
+
+private:
+    friend class ImageCache;
+
+    platform::MappedFile m_mapping{};
+    vector<u8> m_decompressed;
+    const u8* m_pixels{};
+    u32 m_width{};
+    u32 m_height{};
+    BlockCompression m_compression{};
+    u32 m_mip_count{};
+};
+
+// Decoded images on disk, so that image files do not have to be decoded again on every run.
+// Image files are named by the hash of the contents of the source, the flags and the block compression, so sources
+// with the same contents share them and an edited source never finds stale pixels. A small index file per canonical
+// source path keeps the hash of the contents, so unchanged sources are not read to find their image file.
+// Safe to use from several threads as long as they work on different source files.
+class ImageCache {
+public:
+    ImageCache() = default;
+    explicit ImageCache(string directory);
+
+    // Returns false if there is no up-to-date cache of the source with the given flags
+    // (ImageCacheFlags_Zlib is not compared, either way is fine)
+    bool load(non_null<const char> source_filename, u32 flags, BlockCompression compression, out_ptr<CachedImage> out_image) const;
+
+    // source_data is the undecoded file, its hash names the image file.
+    // width and height are the size of the image. pixels are get_mip_chain_size(compression, padded width,
+    // padded height, mip count) bytes, where the padded size is get_block_padded_dimension of the size and
+    // the mip count is get_mip_count of the padded size with ImageCacheFlags_Mipmapped and 1 otherwise.
+    void store(
+        non_null<const char> source_filename,
+        const vector<u8>& source_data,
+        non_null<const u8> pixels, u32 width, u32 height, u32 flags, BlockCompression compression) const;
+
+private:
+    string make_index_filename(const char* source_filename) const;
+    string make_image_filename(u64 source_hash, u32 flags, BlockCompression compression) const;
+    // Reads the hash from the index, or hashes the source and updates the index if the source has changed
+    bool get_source_hash(const char* source_filename, out_ptr<u64> out_hash) const;
+    void store_index(const char* source_filename, u64 source_hash, u64 source_size) const;
+
+    string m_directory;
+};
+
+}
@@ -0,0 +1,274 @@
+#include "jobs.h"
+#include "platform.h"
+#include "profiler.h"
+#include "simd.h"
+
+namespace bstr::core {
+
+// Times an idle thread looks for a job before a worker goes to sleep
+static constexpr u32 JOB_SPIN_COUNT = 64;
+
+// Which system and deque the current thread belongs to
+static thread_local const JobSystem* t_job_system = nullptr;
+static thread_local u32 t_job_thread_index = 0;
+
+bool WorkStealingDeque::push(non_null<Job> job)
+{
+    s64 bottom = m_bottom.load(std::memory_order_relaxed);
+    s64 top = m_top.load(std::memory_order_acquire);
+    if (bottom - top >= (s64)JOB_QUEUE_CAPACITY)
+    {
+        return false;
+    }
+    m_jobs[bottom & MASK].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+Job* WorkStealingDeque::pop()
+{
+    s64 bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    s64 top = m_top.load(std::memory_order_relaxed);
+
+    Job* result = nullptr;
+    if (top <= bottom)
+    {
+        result = m_jobs[bottom & MASK].load(std::memory_order_relaxed);
+        if (top == bottom)
+        {
+            // The last job, a thief may be taking it at the same time
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                result = nullptr;
+            }
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+    }
+    else
+    {
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return result;
+}
+
+Job* WorkStealingDeque::steal()
+{
+    s64 top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    s64 bottom = m_bottom.load(std::memory_order_acquire);
+
+    Job* result = nullptr;
+    if (top < bottom)
+    {
+        result = m_jobs[top & MASK].load(std::memory_order_relaxed);
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            result = nullptr;
+        }
+    }
+    return result;
+}
+
+JobSystem::JobSystem(u32 worker_count)
+{
+    ASSERT(t_job_system == nullptr, "thread already belongs to a job system");
+    m_deques.reserve(worker_count + 1);
+    for (u32 i = 0; i < worker_count + 1; ++i)
+    {
+        m_deques.push_back(make_unique<WorkStealingDeque>());
+    }
+
+    t_job_system = this;
+    t_job_thread_index = 0;
+
+    m_workers.reserve(worker_count);
+    for (u32 i = 1; i <= worker_count; ++i)
+    {
+        m_workers.emplace_back([this, i] { worker_main(i); });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard lock(m_sleep_mutex);
+        m_is_stopping.store(true, std::memory_order_relaxed);
+    }
+    m_job_queued.notify_all();
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+
+    ASSERT(m_queued_count.load() == 0, "job system destroyed with jobs queued");
+    if (t_job_system == this)
+    {
+        t_job_system = nullptr;
+    }
+}
+
+u32 JobSystem::get_thread_index() const
+{
+    u32 result = t_job_system == this ? t_job_thread_index : NOT_A_JOB_THREAD;
+    return result;
+}
+
+void JobSystem::submit(non_null<Job> job)
+{
+    u32 thread_index = get_thread_index();
+    if (thread_index == NOT_A_JOB_THREAD)
+    {
+        std::lock_guard lock(m_submitted_mutex);
+        m_submitted.push_back(job);
+    }
+    else if (!m_deques[thread_index]->push(job))
+    {
+        execute(job);
+        return;
+    }
+    notify_job_queued();
+}
+
+void JobSystem::submit_to_workers(non_null<Job> job)
+{
+    {
+        std::lock_guard lock(m_worker_jobs_mutex);
+        m_worker_jobs.push_back(job);
+    }
+    notify_job_queued();
+}
+
+void JobSystem::notify_job_queued()
+{
+    m_queued_count.fetch_add(1, std::memory_order_seq_cst);
+    if (m_sleeping_count.load(std::memory_order_seq_cst) > 0)
+    {
+        // Taking the lock makes sure a worker that is about to sleep either sees the job or gets the notification
+        {
+            std::lock_guard lock(m_sleep_mutex);
+        }
+        m_job_queued.notify_one();
+    }
+}
+
+Job* JobSystem::find_job(u32 thread_index)
+{
+    if (m_queued_count.load(std::memory_order_relaxed) <= 0)
+    {
+        return nullptr;
+    }
+
+    Job* result = nullptr;
+    if (thread_index != NOT_A_JOB_THREAD)
+    {
+        result = m_deques[thread_index]->pop();
+    }
+
+    // Start from the next thread, so that thieves spread over the deques
+    u32 count = thread_count();
+    u32 start = thread_index == NOT_A_JOB_THREAD ? 0 : thread_index + 1;
+    for (u32 i = 0; !result && i < count; ++i)
+    {
+        u32 victim = (start + i) % count;
+        if (victim != thread_index)
+        {
+            result = m_deques[victim]->steal();
+        }
+    }
+
+    if (!result)
+    {
+        std::lock_guard lock(m_submitted_mutex);
+        if (!m_submitted.empty())
+        {
+            result = m_submitted.back();
+            m_submitted.pop_back();
+        }
+    }
+
+    // The thread that created the system is index 0
+    if (!result && thread_index != NOT_A_JOB_THREAD && thread_index != 0)
+    {
+        std::lock_guard lock(m_worker_jobs_mutex);
+        if (!m_worker_jobs.empty())
+        {
+            result = m_worker_jobs.back();
+            m_worker_jobs.pop_back();
+        }
+    }
+
+    if (result)
+    {
+        m_queued_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return result;
+}
+
+void JobSystem::execute(non_null<Job> job)
+{
+    JobCounter* counter = job->counter;
+    job->function(*job);
+    get_pool_thread_cache<Job>().deallocate(job);
+    if (counter)
+    {
+        counter->value.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void JobSystem::wait(const JobCounter& counter)
+{
+    u32 thread_index = get_thread_index();
+    while (!counter.is_done())
+    {
+        if (Job* job = find_job(thread_index))
+        {
+            execute(job);
+        }
+        else
+        {
+            // The remaining jobs are running on other threads
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::worker_main(u32 thread_index)
+{
+    t_job_system = this;
+    t_job_thread_index = thread_index;
+    // Worker i runs on core i, so core 0 has no worker unless there are more workers than cores. The thread that
+    // created the job system is not pinned, the scheduler may still run it anywhere.
+    platform::set_current_thread_affinity(thread_index % max(std::thread::hardware_concurrency(), 1u));
+    set_profiler_thread_name("job worker");
+
+    while (!m_is_stopping.load(std::memory_order_relaxed))
+    {
+        Job* job = nullptr;
+        for (u32 i = 0; !job && i < JOB_SPIN_COUNT; ++i)
+        {
+            job = find_job(thread_index);
+            if (!job)
+            {
+                _mm_pause();
+            }
+        }
+
+        if (job)
+        {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock lock(m_sleep_mutex);
+        m_sleeping_count.fetch_add(1, std::memory_order_seq_cst);
+        m_job_queued.wait(lock, [this] {
+            return m_is_stopping.load(std::memory_order_relaxed) || m_queued_count.load(std::memory_order_seq_cst) > 0;
+        });
+        m_sleeping_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "def.h"
+#include "non_null.h"
+#include "pool.h"
+#include "smart_ptr.h"
+#include "utils.h"
+#include "containers/vector.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+
+namespace bstr::core {
+
+// Callables of jobs are stored in the job, so that a job is exactly one cache line
+static constexpr usz JOB_DATA_SIZE = CACHE_LINE_SIZE - 2 * sizeof(void*);
+// Power of two. A thread that has this many jobs queued runs the next one itself.
+static constexpr usz JOB_QUEUE_CAPACITY = 4096;
+
+// Number of jobs that have not finished yet. Jobs that depend on others wait for their counter,
+// e.g. run a job with a counter and pass the counter to JobSystem::wait before the next step.
+struct JobCounter
+{
+    std::atomic<u32> value{};
+
+    bool is_done() const { return value.load(std::memory_order_acquire) == 0; }
+};
+
+struct Job
+{
+    void (*function)(Job& job){};
+    JobCounter* counter{};
+    alignas(void*) u8 data[JOB_DATA_SIZE];
+};
+
+// Chase-Lev deque. The thread that owns it pushes and pops at the bottom, other threads steal from the top,
+// so the owner works on its newest jobs while the oldest ones, usually the largest, are stolen.
+class WorkStealingDeque {
+public:
+    // Owner only. Returns false if the deque is full.
+    bool push(non_null<Job> job);
+    // Owner only. Returns nullptr if the deque is empty.
+    Job* pop();
+    // Any thread. Returns nullptr if the deque is empty or another thread took the job first.
+    Job* steal();
+
+private:
+    static constexpr usz MASK = JOB_QUEUE_CAPACITY - 1;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<s64> m_top{};
+    alignas(CACHE_LINE_SIZE) std::atomic<s64> m_bottom{};
+    alignas(CACHE_LINE_SIZE) std::atomic<Job*> m_jobs[JOB_QUEUE_CAPACITY]{};
+};
+
+// Fixed set of worker threads, each on a core of its own and with a deque of jobs. Idle workers steal jobs
+// from the others. The thread that creates the system has a deque too and runs jobs while it waits.
+// Other threads can run jobs as well, they are queued for the workers to take.
+// Every job has to have finished before the system is destroyed.
+class JobSystem {
+public:
+    explicit JobSystem(u32 worker_count);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    JobSystem(JobSystem&&) = delete;
+    JobSystem& operator=(JobSystem&&) = delete;
+
+    // func is called once on some thread. The counter is incremented now and decremented when func returns,
+    // it can be nullptr for jobs nobody waits for.
+    template<typename Func>
+    void run(JobCounter* counter, Func&& func)
+    {
+        submit(make_job(counter, forward<Func>(func)));
+    }
+
+    // Like run, but only a worker calls func, never a thread that waits in wait. For jobs that may take long
+    // or block, e.g. decoding files, which must not stall the thread that created the system.
+    template<typename Func>
+    void run_on_worker(JobCounter* counter, Func&& func)
+    {
+        ASSERT(thread_count() > 1, "job system has no workers to run the job");
+        submit_to_workers(make_job(counter, forward<Func>(func)));
+    }
+
+    // Runs jobs until the counter reaches zero, so waiting inside a job does not block a worker
+    void wait(const JobCounter& counter);
+
+    // Workers and the thread that created the system
+    u32 thread_count() const { return (u32)m_deques.size(); }
+
+private:
+    static constexpr u32 NOT_A_JOB_THREAD = ~0u;
+
+    template<typename Func>
+    Job* make_job(JobCounter* counter, Func&& func)
+    {
+        using FuncType = std::decay_t<Func>;
+        static_assert(sizeof(FuncType) <= JOB_DATA_SIZE, "job captures too much, capture a pointer to the data instead");
+        static_assert(alignof(FuncType) <= alignof(void*), "job captures over-aligned data");
+
+        Job* result = (Job*)get_pool_thread_cache<Job>().allocate();
+        new (result->data) FuncType(forward<Func>(func));
+        result->function = [](Job& job) {
+            FuncType& func = *std::launder((FuncType*)job.data);
+            func();
+            func.~FuncType();
+        };
+        result->counter = counter;
+        if (counter)
+        {
+            counter->value.fetch_add(1, std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    void submit(non_null<Job> job);
+    void submit_to_workers(non_null<Job> job);
+    void notify_job_queued();
+    Job* find_job(u32 thread_index);
+    void execute(non_null<Job> job);
+    void worker_main(u32 thread_index);
+    u32 get_thread_index() const;
+
+    vector<unique_ptr<WorkStealingDeque>> m_deques;
+
+    // Jobs run by threads that do not belong to the system
+    std::mutex m_submitted_mutex;
+    vector<Job*> m_submitted;
+    // Jobs only workers take
+    std::mutex m_worker_jobs_mutex;
+    vector<Job*> m_worker_jobs;
+
+    // Jobs in deques or submitted, sleeping workers are woken when it goes above zero
+    alignas(CACHE_LINE_SIZE) std::atomic<s64> m_queued_count{};
+    std::atomic<u32> m_sleeping_count{};
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_job_queued;
+    std::atomic<bool> m_is_stopping{};
+
+    vector<std::thread> m_workers;
+};
+
+// Calls func(begin, end) for ranges of at most grain_size indices that together cover [0, count),
+// in parallel, and returns when all of them have returned. The calling thread runs ranges too.
+template<typename Func>
+void parallel_for(JobSystem& job_system, usz count, usz grain_size, const Func& func)
+{
+    ASSERT(grain_size > 0, "parallel_for grain size has to be at least one");
+    if (count <= grain_size)
+    {
+        if (count > 0)
+        {
+            func((usz)0, count);
+        }
+        return;
+    }
+
+    JobCounter counter;
+    const Func* func_ptr = &func;
+    for (usz begin = 0; begin < count; begin += grain_size)
+    {
+        usz end = min(begin + grain_size, count);
+        job_system.run(&counter, [func_ptr, begin, end] { (*func_ptr)(begin, end); });
+    }
+    job_system.wait(counter);
+}
+
+}
+
+using bstr::core::JobCounter;
+using bstr::core::JobSystem;
+using bstr::core::parallel_for;
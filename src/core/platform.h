@@ -1,6 +1,8 @@
 #pragma once
 
 #include "def.h"
+#include "non_null.h"
+#include "out_ptr.h"
 #include "containers/common.h"
 
 
@@ -8,6 +10,8 @@ namespace bstr::core::platform {
 
 #if PLATFORM_WIN32
 static constexpr auto PATH_DELIMITER = '\\';
+#elif PLATFORM_POSIX
+static constexpr auto PATH_DELIMITER = '/';
 #else
 #error "Unsupported platform"
 #endif      
@@ -24,6 +28,16 @@ struct WindowSize
     s32 height{};
 };
 
+// Read-only view of a whole file
+struct MappedFile
+{
+    const u8* data{};
+    usz size{};
+
+    void* file_handle{};
+    void* mapping_handle{};
+};
+
 void print(const char* msg);
 
 typedef void OpaqueFunction();
@@ -34,6 +48,8 @@ void free_library(void* library);
 OpaqueFunctionPtr get_proc_address(void* library, const char* proc_name);
 
 bool copy_file(const char* src, const char* dst);
+// Moves src to dst, replacing dst if it exists. Fails if dst is open or mapped.
+bool replace_file(const char* src, const char* dst);
 bool file_exists(const char* filename);
 void set_current_working_directory(const char* cwd);
 
@@ -42,5 +58,23 @@ WindowSize get_window_size();
 WindowHandle get_native_window_handle();
 string get_current_working_directory();
 u64 get_file_modify_time(const char* filename);
+u64 get_file_size(const char* filename);
+bool create_directory(const char* path); // Succeeds if the directory already exists
+
+bool map_file_read_only(const char* filename, out_ptr<MappedFile> out_file);
+void unmap_file(non_null<MappedFile> file);
+
+// Virtual memory. Reserved address space is not backed by memory until it is committed, sizes are rounded
+// up to whole pages. Committed memory is zeroed. Released memory has to be the whole reservation.
+void* reserve_memory(usz size);
+bool commit_memory(void* address, usz size);
+void release_memory(void* address);
+
+// Keeps the calling thread on one logical core, counted from 0. Returns false if the core does not exist.
+bool set_current_thread_affinity(u32 core_index);
+
+// Absolute path with the separators and case normalized, so that every way of referring to a file gives the
+// same string. Returns an empty string on failure.
+string get_canonical_path(const char* filename);
 
 }
\ No newline at end of file
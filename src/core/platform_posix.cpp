@@ -0,0 +1,297 @@
+#include "def.h"
+#include "utils.h"
+#include "platform.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace bstr::core::platform {
+
+static void posix_print_last_error(const char* msg)
+{
+    LOG_ERROR("{}: {}", msg, strerror(errno));
+}
+
+void* load_library(const char* library_filename)
+{
+    void* library = dlopen(library_filename, RTLD_NOW | RTLD_LOCAL);
+    return library;
+}
+
+void free_library(void* library)
+{
+    if (dlclose(library) != 0)
+    {
+        LOG_ERROR("dlclose: {}", dlerror());
+    }
+}
+
+bool copy_file(const char* src, const char* dst)
+{
+    FILE* src_file = fopen(src, "rb");
+    if (!src_file)
+    {
+        posix_print_last_error("fopen");
+        return false;
+    }
+    FILE* dst_file = fopen(dst, "wb");
+    if (!dst_file)
+    {
+        posix_print_last_error("fopen");
+        fclose(src_file);
+        return false;
+    }
+
+    bool result = true;
+    char buffer[64 * 1024];
+    for (;;)
+    {
+        usz read_size = fread(buffer, 1, sizeof(buffer), src_file);
+        if (read_size > 0 && fwrite(buffer, 1, read_size, dst_file) != read_size)
+        {
+            result = false;
+            break;
+        }
+        if (read_size < sizeof(buffer))
+        {
+            result = !ferror(src_file);
+            break;
+        }
+    }
+    result = fclose(dst_file) == 0 && result;
+    fclose(src_file);
+    if (!result)
+    {
+        posix_print_last_error("copy_file");
+    }
+    return result;
+}
+
+bool replace_file(const char* src, const char* dst)
+{
+    bool result = rename(src, dst) == 0;
+    return result;
+}
+
+bool file_exists(const char* filename)
+{
+    bool result = access(filename, F_OK) == 0;
+    return result;
+}
+
+OpaqueFunctionPtr get_proc_address(void* library, const char* proc_name)
+{
+    OpaqueFunctionPtr func = (OpaqueFunctionPtr)dlsym(library, proc_name);
+    if (!func) {
+        LOG_ERROR("dlsym: {}", dlerror());
+    }
+    return func;
+}
+
+void print(const char* str)
+{
+    fprintf(stdout, "%s", str);
+}
+
+void set_current_working_directory(const char* cwd)
+{
+    bool res = chdir(cwd) == 0;
+    ASSERT(res, "");
+}
+
+string get_current_working_directory()
+{
+    string buffer;
+    char* cwd = getcwd(nullptr, 0);
+    if (cwd)
+    {
+        buffer = cwd;
+        free(cwd);
+    }
+    return buffer;
+}
+
+f64 get_highresolution_time_seconds()
+{
+    timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    f64 result = (f64)time.tv_sec + (f64)time.tv_nsec * 1e-9;
+    return result;
+}
+
+u64 get_file_modify_time(const char* filename)
+{
+    u64 result = 0;
+    struct stat attributes;
+    if (stat(filename, &attributes) == 0)
+    {
+#if defined(__APPLE__)
+        result = (u64)attributes.st_mtimespec.tv_sec * 1000000000ull + (u64)attributes.st_mtimespec.tv_nsec;
+#else
+        result = (u64)attributes.st_mtim.tv_sec * 1000000000ull + (u64)attributes.st_mtim.tv_nsec;
+#endif
+    }
+    return result;
+}
+
+u64 get_file_size(const char* filename)
+{
+    u64 result = 0;
+    struct stat attributes;
+    if (stat(filename, &attributes) == 0)
+    {
+        result = (u64)attributes.st_size;
+    }
+    return result;
+}
+
+bool create_directory(const char* path)
+{
+    bool result = mkdir(path, 0755) == 0 || errno == EEXIST;
+    if (!result)
+    {
+        posix_print_last_error("mkdir");
+    }
+    return result;
+}
+
+bool map_file_read_only(const char* filename, out_ptr<MappedFile> out_file)
+{
+    *out_file = {};
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat attributes;
+    if (fstat(fd, &attributes) != 0 || attributes.st_size == 0)
+    {
+        // Empty files cannot be mapped
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, (usz)attributes.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        posix_print_last_error("mmap");
+        close(fd);
+        return false;
+    }
+
+    out_file->data = (const u8*)data;
+    out_file->size = (usz)attributes.st_size;
+    out_file->file_handle = (void*)(sptr)fd;
+    return true;
+}
+
+void unmap_file(non_null<MappedFile> file)
+{
+    if (file->data)
+    {
+        munmap((void*)file->data, file->size);
+        close((int)(sptr)file->file_handle);
+    }
+    *file = {};
+}
+
+// munmap needs the size of the reservation, so it is kept in a page in front of it
+static usz get_page_size()
+{
+    static const usz page_size = (usz)sysconf(_SC_PAGESIZE);
+    return page_size;
+}
+
+void* reserve_memory(usz size)
+{
+    usz page_size = get_page_size();
+    usz reserved_size = align_forwards(size, page_size) + page_size;
+    void* base = mmap(nullptr, reserved_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED)
+    {
+        posix_print_last_error("mmap reserve");
+        return nullptr;
+    }
+    if (mprotect(base, page_size, PROT_READ | PROT_WRITE) != 0)
+    {
+        posix_print_last_error("mprotect");
+        munmap(base, reserved_size);
+        return nullptr;
+    }
+    *(usz*)base = reserved_size;
+    void* result = (u8*)base + page_size;
+    return result;
+}
+
+bool commit_memory(void* address, usz size)
+{
+    usz page_size = get_page_size();
+    u8* begin = (u8*)align_backwards((usz)address, page_size);
+    usz commit_size = align_forwards((usz)((u8*)address + size - begin), page_size);
+    bool result = mprotect(begin, commit_size, PROT_READ | PROT_WRITE) == 0;
+    if (!result)
+    {
+        posix_print_last_error("mprotect commit");
+    }
+    return result;
+}
+
+void release_memory(void* address)
+{
+    u8* base = (u8*)address - get_page_size();
+    if (munmap(base, *(usz*)base) != 0)
+    {
+        posix_print_last_error("munmap");
+    }
+}
+
+bool set_current_thread_affinity(u32 core_index)
+{
+#if defined(__linux__)
+    if (core_index >= CPU_SETSIZE)
+    {
+        return false;
+    }
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(core_index, &mask);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+    if (error != 0)
+    {
+        LOG_ERROR("pthread_setaffinity_np: {}", strerror(error));
+    }
+    return error == 0;
+#else
+    // macOS has no way to pin a thread to a core
+    UNUSED(core_index);
+    return false;
+#endif
+}
+
+string get_canonical_path(const char* filename)
+{
+    string result;
+    char* path = realpath(filename, nullptr);
+    if (!path)
+    {
+        posix_print_last_error("realpath");
+        return result;
+    }
+    result = path;
+    free(path);
+    return result;
+}
+
+}
@@ -33,18 +33,6 @@ WindowHandle get_native_window_handle()
     return result;
 }
 
-f64 get_highresolution_time_seconds()
-{
-    f64 result = 0;
-
-    Uint64 counter = SDL_GetPerformanceCounter();
-    Uint64 freq = SDL_GetPerformanceFrequency();
-
-    result = (f64)counter / (f64)freq;
-
-    return result;
-}
-
 WindowSize get_window_size()
 {
     WindowSize size = { 0 };
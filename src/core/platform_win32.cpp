@@ -50,6 +50,12 @@ bool copy_file(const char* src, const char* dst)
     return result;
 }
 
+bool replace_file(const char* src, const char* dst)
+{
+    BOOL result = MoveFileExA(src, dst, MOVEFILE_REPLACE_EXISTING);
+    return result;
+}
+
 bool file_exists(const char* filename)
 {
     BOOL result = PathFileExistsA(filename);
@@ -87,6 +93,21 @@ string get_current_working_directory()
     return buffer;
 }
 
+f64 get_highresolution_time_seconds()
+{
+    static const f64 seconds_per_count = []
+    {
+        LARGE_INTEGER frequency = { 0 };
+        QueryPerformanceFrequency(&frequency);
+        return 1.0 / (f64)frequency.QuadPart;
+    }();
+
+    LARGE_INTEGER counter = { 0 };
+    QueryPerformanceCounter(&counter);
+    f64 result = (f64)counter.QuadPart * seconds_per_count;
+    return result;
+}
+
 u64 get_file_modify_time(const char* filename)
 {
     u64 result = 0;
@@ -112,4 +133,152 @@ u64 get_file_modify_time(const char* filename)
     return result;
 }
 
+u64 get_file_size(const char* filename)
+{
+    u64 result = 0;
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (GetFileAttributesExA(filename, GetFileExInfoStandard, &attributes))
+    {
+        ULARGE_INTEGER large_integer = { 0 };
+        large_integer.LowPart = attributes.nFileSizeLow;
+        large_integer.HighPart = attributes.nFileSizeHigh;
+        result = large_integer.QuadPart;
+    }
+    return result;
+}
+
+bool create_directory(const char* path)
+{
+    bool result = CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+    if (!result)
+    {
+        win32_print_last_error("CreateDirectoryA");
+    }
+    return result;
+}
+
+bool map_file_read_only(const char* filename, out_ptr<MappedFile> out_file)
+{
+    *out_file = {};
+
+    HANDLE file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file_handle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER file_size = { 0 };
+    if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0)
+    {
+        // Empty files cannot be mapped
+        CloseHandle(file_handle);
+        return false;
+    }
+
+    HANDLE mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping_handle)
+    {
+        win32_print_last_error("CreateFileMappingA");
+        CloseHandle(file_handle);
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        win32_print_last_error("MapViewOfFile");
+        CloseHandle(mapping_handle);
+        CloseHandle(file_handle);
+        return false;
+    }
+
+    out_file->data = (const u8*)data;
+    out_file->size = (usz)file_size.QuadPart;
+    out_file->file_handle = file_handle;
+    out_file->mapping_handle = mapping_handle;
+    return true;
+}
+
+void unmap_file(non_null<MappedFile> file)
+{
+    if (file->data)
+    {
+        UnmapViewOfFile(file->data);
+        CloseHandle((HANDLE)file->mapping_handle);
+        CloseHandle((HANDLE)file->file_handle);
+    }
+    *file = {};
+}
+
+void* reserve_memory(usz size)
+{
+    void* result = VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+    if (!result)
+    {
+        win32_print_last_error("VirtualAlloc MEM_RESERVE");
+    }
+    return result;
+}
+
+bool commit_memory(void* address, usz size)
+{
+    bool result = VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+    if (!result)
+    {
+        win32_print_last_error("VirtualAlloc MEM_COMMIT");
+    }
+    return result;
+}
+
+void release_memory(void* address)
+{
+    if (!VirtualFree(address, 0, MEM_RELEASE))
+    {
+        win32_print_last_error("VirtualFree");
+    }
+}
+
+bool set_current_thread_affinity(u32 core_index)
+{
+    if (core_index >= sizeof(DWORD_PTR) * 8)
+    {
+        return false;
+    }
+    DWORD_PTR mask = (DWORD_PTR)1 << core_index;
+    bool result = SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+    if (!result)
+    {
+        win32_print_last_error("SetThreadAffinityMask");
+    }
+    return result;
+}
+
+string get_canonical_path(const char* filename)
+{
+    string result;
+    DWORD buffer_len = GetFullPathNameA(filename, 0, nullptr, nullptr);
+    if (buffer_len == 0)
+    {
+        win32_print_last_error("GetFullPathNameA");
+        return result;
+    }
+    result.resize((usz)buffer_len);
+    DWORD path_len = GetFullPathNameA(filename, buffer_len, result.data(), nullptr);
+    result.resize((usz)path_len);
+
+    // NTFS paths are case-insensitive
+    for (char& c : result)
+    {
+        if (c == '/')
+        {
+            c = PATH_DELIMITER;
+        }
+        else if (c >= 'A' && c <= 'Z')
+        {
+            c = c - 'A' + 'a';
+        }
+    }
+    return result;
+}
+
 }
\ No newline at end of file
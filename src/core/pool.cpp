@@ -0,0 +1,127 @@
+#include "pool.h"
+
+namespace bstr::core {
+
+FixedPool::FixedPool(usz block_size, usz block_alignment, usz blocks_per_chunk)
+{
+    ASSERT(is_power_of_two(block_alignment), "block alignment not power of two");
+    ASSERT(blocks_per_chunk > 0, "pool chunks need at least one block");
+    m_block_alignment = max(block_alignment, CACHE_LINE_SIZE);
+    m_block_size = (usz)align_forwards(max(block_size, sizeof(FreeBlock)), m_block_alignment);
+    m_blocks_per_chunk = blocks_per_chunk;
+}
+
+FixedPool::~FixedPool()
+{
+    ASSERT(m_blocks_in_use == 0, "pool destroyed while its blocks are in use");
+    for (void* chunk : m_chunks)
+    {
+        ::operator delete(chunk, std::align_val_t(m_block_alignment));
+    }
+}
+
+void* FixedPool::pop_block()
+{
+    if (!m_free_list)
+    {
+        u8* chunk = (u8*)::operator new(m_block_size * m_blocks_per_chunk, std::align_val_t(m_block_alignment));
+        m_chunks.push_back(chunk);
+
+        // Linked in address order, so that blocks are handed out front to back
+        for (usz i = m_blocks_per_chunk; i > 0; --i)
+        {
+            push_block(chunk + (i - 1) * m_block_size);
+        }
+    }
+
+    FreeBlock* result = m_free_list;
+    m_free_list = result->next;
+    return result;
+}
+
+void FixedPool::push_block(void* block)
+{
+    FreeBlock* free_block = (FreeBlock*)block;
+    free_block->next = m_free_list;
+    m_free_list = free_block;
+}
+
+void* FixedPool::allocate()
+{
+    std::lock_guard lock(m_mutex);
+    void* result = pop_block();
+    m_blocks_in_use += 1;
+    return result;
+}
+
+void FixedPool::deallocate(non_null<void> block)
+{
+    std::lock_guard lock(m_mutex);
+    push_block(block);
+    m_blocks_in_use -= 1;
+}
+
+usz FixedPool::allocate_batch(non_null<void*> out_blocks, usz count)
+{
+    std::lock_guard lock(m_mutex);
+    for (usz i = 0; i < count; ++i)
+    {
+        out_blocks[i] = pop_block();
+    }
+    m_blocks_in_use += count;
+    return count;
+}
+
+void FixedPool::deallocate_batch(non_null<void* const> blocks, usz count)
+{
+    std::lock_guard lock(m_mutex);
+    for (usz i = 0; i < count; ++i)
+    {
+        push_block(blocks[i]);
+    }
+    m_blocks_in_use -= count;
+}
+
+usz FixedPool::blocks_in_use() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_blocks_in_use;
+}
+
+usz FixedPool::chunk_count() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_chunks.size();
+}
+
+PoolThreadCache::~PoolThreadCache()
+{
+    if (m_count > 0)
+    {
+        m_pool->deallocate_batch(m_blocks, m_count);
+    }
+}
+
+void* PoolThreadCache::allocate()
+{
+    if (m_count == 0)
+    {
+        m_count = m_pool->allocate_batch(m_blocks, POOL_THREAD_CACHE_SIZE / 2);
+    }
+    m_count -= 1;
+    void* result = m_blocks[m_count];
+    return result;
+}
+
+void PoolThreadCache::deallocate(non_null<void> block)
+{
+    if (m_count == POOL_THREAD_CACHE_SIZE)
+    {
+        m_count -= POOL_THREAD_CACHE_SIZE / 2;
+        m_pool->deallocate_batch(m_blocks + m_count, POOL_THREAD_CACHE_SIZE / 2);
+    }
+    m_blocks[m_count] = block;
+    m_count += 1;
+}
+
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "def.h"
+#include "non_null.h"
+#include "smart_ptr.h"
+#include "utils.h"
+#include "containers/vector.h"
+
+#include <mutex>
+#include <new>
+
+namespace bstr::core {
+
+static constexpr usz POOL_DEFAULT_BLOCKS_PER_CHUNK = 64;
+// Blocks a thread keeps for itself, half of them are moved to or from the pool at a time
+static constexpr usz POOL_THREAD_CACHE_SIZE = 32;
+
+// Blocks of one size carved from chunks. Freed blocks go to a free list and are handed out again, chunks are
+// only freed with the pool, so addresses are stable and the heap does not fragment over long sessions.
+// Blocks are rounded up to whole cache lines so that objects in different blocks never share one.
+// Thread safe, every call takes a lock.
+class FixedPool {
+public:
+    FixedPool(usz block_size, usz block_alignment, usz blocks_per_chunk = POOL_DEFAULT_BLOCKS_PER_CHUNK);
+    ~FixedPool();
+
+    FixedPool(const FixedPool&) = delete;
+    FixedPool& operator=(const FixedPool&) = delete;
+    FixedPool(FixedPool&&) = delete;
+    FixedPool& operator=(FixedPool&&) = delete;
+
+    void* allocate();
+    void deallocate(non_null<void> block);
+
+    // Several blocks under one lock, for thread caches. Returns the number of blocks written to out_blocks.
+    usz allocate_batch(non_null<void*> out_blocks, usz count);
+    void deallocate_batch(non_null<void* const> blocks, usz count);
+
+    usz block_size() const { return m_block_size; }
+    usz blocks_in_use() const; // Including blocks kept by thread caches
+    usz chunk_count() const;
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    void* pop_block();
+    void push_block(void* block);
+
+    mutable std::mutex m_mutex;
+    FreeBlock* m_free_list{};
+    vector<void*> m_chunks;
+    usz m_block_size{};
+    usz m_block_alignment{};
+    usz m_blocks_per_chunk{};
+    usz m_blocks_in_use{};
+};
+
+// Blocks of a pool kept by one thread, so that most allocations and frees do not take the pool lock.
+// The blocks go back to the pool when the thread exits.
+class PoolThreadCache {
+public:
+    explicit PoolThreadCache(non_null<FixedPool> pool)
+        : m_pool(pool)
+    {
+    }
+    ~PoolThreadCache();
+
+    PoolThreadCache(const PoolThreadCache&) = delete;
+    PoolThreadCache& operator=(const PoolThreadCache&) = delete;
+
+    void* allocate();
+    void deallocate(non_null<void> block);
+
+private:
+    FixedPool* m_pool{};
+    void* m_blocks[POOL_THREAD_CACHE_SIZE]{};
+    usz m_count{};
+};
+
+// One pool per type shared by the whole program
+template<typename T>
+FixedPool& get_shared_pool()
+{
+    // Never destroyed, blocks may still be freed by static destructors and threads that exit late
+    static FixedPool* pool = new FixedPool(sizeof(T), alignof(T));
+    return *pool;
+}
+
+template<typename T>
+PoolThreadCache& get_pool_thread_cache()
+{
+    thread_local PoolThreadCache cache(&get_shared_pool<T>());
+    return cache;
+}
+
+// Standard allocator that takes single objects from the shared pool of the type through the thread cache.
+// Arrays are rare for pooled types and go to the heap.
+template<typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    PoolAllocator() = default;
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U>&)
+    {
+    }
+
+    T* allocate(usz count)
+    {
+        if (count == 1)
+        {
+            T* result = (T*)get_pool_thread_cache<T>().allocate();
+            return result;
+        }
+        T* result = (T*)::operator new(count * sizeof(T), std::align_val_t(alignof(T)));
+        return result;
+    }
+
+    void deallocate(T* pointer, usz count)
+    {
+        if (count == 1)
+        {
+            get_pool_thread_cache<T>().deallocate(pointer);
+            return;
+        }
+        ::operator delete(pointer, std::align_val_t(alignof(T)));
+    }
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U>&) const { return true; }
+    template<typename U>
+    bool operator!=(const PoolAllocator<U>&) const { return false; }
+};
+
+// make_shared with the object and its reference counts in one block of the shared pool
+template<typename T, typename... Args>
+shared_ptr<T> make_pooled(Args&&... args)
+{
+    shared_ptr<T> result = std::allocate_shared<T>(PoolAllocator<T>(), forward<Args>(args)...);
+    return result;
+}
+
+// Pool of its own for objects that are owned by one place, e.g. the entities of a level
+template<typename T>
+class Pool {
+public:
+    explicit Pool(usz blocks_per_chunk = POOL_DEFAULT_BLOCKS_PER_CHUNK)
+        : m_pool(sizeof(T), alignof(T), blocks_per_chunk)
+    {
+    }
+
+    template<typename... Args>
+    T* create(Args&&... args)
+    {
+        T* result = new (m_pool.allocate()) T(forward<Args>(args)...);
+        return result;
+    }
+
+    void destroy(T* object)
+    {
+        if (object)
+        {
+            object->~T();
+            m_pool.deallocate(object);
+        }
+    }
+
+    usz size() const { return m_pool.blocks_in_use(); }
+
+private:
+    FixedPool m_pool;
+};
+
+}
+
+using bstr::core::make_pooled;
@@ -0,0 +1,280 @@
+#include "profiler.h"
+#include "platform.h"
+#include "string_builder.h"
+#include "utils.h"
+
+#include <cstdio>
+#include <mutex>
+
+namespace bstr::core {
+
+// Thread id of the track frames are shown on in traces
+static constexpr u32 PROFILER_FRAMES_TRACK = 1000000;
+
+std::atomic<bool> g_profiler_enabled{ true };
+
+// Zones of one thread. Only the thread writes them, readers copy the ones that are published by the count
+// and drop the ones the thread may have overwritten while they were copying.
+struct ProfilerThread
+{
+    u32 index{};
+    const char* name{};
+    u32 depth{};
+    std::atomic<u64> zone_count{};
+    ProfileZone zones[PROFILER_ZONES_PER_THREAD];
+};
+
+struct ProfilerState
+{
+    // Ticks and seconds when the profiler was first used, for converting ticks to seconds
+    u64 base_ticks{};
+    f64 base_seconds{};
+
+    // Threads are never freed, their zones can be exported after they exit
+    std::mutex threads_mutex;
+    vector<ProfilerThread*> threads;
+
+    u64 frame_starts[PROFILER_FRAME_HISTORY]{};
+    std::atomic<u64> frame_count{};
+};
+
+static ProfilerState& get_profiler_state()
+{
+    // Never destroyed, threads may record zones during static destruction
+    static ProfilerState* state = [] {
+        ProfilerState* result = new ProfilerState();
+        result->base_ticks = read_profiler_ticks();
+        result->base_seconds = platform::get_highresolution_time_seconds();
+        return result;
+    }();
+    return *state;
+}
+
+static thread_local ProfilerThread* t_profiler_thread = nullptr;
+
+static ProfilerThread& get_profiler_thread()
+{
+    if (!t_profiler_thread)
+    {
+        ProfilerState& state = get_profiler_state();
+        auto thread = new ProfilerThread();
+        std::lock_guard lock(state.threads_mutex);
+        thread->index = (u32)state.threads.size();
+        state.threads.push_back(thread);
+        t_profiler_thread = thread;
+    }
+    return *t_profiler_thread;
+}
+
+f64 profiler_ticks_to_seconds(u64 ticks)
+{
+    // The tick rate is measured against the high resolution timer over the whole run, so it gets more exact
+    ProfilerState& state = get_profiler_state();
+    u64 elapsed_ticks = read_profiler_ticks() - state.base_ticks;
+    f64 elapsed_seconds = platform::get_highresolution_time_seconds() - state.base_seconds;
+    if (elapsed_ticks == 0 || elapsed_seconds <= 0)
+    {
+        return 0;
+    }
+    f64 result = (f64)ticks * (elapsed_seconds / (f64)elapsed_ticks);
+    return result;
+}
+
+void set_profiler_enabled(bool enabled)
+{
+    g_profiler_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void set_profiler_thread_name(const char* name)
+{
+    get_profiler_thread().name = name;
+}
+
+u32 enter_profile_zone()
+{
+    ProfilerThread& thread = get_profiler_thread();
+    u32 result = thread.depth++;
+    return result;
+}
+
+void record_profile_zone(const char* name, u64 start_ticks, u32 depth)
+{
+    u64 end_ticks = read_profiler_ticks();
+    ProfilerThread& thread = get_profiler_thread();
+    thread.depth = depth;
+
+    u64 count = thread.zone_count.load(std::memory_order_relaxed);
+    ProfileZone& zone = thread.zones[count % PROFILER_ZONES_PER_THREAD];
+    zone.name = name;
+    zone.start_ticks = start_ticks;
+    zone.end_ticks = end_ticks;
+    zone.thread_index = thread.index;
+    zone.depth = depth;
+    thread.zone_count.store(count + 1, std::memory_order_release);
+}
+
+void mark_profiler_frame()
+{
+    ProfilerState& state = get_profiler_state();
+    u64 count = state.frame_count.load(std::memory_order_relaxed);
+    state.frame_starts[count % PROFILER_FRAME_HISTORY] = read_profiler_ticks();
+    state.frame_count.store(count + 1, std::memory_order_release);
+}
+
+void get_profiler_frames(usz count, out_ptr<vector<ProfileFrame>> out_frames)
+{
+    ProfilerState& state = get_profiler_state();
+    out_frames->clear();
+
+    // The last frame has started but not ended
+    u64 frame_count = state.frame_count.load(std::memory_order_acquire);
+    u64 ended_count = frame_count > 0 ? frame_count - 1 : 0;
+    u64 first = ended_count - min((u64)count, min(ended_count, (u64)PROFILER_FRAME_HISTORY - 1));
+    for (u64 i = first; i < ended_count; ++i)
+    {
+        ProfileFrame frame;
+        frame.index = i;
+        frame.start_ticks = state.frame_starts[i % PROFILER_FRAME_HISTORY];
+        frame.end_ticks = state.frame_starts[(i + 1) % PROFILER_FRAME_HISTORY];
+        out_frames->push_back(frame);
+    }
+}
+
+void get_profiler_zones(
+    u64 start_ticks, u64 end_ticks, non_null<vector<ProfileZone>> scratch, out_ptr<vector<ProfileZone>> out_zones)
+{
+    ProfilerState& state = get_profiler_state();
+    out_zones->clear();
+
+    std::lock_guard lock(state.threads_mutex);
+    for (ProfilerThread* thread : state.threads)
+    {
+        // A thread records its zones in the order they end, so copying from the newest one back can stop at the
+        // first zone that ended before start_ticks. The zones older than that are not copied at all.
+        u64 count = thread->zone_count.load(std::memory_order_acquire);
+        u64 first = count > PROFILER_ZONES_PER_THREAD ? count - PROFILER_ZONES_PER_THREAD : 0;
+        scratch->clear();
+        for (u64 i = count; i > first; --i)
+        {
+            const ProfileZone& zone = thread->zones[(i - 1) % PROFILER_ZONES_PER_THREAD];
+            scratch->push_back(zone);
+            if (zone.end_ticks < start_ticks)
+            {
+                break;
+            }
+        }
+
+        // Zones the thread wrote over while they were copied are dropped, they are the oldest ones. The slot of
+        // zone count_after may be half written already, so it does not count as valid either. A half written
+        // zone that stopped the copy early is in that range too, so every zone it kept from being copied is as well.
+        u64 count_after = thread->zone_count.load(std::memory_order_acquire);
+        u64 valid_first = count_after >= PROFILER_ZONES_PER_THREAD ? count_after - PROFILER_ZONES_PER_THREAD + 1 : 0;
+        for (usz j = 0; j < scratch->size() && count - j > valid_first; ++j)
+        {
+            const ProfileZone& zone = (*scratch)[j];
+            if (zone.end_ticks >= start_ticks && zone.end_ticks < end_ticks)
+            {
+                out_zones->push_back(zone);
+            }
+        }
+    }
+}
+
+// Zone names are literals, but quotes and backslashes would still break the file
+static void append_json_string(string_builder& json, const char* str)
+{
+    json.append('"');
+    for (const char* c = str; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            json.append('\\');
+        }
+        json.append(*c);
+    }
+    json.append('"');
+}
+
+bool export_profiler_trace(const char* filename, usz frame_count)
+{
+    vector<ProfileFrame> frames;
+    get_profiler_frames(frame_count, &frames);
+    if (frames.empty())
+    {
+        LOG_WARN("No frames to export to {}", filename);
+        return false;
+    }
+
+    u64 start_ticks = frames.front().start_ticks;
+    vector<ProfileZone> zones;
+    vector<ProfileZone> scratch;
+    get_profiler_zones(start_ticks, frames.back().end_ticks, &scratch, &zones);
+
+    string_builder json;
+    json.reserve(zones.size() * 96 + 1024);
+    json.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    {
+        ProfilerState& state = get_profiler_state();
+        std::lock_guard lock(state.threads_mutex);
+        for (ProfilerThread* thread : state.threads)
+        {
+            json.append_format("{{\"ph\":\"M\",\"pid\":0,\"tid\":{},\"name\":\"thread_name\",\"args\":{{\"name\":", thread->index);
+            if (thread->name)
+            {
+                append_json_string(json, thread->name);
+            }
+            else
+            {
+                json.append_format("\"thread {}\"", thread->index);
+            }
+            json.append("}},\n");
+        }
+        json.append_format(
+            "{{\"ph\":\"M\",\"pid\":0,\"tid\":{},\"name\":\"thread_name\",\"args\":{{\"name\":\"frames\"}}}},\n", PROFILER_FRAMES_TRACK);
+    }
+
+    // Frames are on a track of their own, so that zones can be read against them
+    for (const ProfileFrame& frame : frames)
+    {
+        f64 start_us = profiler_ticks_to_seconds(frame.start_ticks - start_ticks) * 1e6;
+        f64 duration_us = profiler_ticks_to_seconds(frame.end_ticks - frame.start_ticks) * 1e6;
+        json.append_format(
+            "{{\"ph\":\"X\",\"pid\":0,\"tid\":{},\"name\":\"frame {}\",\"ts\":{:.3f},\"dur\":{:.3f}}},\n",
+            PROFILER_FRAMES_TRACK, frame.index, start_us, duration_us);
+    }
+
+    for (const ProfileZone& zone : zones)
+    {
+        // Zones that started before the first frame still show, cut at its start
+        u64 zone_start = max(zone.start_ticks, start_ticks);
+        f64 start_us = profiler_ticks_to_seconds(zone_start - start_ticks) * 1e6;
+        f64 duration_us = profiler_ticks_to_seconds(zone.end_ticks - zone_start) * 1e6;
+        json.append_format("{{\"ph\":\"X\",\"pid\":0,\"tid\":{},\"name\":", zone.thread_index);
+        append_json_string(json, zone.name);
+        json.append_format(",\"ts\":{:.3f},\"dur\":{:.3f}}},\n", start_us, duration_us);
+    }
+
+    // JSON does not allow the comma after the last event
+    json.resize(json.size() - 2);
+    json.append("\n]}\n");
+
+    FILE* file = fopen(filename, "wb");
+    if (!file)
+    {
+        LOG_ERROR("Could not write profiler trace {}", filename);
+        return false;
+    }
+    bool written = fwrite(json.data(), 1, json.size(), file) == json.size();
+    fclose(file);
+    if (!written)
+    {
+        LOG_ERROR("Could not write profiler trace {}", filename);
+        return false;
+    }
+
+    LOG_INFO("Wrote {} zones of {} frames to {}", zones.size(), frames.size(), filename);
+    return true;
+}
+
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "def.h"
+#include "non_null.h"
+#include "out_ptr.h"
+#include "containers/vector.h"
+
+#include <atomic>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+// Zones are compiled in internal builds only, in other builds PROFILE_SCOPE is nothing
+#if defined(IS_INTERNAL_BUILD) && IS_INTERNAL_BUILD
+#define PROFILER_ENABLED 1
+#else
+#define PROFILER_ENABLED 0
+#endif
+
+namespace bstr::core {
+
+// Zones each thread keeps, older ones are overwritten
+static constexpr usz PROFILER_ZONES_PER_THREAD = 16 * 1024;
+// Frames whose start time is kept, for finding the zones of recent frames
+static constexpr usz PROFILER_FRAME_HISTORY = 512;
+
+struct ProfileZone
+{
+    const char* name{}; // Has to live as long as the program, e.g. a string literal
+    u64 start_ticks{};
+    u64 end_ticks{};
+    u32 thread_index{}; // In the order threads first entered a zone
+    u32 depth{}; // Zones the thread was already in when it entered this one
+};
+
+struct ProfileFrame
+{
+    u64 index{};
+    u64 start_ticks{};
+    u64 end_ticks{};
+};
+
+// Time stamp counter, only comparable to other profiler ticks
+inline u64 read_profiler_ticks()
+{
+    u64 result = __rdtsc();
+    return result;
+}
+
+f64 profiler_ticks_to_seconds(u64 ticks);
+
+// Zones are only recorded while enabled, which they are from the start
+extern std::atomic<bool> g_profiler_enabled;
+void set_profiler_enabled(bool enabled);
+inline bool is_profiler_enabled()
+{
+    bool result = g_profiler_enabled.load(std::memory_order_relaxed);
+    return result;
+}
+
+// Name shown for the calling thread in traces, has to live as long as the program
+void set_profiler_thread_name(const char* name);
+
+// Called on the main thread at the start of every frame, ends the previous frame
+void mark_profiler_frame();
+
+// The last count frames that have ended, oldest first
+void get_profiler_frames(usz count, out_ptr<vector<ProfileFrame>> out_frames);
+
+// Zones of every thread that ended between the ticks and have not been overwritten yet, in no particular order.
+// Other threads keep recording while this reads. scratch holds the zones of one thread while they are copied,
+// callers that ask every frame keep it so that it is only allocated once.
+void get_profiler_zones(
+    u64 start_ticks, u64 end_ticks, non_null<vector<ProfileZone>> scratch, out_ptr<vector<ProfileZone>> out_zones);
+
+// Writes the zones of the last frame_count frames as Chrome trace event JSON, which chrome://tracing
+// and Perfetto open. Returns false if the file could not be written.
+bool export_profiler_trace(const char* filename, usz frame_count);
+
+void record_profile_zone(const char* name, u64 start_ticks, u32 depth);
+u32 enter_profile_zone();
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name)
+    {
+        if (is_profiler_enabled())
+        {
+            m_name = name;
+            m_depth = enter_profile_zone();
+            m_start_ticks = read_profiler_ticks();
+        }
+    }
+
+    ~ProfileScope()
+    {
+        if (m_name)
+        {
+            record_profile_zone(m_name, m_start_ticks, m_depth);
+        }
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* m_name{};
+    u64 m_start_ticks{};
+    u32 m_depth{};
+};
+
+}
+
+#if PROFILER_ENABLED
+#define PROFILE_SCOPE(name) ::bstr::core::ProfileScope MACRO_VAR(profile_scope_)(name)
+#else
+#define PROFILE_SCOPE(name) do {} while (0)
+#endif
@@ -10,6 +10,7 @@ using std::make_unique;
 
 using std::shared_ptr;
 using std::make_shared;
+using std::weak_ptr;
 
 using std::static_pointer_cast;
 using std::reinterpret_pointer_cast;
@@ -21,6 +22,7 @@ using bstr::core::make_unique;
 
 using bstr::core::shared_ptr;
 using bstr::core::make_shared;
+using bstr::core::weak_ptr;
 
 using bstr::core::static_pointer_cast;
 using bstr::core::reinterpret_pointer_cast;
@@ -1,73 +1,221 @@
 #pragma once
 
+#include "arena.h"
 #include "containers/span.h"
 #include "containers/string.h"
-#include "containers/vector.h"
+#include "containers/string_view.h"
 #include "utils.h"
 
+#include <cstring>
+#include <memory>
+#include <string_view>
+
 namespace bstr::core {
 
-template<typename CharT>
+// Growable, always null terminated character buffer. The first InlineCapacity characters live inside the
+// builder, e.g. on the stack, and the buffer only comes from the allocator when it grows past that.
+// Formatted appends write straight into the buffer.
+template<typename CharT, usz InlineCapacity = 0, typename Allocator = ::std::allocator<CharT>>
 class basic_string_builder {
 public:
-	void reserve(usz amount) {
-		m_str_buf.resize(amount+1);
-		zero_end_of_buffer();
-	}
-	void append(const basic_string<CharT>& str) { append(span<const CharT> { str.data(), str.size() }); }
-	void append(const CharT* str) { span<const CharT>{ str, strlen(str); } }
-	void append(CharT ch) {
-		char buf[1] = { 0 };
-		buf[0] = ch;
-		append(span<const CharT>{buf, 1});
-	}
-	void append(span<const CharT> str) {
-		ensure_capacity(str.size());
-		usz i = m_str_size;
-		for (CharT c : str) {
-			m_str_buf[i++] = c;
+	using string_view_type = ::std::basic_string_view<CharT>;
+
+	basic_string_builder() = default;
+
+	explicit basic_string_builder(const Allocator& allocator)
+		: m_allocator(allocator)
+	{
+	}
+
+	~basic_string_builder()
+	{
+		free_heap_data();
+	}
+
+	basic_string_builder(const basic_string_builder& other)
+		: m_allocator(other.m_allocator)
+	{
+		append(other.view());
+	}
+
+	basic_string_builder& operator=(const basic_string_builder& other)
+	{
+		if (this != &other)
+		{
+			clear();
+			append(other.view());
 		}
-		m_str_size += str.size();
-	}
-	void ensure_capacity(usz amount) {
-		if (m_str_buf.size() < m_str_size + amount + 1) {
-			usz needed_amount = m_str_size + amount;
-			usz double_reserve = m_str_buf.size() * 2;
-			if (double_reserve == 0) double_reserve = 1;
-			usz reserve_amount = max(double_reserve, needed_amount);
-			reserve(reserve_amount);
+		return *this;
+	}
+
+	basic_string_builder(basic_string_builder&& other)
+		: m_allocator(other.m_allocator)
+	{
+		take(other);
+	}
+
+	basic_string_builder& operator=(basic_string_builder&& other)
+	{
+		if (this != &other)
+		{
+			if (m_allocator == other.m_allocator)
+			{
+				free_heap_data();
+				take(other);
+			}
+			else
+			{
+				clear();
+				append(other.view());
+			}
 		}
+		return *this;
 	}
-	void resize(usz new_size) {
-		m_str_size = new_size;
-		zero_end_of_buffer();
+
+	// Room for capacity characters, not counting the terminator
+	void reserve(usz capacity)
+	{
+		if (capacity > m_capacity)
+		{
+			grow_to(capacity);
+		}
 	}
-	CharT* c_str() {
-		return m_str_buf.data(); 
+
+	void append(string_view_type str)
+	{
+		ensure_capacity(str.size());
+		memcpy(m_data + m_size, str.data(), str.size() * sizeof(CharT));
+		set_size(m_size + str.size());
 	}
-	basic_string<CharT> str() {
-		return basic_string<CharT>(m_str_buf.data(), m_str_size);
+	void append(const basic_string<CharT>& str) { append(string_view_type(str)); }
+	void append(span<const CharT> str) { append(string_view_type(str.data(), str.size())); }
+	void append(const CharT* str) { append(string_view_type(str)); }
+	void append(CharT ch)
+	{
+		ensure_capacity(1);
+		m_data[m_size] = ch;
+		set_size(m_size + 1);
 	}
 
-	usz size() const { return m_str_size; }
-	CharT operator[](usz i) const {
-		ASSERT(i <= m_str_size, "str_builder out of bounds");
-		return m_str_buf[i];
+	// Formats like fmt::format, straight into the buffer. Formats a second time only if the result did not fit.
+	template<typename... Args>
+	void append_format(fmt::format_string<Args...> format, Args&&... args)
+	{
+		usz available = m_capacity - m_size;
+		auto result = fmt::format_to_n(m_data + m_size, available, format, forward<Args>(args)...);
+		if (result.size > available)
+		{
+			grow_to(max(m_size + result.size, m_capacity * 2));
+			fmt::format_to_n(m_data + m_size, result.size, format, forward<Args>(args)...);
+		}
+		set_size(m_size + result.size);
 	}
-private:
-	void zero_end_of_buffer() {
-		if (m_str_buf.empty()) return;
-		ASSERT(m_str_size <= m_str_buf.size(), "string bigger than underlying buffer");
-		memset(m_str_buf.data() + m_str_size, 0, (m_str_buf.size() - m_str_size) * sizeof(CharT));
+
+	// Growing fills the new characters with zeros
+	void resize(usz new_size)
+	{
+		if (new_size > m_size)
+		{
+			reserve(new_size);
+			memset(m_data + m_size, 0, (new_size - m_size) * sizeof(CharT));
+		}
+		set_size(new_size);
 	}
+
+	// Keeps the buffer
+	void clear() { set_size(0); }
+
+	const CharT* c_str() const { return m_data; }
+	CharT* data() { return m_data; }
+	const CharT* data() const { return m_data; }
+	string_view_type view() const { return string_view_type(m_data, m_size); }
+	basic_string<CharT> str() const { return basic_string<CharT>(m_data, m_size); }
+	operator string_view_type() const { return view(); }
+
+	usz size() const { return m_size; }
+	usz capacity() const { return m_capacity; }
+	bool empty() const { return m_size == 0; }
+	CharT operator[](usz i) const
+	{
+		ASSERT(i < m_size, "str_builder out of bounds");
+		return m_data[i];
+	}
+
 private:
-	usz m_str_size = 0;
-	//TODO: Use something where we won't have double capacity (e.g. a custom buffer class)
-	vector<CharT> m_str_buf;
+	static constexpr usz INLINE_BUFFER_SIZE = InlineCapacity + 1;
+
+	bool is_inline() const { return m_data == m_inline; }
+
+	void set_size(usz new_size)
+	{
+		ASSERT(new_size <= m_capacity, "string bigger than underlying buffer");
+		m_size = new_size;
+		m_data[m_size] = 0;
+	}
+
+	void ensure_capacity(usz amount)
+	{
+		if (m_size + amount > m_capacity)
+		{
+			grow_to(max(m_size + amount, m_capacity * 2));
+		}
+	}
+
+	void grow_to(usz capacity)
+	{
+		CharT* new_data = ::std::allocator_traits<Allocator>::allocate(m_allocator, capacity + 1);
+		memcpy(new_data, m_data, (m_size + 1) * sizeof(CharT));
+		free_heap_data();
+		m_data = new_data;
+		m_capacity = capacity;
+	}
+
+	void free_heap_data()
+	{
+		if (!is_inline())
+		{
+			::std::allocator_traits<Allocator>::deallocate(m_allocator, m_data, m_capacity + 1);
+			m_data = m_inline;
+			m_capacity = InlineCapacity;
+		}
+	}
+
+	// other is left empty
+	void take(basic_string_builder& other)
+	{
+		if (other.is_inline())
+		{
+			memcpy(m_inline, other.m_inline, (other.m_size + 1) * sizeof(CharT));
+			m_data = m_inline;
+			m_capacity = InlineCapacity;
+		}
+		else
+		{
+			m_data = other.m_data;
+			m_capacity = other.m_capacity;
+			other.m_data = other.m_inline;
+			other.m_capacity = InlineCapacity;
+		}
+		m_size = other.m_size;
+		other.set_size(0);
+	}
+
+	Allocator m_allocator{};
+	CharT m_inline[INLINE_BUFFER_SIZE] = {};
+	CharT* m_data = m_inline;
+	usz m_size = 0;
+	usz m_capacity = InlineCapacity;
 };
 
 using string_builder = basic_string_builder<char>;
+// For strings built during a frame, e.g. arena_string_builder text(&frame_arena)
+using arena_string_builder = basic_string_builder<char, 0, ArenaAllocator<char>>;
+// Short strings that are built and used in one function, only allocate if they outgrow the stack buffer
+template<usz N>
+using stack_string_builder = basic_string_builder<char, N>;
 
 }
 
-using bstr::core::string_builder;
\ No newline at end of file
+using bstr::core::string_builder;
+using bstr::core::arena_string_builder;
+using bstr::core::stack_string_builder;
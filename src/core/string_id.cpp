@@ -0,0 +1,140 @@
+#include "string_id.h"
+#include "arena.h"
+#include "smart_ptr.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+namespace bstr::core {
+
+// Power of two. Interned names are paths and other asset names, there are not many of them.
+static constexpr usz STRING_INTERNER_CAPACITY = 64 * 1024;
+static constexpr usz STRING_INTERNER_ARENA_SIZE = 256 * MiB;
+
+// Open addressing table that is only ever inserted into. Writers take the lock, readers find the string of an id
+// without it: the string is written before the id is published with release, and read after loading it with acquire.
+class StringInterner {
+public:
+    StringInterner()
+        : m_slots(new Slot[STRING_INTERNER_CAPACITY])
+        , m_strings(STRING_INTERNER_ARENA_SIZE)
+    {
+    }
+
+    const char* find(StringId id, usz* out_length = nullptr) const
+    {
+        usz mask = STRING_INTERNER_CAPACITY - 1;
+        usz i = (usz)containers::mix_hash_bits(id.value) & mask;
+        for (usz probes = 0; probes < STRING_INTERNER_CAPACITY; ++probes, i = (i + 1) & mask)
+        {
+            const Slot& slot = m_slots[i];
+            u64 value = slot.id.load(std::memory_order_acquire);
+            if (value == id.value)
+            {
+                if (out_length)
+                {
+                    *out_length = slot.length;
+                }
+                return slot.str;
+            }
+            if (value == 0)
+            {
+                break;
+            }
+        }
+        return nullptr;
+    }
+
+    StringId intern(string_view str)
+    {
+        StringId id = make_string_id(str.data(), str.size());
+        ASSERT(id.is_valid(), "string hashes to the invalid id");
+
+        usz interned_length = 0;
+        if (const char* interned = find(id, &interned_length))
+        {
+#if defined(IS_DEBUG_BUILD) && IS_DEBUG_BUILD
+            ASSERT(interned_length == str.size() && memcmp(interned, str.data(), str.size()) == 0, "string id collision");
+#endif
+            return id;
+        }
+
+        std::lock_guard lock(m_mutex);
+
+        // Another thread may have interned it while waiting for the lock
+        usz mask = STRING_INTERNER_CAPACITY - 1;
+        usz i = (usz)containers::mix_hash_bits(id.value) & mask;
+        for (usz probes = 0; probes < STRING_INTERNER_CAPACITY; ++probes, i = (i + 1) & mask)
+        {
+            Slot& slot = m_slots[i];
+            u64 value = slot.id.load(std::memory_order_relaxed);
+            if (value == id.value)
+            {
+#if defined(IS_DEBUG_BUILD) && IS_DEBUG_BUILD
+                ASSERT(slot.length == str.size() && memcmp(slot.str, str.data(), str.size()) == 0, "string id collision");
+#endif
+                return id;
+            }
+            if (value == 0)
+            {
+                if (m_count + 1 > STRING_INTERNER_CAPACITY / 2)
+                {
+                    // The id works without its string, only find_interned_string cannot return it
+                    LOG_WARN("String interner is full, {} is not kept", str);
+                    return id;
+                }
+
+                char* copy = m_strings.allocate_array<char>(str.size() + 1);
+                if (!copy)
+                {
+                    LOG_WARN("String interner is out of memory, {} is not kept", str);
+                    return id;
+                }
+                memcpy(copy, str.data(), str.size());
+                copy[str.size()] = '\0';
+
+                slot.str = copy;
+                slot.length = (u32)str.size();
+                slot.id.store(id.value, std::memory_order_release);
+                m_count += 1;
+                return id;
+            }
+        }
+        return id;
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<u64> id{};
+        const char* str{};
+        u32 length{};
+    };
+
+    unique_ptr<Slot[]> m_slots;
+    std::mutex m_mutex;
+    Arena m_strings;
+    usz m_count{};
+};
+
+static StringInterner& get_string_interner()
+{
+    // Never destroyed, ids may be interned and looked up from static destructors
+    static StringInterner* interner = new StringInterner();
+    return *interner;
+}
+
+StringId intern_string(string_view str)
+{
+    StringId result = get_string_interner().intern(str);
+    return result;
+}
+
+const char* find_interned_string(StringId id)
+{
+    const char* result = get_string_interner().find(id);
+    return result;
+}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "def.h"
+#include "utils.h"
+#include "containers/hashmap.h"
+#include "containers/string_view.h"
+
+namespace bstr::core {
+
+// 64-bit FNV-1a hash of a string, compared and hashed as an integer. Ids of literals are computed at compile time
+// with "images/duck.jpg"_sid. intern_string also keeps the string, so that the id can be turned back into it.
+struct StringId
+{
+    u64 value{};
+
+    bool is_valid() const { return value != 0; }
+
+    bool operator==(StringId other) const { return value == other.value; }
+    bool operator!=(StringId other) const { return value != other.value; }
+    bool operator<(StringId other) const { return value < other.value; }
+};
+
+constexpr StringId make_string_id(const char* str, usz length)
+{
+    StringId result = { hash_fnv1a(str, length) };
+    return result;
+}
+
+// Id of the string of id followed by suffix, which is the same as the id of the whole string. The whole string
+// is not interned, so this is for keys that are only compared, e.g. a file name and its load options.
+constexpr StringId extend_string_id(StringId id, const char* suffix, usz length)
+{
+    StringId result = { hash_fnv1a(suffix, length, id.value) };
+    return result;
+}
+
+// Thread safe. Looking up a string that is already interned does not take a lock.
+StringId intern_string(string_view str);
+
+// The interned string of the id, or nullptr if it has not been interned, e.g. ids of literals that were never
+// passed to intern_string. Meant for logs and debugging, the string lives as long as the program.
+const char* find_interned_string(StringId id);
+
+namespace string_id_literals {
+
+constexpr StringId operator""_sid(const char* str, usz length)
+{
+    return make_string_id(str, length);
+}
+
+}
+
+}
+
+namespace bstr::core::containers {
+
+// The id is already a hash, but FNV-1a does not spread short strings well enough for the control bytes
+template<>
+struct default_hash<::bstr::core::StringId> {
+    u64 operator()(::bstr::core::StringId id) const { return mix_hash_bits(id.value); }
+};
+
+}
+
+using bstr::core::StringId;
+using namespace bstr::core::string_id_literals;
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "def.h"
+#include "out_ptr.h"
+#include "containers/string_view.h"
+
+namespace bstr::core {
+
+static constexpr u32 UNICODE_REPLACEMENT_CHARACTER = 0xFFFD;
+
+// Decodes the codepoint starting at *index and advances index past it. Invalid or truncated
+// sequences decode as the replacement character and advance by one byte, so decoding always progresses.
+inline u32 utf8_decode_next(string_view text, out_ptr<usz> index)
+{
+    usz i = *index;
+    u8 lead = (u8)text[i];
+
+    u32 codepoint;
+    usz length;
+    if (lead < 0x80)
+    {
+        *index = i + 1;
+        return lead;
+    }
+    else if ((lead & 0xE0) == 0xC0)
+    {
+        codepoint = lead & 0x1F;
+        length = 2;
+    }
+    else if ((lead & 0xF0) == 0xE0)
+    {
+        codepoint = lead & 0x0F;
+        length = 3;
+    }
+    else if ((lead & 0xF8) == 0xF0)
+    {
+        codepoint = lead & 0x07;
+        length = 4;
+    }
+    else
+    {
+        *index = i + 1;
+        return UNICODE_REPLACEMENT_CHARACTER;
+    }
+
+    if (i + length > text.size())
+    {
+        *index = i + 1;
+        return UNICODE_REPLACEMENT_CHARACTER;
+    }
+
+    for (usz byte_idx = 1; byte_idx < length; ++byte_idx)
+    {
+        u8 continuation = (u8)text[i + byte_idx];
+        if ((continuation & 0xC0) != 0x80)
+        {
+            *index = i + 1;
+            return UNICODE_REPLACEMENT_CHARACTER;
+        }
+        codepoint = (codepoint << 6) | (continuation & 0x3F);
+    }
+
+    // Reject overlong encodings, surrogates and values past the unicode range
+    static constexpr u32 min_codepoint_for_length[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+    if (codepoint < min_codepoint_for_length[length]
+        || (codepoint >= 0xD800 && codepoint <= 0xDFFF)
+        || codepoint > 0x10FFFF)
+    {
+        *index = i + 1;
+        return UNICODE_REPLACEMENT_CHARACTER;
+    }
+
+    *index = i + length;
+    return codepoint;
+}
+
+}
@@ -4,6 +4,9 @@
 #include "containers/vector.h"
 
 #include <limits>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 #include <spdlog/spdlog.h>
 
 #include <utility>
@@ -53,6 +56,17 @@ inline bool is_power_of_two(uptr value)
     return result;
 }
 
+// Smallest power of two that is at least value, value itself if it is one
+inline uptr next_power_of_two(uptr value)
+{
+    uptr result = 1;
+    while (result < value)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
 inline uptr align_forwards(uptr value, usz alignment)
 {
     ASSERT(is_power_of_two(alignment), "alignment not power of two");
@@ -69,12 +83,47 @@ inline uptr align_forwards(uptr value, usz alignment)
 inline uptr align_backwards(uptr value, usz alignment)
 {
     ASSERT(is_power_of_two(alignment), "alignment not power of two");
-    uptr result = value & alignment;
+    uptr result = value & ~(uptr)(alignment - 1);
     return result;
 }
 
 using std::numeric_limits;
 
+// Index of the lowest set bit, value must not be zero
+inline u32 count_trailing_zeros(u32 value)
+{
+    ASSERT(value != 0, "no bits set");
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward(&index, value);
+    u32 result = (u32)index;
+#else
+    u32 result = (u32)__builtin_ctz(value);
+#endif
+    return result;
+}
+
+static constexpr u64 FNV1A_64_OFFSET_BASIS = 0xcbf29ce484222325ull;
+static constexpr u64 FNV1A_64_PRIME = 0x100000001b3ull;
+
+// 64-bit FNV-1a, constexpr so that it can be used to hash literals at compile time.
+// Pass a previous result as hash to continue hashing.
+constexpr u64 hash_fnv1a(const char* data, usz size, u64 hash = FNV1A_64_OFFSET_BASIS)
+{
+    for (usz i = 0; i < size; ++i)
+    {
+        hash ^= (u64)(u8)data[i];
+        hash *= FNV1A_64_PRIME;
+    }
+    return hash;
+}
+
+inline u64 hash_bytes(const void* data, usz size, u64 hash = FNV1A_64_OFFSET_BASIS)
+{
+    u64 result = hash_fnv1a((const char*)data, size, hash);
+    return result;
+}
+
 
 template<class T>
 inline void zero_struct(T* s) {
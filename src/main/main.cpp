@@ -1,5 +1,8 @@
 #include "core/def.h"
 #include "core/utils.h"
+#include "core/arena.h"
+#include "core/jobs.h"
+#include "core/profiler.h"
 #include "core/containers/common.h"
 #include "core/string_builder.h"
 #include "core/asefile.h"
@@ -9,6 +12,8 @@
 
 #include "renderer/renderer.h"
 
+#include "profiler_overlay.h"
+
 #include "SDL.h"
 
 #include "imgui.h"
@@ -30,6 +35,7 @@ public:
 		}
 
 		core::logger_init();
+		set_profiler_thread_name("main");
 
 		auto ase_file = AseFile::load_from_file("images/guy.ase");
 
@@ -83,28 +89,47 @@ public:
 
 		ImGui_ImplSDL2_InitForD3D(m_window);
 
-		auto renderer = create_renderer();
+		// A worker for every core but the one of the main thread, which runs jobs while it waits for them
+		JobSystem job_system(max(std::thread::hardware_concurrency(), 2u) - 1);
+
+		auto renderer = create_renderer(&job_system);
 		if (!renderer) {
 			LOG_ERROR("Failed to create renderer");
 			return EXIT_FAILURE;
 		}
 
 		auto time_last = get_highresolution_time_seconds();
-		auto texture = renderer->create_texture_from_file("images/duck.jpg");
-		auto texture2 = renderer->create_texture_from_file("images/sloth.jpg");
+		auto texture = renderer->create_texture_from_file_async("images/duck.jpg");
+		auto texture2 = renderer->create_texture_from_file_async("images/sloth.jpg");
 
 		auto roboto_mono = renderer->create_font("fonts/RobotoMono-Regular.ttf", 18.f);
+		auto title_text = renderer->create_text_layout(roboto_mono, "what is going on");
 
 		bool show_demo_window = true;
 		bool show_another_window = false;
 		ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
-		u64 draw_calls_prev_frame = 0;
-		string info_text;
+		// Frame temporaries are allocated from the arena of the frame, which is reset when it comes around again.
+		// There are two, so that what was allocated during the previous frame can still be used.
+		Arena frame_arenas[2] = { Arena(FRAME_ARENA_RESERVE_SIZE), Arena(FRAME_ARENA_RESERVE_SIZE) };
+		u64 frame_index = 0;
+
+		ProfilerOverlay profiler_overlay;
+		RendererStats stats_prev_frame{};
+		ResourceCacheStats cache_stats{};
+		u32 fps = 0;
+		f32 frame_time = 0;
 		f64 last_frame_test = 0;
 		usz frame_count = 0;
 		bool quit = false;
 		while (!quit) {
+			mark_profiler_frame();
+			PROFILE_SCOPE("Game::run frame");
+
+			Arena& frame_arena = frame_arenas[frame_index % ARRAY_COUNT(frame_arenas)];
+			frame_arena.reset();
+			++frame_index;
+
 			SDL_Event event;
 			while (SDL_PollEvent(&event) != 0)
 			{
@@ -120,6 +145,14 @@ public:
 					{
 						quit = true;
 					}
+					else if (event.key.keysym.sym == SDLK_F3 && !event.key.repeat)
+					{
+						profiler_overlay.toggle();
+					}
+					else if (event.key.keysym.sym == SDLK_F9)
+					{
+						export_profiler_trace(PROFILER_TRACE_FILENAME, PROFILER_TRACE_FRAME_COUNT);
+					}
 				}
 			}
 
@@ -131,19 +164,31 @@ public:
 			f64 frame_test_delta = time_now - last_frame_test;
 			if (frame_test_delta >= 0.5)
 			{
-				u32 fps = (u32)((f64)(frame_count / frame_test_delta));
+				fps = (u32)((f64)(frame_count / frame_test_delta));
+				frame_time = delta_time * 1.e3f;
 				frame_count = 0;
 				last_frame_test = time_now;
 
-				info_text = fmt::format("FPS: {}, Frame time: {}, draw_calls {}",
-					fps, delta_time * 1.e3, draw_calls_prev_frame);
+				renderer->get_resource_cache_stats(&cache_stats);
 			}
+			profiler_overlay.record_frame(delta_time, stats_prev_frame, cache_stats);
+
+			arena_string_builder info_text(&frame_arena);
+			info_text.reserve(256);
+			info_text.append_format(
+				"FPS: {}, Frame time: {}, draw_calls {}, sprites {}, culled {}, textures {} ({} KiB, {} hits, {} misses), frame arena {} KiB",
+				fps, frame_time, stats_prev_frame.draw_calls,
+				stats_prev_frame.sprites_submitted, stats_prev_frame.sprites_culled,
+				cache_stats.textures_alive, cache_stats.texture_memory_bytes / KiB,
+				cache_stats.texture_hits, cache_stats.texture_misses,
+				frame_arena.peak_used() / KiB);
 
 			renderer->begin_frame({ clear_color.x, clear_color.y, clear_color.z, clear_color.w });
 			ImGui_ImplSDL2_NewFrame();
 			ImGui::NewFrame();
+			profiler_overlay.draw();
 
-			renderer->draw_text(roboto_mono, "what is going on", 30, 30);
+			renderer->draw_text_layout(title_text, 30, 30);
 			renderer->draw_text(roboto_mono, info_text, 10, 10);
 
 
@@ -174,7 +219,7 @@ public:
 			ImGui::Render();
 
 			bool use_vsync = false;
-			renderer->end_frame(use_vsync, &draw_calls_prev_frame);
+			renderer->end_frame(use_vsync, &stats_prev_frame);
 
 			// Update and Render additional Platform Windows
 			if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
@@ -237,6 +282,11 @@ public:
 
 
 private:
+	static constexpr usz FRAME_ARENA_RESERVE_SIZE = 256 * MiB;
+	// F9 writes the last frames to a file that chrome://tracing and Perfetto open
+	static constexpr const char* PROFILER_TRACE_FILENAME = "profile_trace.json";
+	static constexpr usz PROFILER_TRACE_FRAME_COUNT = 120;
+
 	SDL_Window* m_window{};
 };
 
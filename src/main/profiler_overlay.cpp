@@ -0,0 +1,176 @@
+#include "profiler_overlay.h"
+
+#include "core/utils.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace bstr::core;
+using namespace bstr::renderer;
+
+namespace bstr {
+
+// Zones of threads past this many are not shown
+static constexpr u32 PROFILER_OVERLAY_MAX_THREADS = 64;
+
+// The same zone gets the same color in every frame
+static ImU32 get_zone_color(const char* name)
+{
+	u64 hash = hash_fnv1a(name, strlen(name));
+	ImU32 result = IM_COL32(120 + (hash & 0x7f), 120 + ((hash >> 8) & 0x7f), 120 + ((hash >> 16) & 0x7f), 255);
+	return result;
+}
+
+void ProfilerOverlay::record_frame(f32 frame_time_seconds, const RendererStats& stats, const ResourceCacheStats& cache_stats)
+{
+	m_frame_times_ms[m_frame_count % PROFILER_OVERLAY_FRAME_HISTORY] = frame_time_seconds * 1e3f;
+	m_frame_count += 1;
+	m_stats = stats;
+	m_cache_stats = cache_stats;
+}
+
+void ProfilerOverlay::draw()
+{
+	if (!m_is_visible)
+	{
+		return;
+	}
+	PROFILE_SCOPE("ProfilerOverlay::draw");
+
+	ImGui::SetNextWindowSize(ImVec2(760, 560), ImGuiCond_FirstUseEver);
+	if (ImGui::Begin("Profiler", &m_is_visible))
+	{
+		draw_frame_times();
+		ImGui::Separator();
+		draw_flame_view();
+		ImGui::Separator();
+		draw_renderer_counters();
+	}
+	ImGui::End();
+}
+
+void ProfilerOverlay::draw_frame_times()
+{
+	usz count = min(m_frame_count, PROFILER_OVERLAY_FRAME_HISTORY);
+	if (count == 0)
+	{
+		return;
+	}
+
+	memcpy(m_sorted_frame_times_ms, m_frame_times_ms, count * sizeof(f32));
+	std::sort(m_sorted_frame_times_ms, m_sorted_frame_times_ms + count);
+	auto percentile = [&](f32 fraction) {
+		usz index = min((usz)(fraction * (f32)(count - 1) + 0.5f), count - 1);
+		return m_sorted_frame_times_ms[index];
+	};
+	f32 max_ms = m_sorted_frame_times_ms[count - 1];
+
+	ImGui::Text("Frame time over the last %d frames (ms)", (int)count);
+	ImGui::Text("p50 %.2f   p95 %.2f   p99 %.2f   max %.2f", percentile(0.5f), percentile(0.95f), percentile(0.99f), max_ms);
+
+	// Scaled to the slowest frame, so that spikes always show. The ring starts at its oldest frame once it is full.
+	int offset = m_frame_count > PROFILER_OVERLAY_FRAME_HISTORY ? (int)(m_frame_count % PROFILER_OVERLAY_FRAME_HISTORY) : 0;
+	ImGui::PlotLines(
+		"##frame_times", m_frame_times_ms, (int)count, offset, nullptr,
+		0.f, max(max_ms, 1.f), ImVec2(ImGui::GetContentRegionAvail().x, 80));
+}
+
+void ProfilerOverlay::draw_flame_view()
+{
+	ImGui::SliderInt("Frames", &m_flame_frame_count, 1, PROFILER_OVERLAY_MAX_FLAME_FRAMES);
+#if PROFILER_ENABLED
+	get_profiler_frames((usz)m_flame_frame_count, &m_frames);
+	if (m_frames.empty())
+	{
+		return;
+	}
+	u64 start_ticks = m_frames.front().start_ticks;
+	u64 end_ticks = m_frames.back().end_ticks;
+	get_profiler_zones(start_ticks, end_ticks, &m_zone_scratch, &m_zones);
+
+	// Every thread gets as many rows as it has nested zones, threads in the order they were first seen
+	u32 first_rows[PROFILER_OVERLAY_MAX_THREADS] = {};
+	u32 thread_rows[PROFILER_OVERLAY_MAX_THREADS] = {};
+	for (const ProfileZone& zone : m_zones)
+	{
+		if (zone.thread_index < ARRAY_COUNT(thread_rows))
+		{
+			thread_rows[zone.thread_index] = max(thread_rows[zone.thread_index], zone.depth + 1);
+		}
+	}
+	u32 row_count = 0;
+	for (usz i = 0; i < ARRAY_COUNT(thread_rows); ++i)
+	{
+		first_rows[i] = row_count;
+		row_count += thread_rows[i];
+	}
+
+	f32 row_height = ImGui::GetTextLineHeight() + 4.f;
+	ImVec2 origin = ImGui::GetCursorScreenPos();
+	ImVec2 size = ImVec2(ImGui::GetContentRegionAvail().x, max((f32)row_count, 1.f) * row_height);
+	ImVec2 corner = ImVec2(origin.x + size.x, origin.y + size.y);
+	ImGui::Dummy(size);
+
+	ImDrawList* draw_list = ImGui::GetWindowDrawList();
+	draw_list->PushClipRect(origin, corner, true);
+	draw_list->AddRectFilled(origin, corner, IM_COL32(30, 30, 30, 255));
+
+	f32 pixels_per_tick = size.x / (f32)max(end_ticks - start_ticks, (u64)1);
+	for (const ProfileFrame& frame : m_frames)
+	{
+		f32 x = origin.x + (f32)(frame.start_ticks - start_ticks) * pixels_per_tick;
+		draw_list->AddLine(ImVec2(x, origin.y), ImVec2(x, corner.y), IM_COL32(255, 255, 255, 80));
+	}
+
+	const ProfileZone* hovered_zone = nullptr;
+	for (const ProfileZone& zone : m_zones)
+	{
+		if (zone.thread_index >= ARRAY_COUNT(thread_rows))
+		{
+			continue;
+		}
+
+		u64 zone_start = max(zone.start_ticks, start_ticks);
+		f32 x0 = origin.x + (f32)(zone_start - start_ticks) * pixels_per_tick;
+		f32 x1 = max(origin.x + (f32)(zone.end_ticks - start_ticks) * pixels_per_tick, x0 + 1.f);
+		f32 y0 = origin.y + (f32)(first_rows[zone.thread_index] + zone.depth) * row_height;
+		f32 y1 = y0 + row_height - 1.f;
+		draw_list->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y1), get_zone_color(zone.name));
+
+		if (ImGui::CalcTextSize(zone.name).x + 4.f <= x1 - x0)
+		{
+			draw_list->AddText(ImVec2(x0 + 2.f, y0 + 2.f), IM_COL32(0, 0, 0, 255), zone.name);
+		}
+		if (ImGui::IsMouseHoveringRect(ImVec2(x0, y0), ImVec2(x1, y1)))
+		{
+			hovered_zone = &zone;
+		}
+	}
+	draw_list->PopClipRect();
+
+	if (hovered_zone)
+	{
+		f64 duration_ms = profiler_ticks_to_seconds(hovered_zone->end_ticks - hovered_zone->start_ticks) * 1e3;
+		ImGui::SetTooltip("%s\n%.3f ms on thread %u", hovered_zone->name, duration_ms, hovered_zone->thread_index);
+	}
+#else
+	ImGui::TextUnformatted("Zones are only recorded in internal builds");
+#endif
+}
+
+void ProfilerOverlay::draw_renderer_counters()
+{
+	ImGui::Text("Draw calls %llu   sprite batches %llu", (unsigned long long)m_stats.draw_calls, (unsigned long long)m_stats.sprite_batches);
+	ImGui::Text(
+		"Sprites %llu submitted, %llu culled",
+		(unsigned long long)m_stats.sprites_submitted, (unsigned long long)m_stats.sprites_culled);
+	ImGui::Text("Instance data uploaded %.1f KiB", (f64)m_stats.instance_bytes_uploaded / KiB);
+	ImGui::Text(
+		"Textures %llu, %.1f MiB   fonts %llu, %.1f MiB",
+		(unsigned long long)m_cache_stats.textures_alive, (f64)m_cache_stats.texture_memory_bytes / MiB,
+		(unsigned long long)m_cache_stats.fonts_alive, (f64)m_cache_stats.font_memory_bytes / MiB);
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "core/def.h"
+#include "core/profiler.h"
+#include "core/containers/vector.h"
+
+#include "renderer/renderer.h"
+
+namespace bstr {
+
+// Frame times the graph and percentiles are computed over
+static constexpr usz PROFILER_OVERLAY_FRAME_HISTORY = 300;
+// Most frames the flame view can show at once
+static constexpr int PROFILER_OVERLAY_MAX_FLAME_FRAMES = 16;
+
+// ImGui window with frame times, the profiler zones of the last frames and renderer counters.
+// Frames are recorded while it is hidden too, so the history is full when it is shown.
+class ProfilerOverlay {
+public:
+	// Called once per frame, only stores the numbers
+	void record_frame(
+		f32 frame_time_seconds,
+		const renderer::RendererStats& stats,
+		const renderer::ResourceCacheStats& cache_stats);
+
+	// Between ImGui::NewFrame and ImGui::Render. Does nothing while hidden.
+	void draw();
+
+	void toggle() { m_is_visible = !m_is_visible; }
+	bool is_visible() const { return m_is_visible; }
+
+private:
+	void draw_frame_times();
+	void draw_flame_view();
+	void draw_renderer_counters();
+
+	bool m_is_visible{};
+
+	f32 m_frame_times_ms[PROFILER_OVERLAY_FRAME_HISTORY]{};
+	usz m_frame_count{};
+	renderer::RendererStats m_stats{};
+	renderer::ResourceCacheStats m_cache_stats{};
+
+	int m_flame_frame_count = 2;
+
+	// Kept between frames so that drawing does not allocate
+	f32 m_sorted_frame_times_ms[PROFILER_OVERLAY_FRAME_HISTORY]{};
+	vector<core::ProfileFrame> m_frames;
+	vector<core::ProfileZone> m_zones;
+	vector<core::ProfileZone> m_zone_scratch;
+};
+
+}
@@ -0,0 +1,192 @@
+// Copyright (c) 2023, Roni Juppi <roni.juppi@gmail.com>
+
+#include "glyph_atlas.h"
+#include "utils.h"
+
+#include <cstring>
+
+using namespace bstr::core;
+
+namespace bstr::renderer {
+
+// Empty pixels around each glyph so that filtering does not bleed neighbouring glyphs in
+static constexpr u32 GLYPH_PADDING = 1;
+
+// Shelf heights are rounded up to this, so glyphs of about the same size share shelves
+static constexpr u32 SHELF_HEIGHT_GRANULARITY = 4;
+
+GlyphAtlas::GlyphAtlas(u32 width, u32 height)
+    : m_width(width)
+    , m_height(height)
+{
+    m_pixels.resize((usz)width * height);
+}
+
+const AtlasGlyph* GlyphAtlas::find(u32 glyph_key, u64 frame_index)
+{
+    auto it = m_glyphs.find(glyph_key);
+    if (it == m_glyphs.end())
+    {
+        return nullptr;
+    }
+
+    const AtlasGlyph& glyph = it->second;
+    if (glyph.shelf != GLYPH_ATLAS_NO_SHELF)
+    {
+        touch_shelf(glyph.shelf, frame_index);
+    }
+    return &glyph;
+}
+
+AtlasGlyph* GlyphAtlas::add(u32 glyph_key, u32 bitmap_width, u32 bitmap_height, u64 frame_index)
+{
+    ASSERT(m_glyphs.find(glyph_key) == m_glyphs.end(), "glyph is already in the atlas");
+
+    if (bitmap_width == 0 || bitmap_height == 0)
+    {
+        AtlasGlyph& glyph = m_glyphs[glyph_key];
+        glyph = {};
+        return &glyph;
+    }
+
+    u32 padded_width = bitmap_width + 2 * GLYPH_PADDING;
+    u32 padded_height = bitmap_height + 2 * GLYPH_PADDING;
+    u32 shelf_index = find_shelf(padded_width, padded_height, frame_index);
+    if (shelf_index == GLYPH_ATLAS_NO_SHELF)
+    {
+        return nullptr;
+    }
+
+    Shelf& shelf = m_shelves[shelf_index];
+
+    AtlasRect padded_rect = { shelf.cursor_x, shelf.y, padded_width, padded_height };
+    shelf.cursor_x += padded_width;
+    shelf.last_used_frame = frame_index;
+    shelf.glyph_keys.push_back(glyph_key);
+
+    clear_rect(padded_rect);
+    mark_dirty(padded_rect);
+
+    AtlasGlyph& glyph = m_glyphs[glyph_key];
+    glyph = {};
+    glyph.shelf = shelf_index;
+    glyph.rect.x = padded_rect.x + GLYPH_PADDING;
+    glyph.rect.y = padded_rect.y + GLYPH_PADDING;
+    glyph.rect.width = bitmap_width;
+    glyph.rect.height = bitmap_height;
+    return &glyph;
+}
+
+void GlyphAtlas::touch_shelf(u32 shelf, u64 frame_index)
+{
+    ASSERT(shelf < m_shelves.size(), "invalid glyph atlas shelf");
+    m_shelves[shelf].last_used_frame = frame_index;
+}
+
+bool GlyphAtlas::take_dirty_rect(out_ptr<AtlasRect> out_rect)
+{
+    if (!m_is_dirty)
+    {
+        return false;
+    }
+    *out_rect = m_dirty_rect;
+    m_is_dirty = false;
+    return true;
+}
+
+u32 GlyphAtlas::find_shelf(u32 padded_width, u32 padded_height, u64 frame_index)
+{
+    if (padded_width > m_width || padded_height > m_height)
+    {
+        return GLYPH_ATLAS_NO_SHELF;
+    }
+
+    u32 shelf_height = (u32)align_forwards(padded_height, SHELF_HEIGHT_GRANULARITY);
+
+    // Best fit from the shelves that still have room
+    u32 best_shelf = GLYPH_ATLAS_NO_SHELF;
+    for (u32 shelf_index = 0; shelf_index < (u32)m_shelves.size(); ++shelf_index)
+    {
+        const Shelf& shelf = m_shelves[shelf_index];
+        bool fits = shelf.height >= padded_height && shelf.cursor_x + padded_width <= m_width;
+        bool not_wasteful = shelf.height <= shelf_height + shelf_height / 2;
+        if (fits && not_wasteful)
+        {
+            if (best_shelf == GLYPH_ATLAS_NO_SHELF || shelf.height < m_shelves[best_shelf].height)
+            {
+                best_shelf = shelf_index;
+            }
+        }
+    }
+    if (best_shelf != GLYPH_ATLAS_NO_SHELF)
+    {
+        return best_shelf;
+    }
+
+    if (m_next_shelf_y + shelf_height <= m_height)
+    {
+        Shelf& shelf = m_shelves.emplace_back();
+        shelf.y = m_next_shelf_y;
+        shelf.height = shelf_height;
+        m_next_shelf_y += shelf_height;
+        return (u32)(m_shelves.size() - 1);
+    }
+
+    // Atlas is full, take over the least recently used shelf that is tall enough
+    u32 lru_shelf = GLYPH_ATLAS_NO_SHELF;
+    for (u32 shelf_index = 0; shelf_index < (u32)m_shelves.size(); ++shelf_index)
+    {
+        const Shelf& shelf = m_shelves[shelf_index];
+        if (shelf.height < padded_height || shelf.last_used_frame == frame_index)
+        {
+            continue;
+        }
+        if (lru_shelf == GLYPH_ATLAS_NO_SHELF || shelf.last_used_frame < m_shelves[lru_shelf].last_used_frame)
+        {
+            lru_shelf = shelf_index;
+        }
+    }
+    if (lru_shelf != GLYPH_ATLAS_NO_SHELF)
+    {
+        evict_shelf(lru_shelf);
+    }
+    return lru_shelf;
+}
+
+void GlyphAtlas::evict_shelf(u32 shelf_index)
+{
+    Shelf& shelf = m_shelves[shelf_index];
+    for (u32 glyph_key : shelf.glyph_keys)
+    {
+        m_glyphs.erase(glyph_key);
+    }
+    shelf.glyph_keys.clear();
+    shelf.cursor_x = 0;
+    m_generation += 1;
+}
+
+void GlyphAtlas::clear_rect(AtlasRect rect)
+{
+    for (u32 y = rect.y; y < rect.y + rect.height; ++y)
+    {
+        memset(m_pixels.data() + (usz)y * stride() + rect.x, 0, rect.width);
+    }
+}
+
+void GlyphAtlas::mark_dirty(AtlasRect rect)
+{
+    if (!m_is_dirty)
+    {
+        m_dirty_rect = rect;
+        m_is_dirty = true;
+        return;
+    }
+
+    u32 x0 = min(m_dirty_rect.x, rect.x);
+    u32 y0 = min(m_dirty_rect.y, rect.y);
+    u32 x1 = max(m_dirty_rect.x + m_dirty_rect.width, rect.x + rect.width);
+    u32 y1 = max(m_dirty_rect.y + m_dirty_rect.height, rect.y + rect.height);
+    m_dirty_rect = { x0, y0, x1 - x0, y1 - y0 };
+}
+
+}
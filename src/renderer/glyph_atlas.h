@@ -0,0 +1,91 @@
+// Copyright (c) 2023, Roni Juppi <roni.juppi@gmail.com>
+
+#pragma once
+
+#include "def.h"
+#include "out_ptr.h"
+#include "containers/hashmap.h"
+#include "containers/vector.h"
+
+namespace bstr::renderer {
+
+static constexpr u32 GLYPH_ATLAS_NO_SHELF = ~0u;
+
+struct AtlasRect
+{
+    u32 x{}, y{};
+    u32 width{}, height{};
+};
+
+struct AtlasGlyph
+{
+    u32 shelf = GLYPH_ATLAS_NO_SHELF; // Glyphs without a bitmap (e.g. space) are not in any shelf
+    AtlasRect rect{}; // Bitmap of the glyph in the atlas, not including padding
+
+    f32 x_offset{}; // From the pen position to the top-left of the bitmap
+    f32 y_offset{};
+    f32 x_advance{};
+};
+
+// 8-bit glyph atlas that is filled on demand. Glyphs are packed into horizontal shelves, and when the
+// atlas is full the least recently used shelf is emptied for new glyphs. Shelves used in the current frame
+// are never evicted, because queued sprites may still refer to them.
+//
+// The atlas only manages the CPU copy of the pixels, the backend uploads the dirty rect to its texture.
+class GlyphAtlas {
+public:
+    GlyphAtlas() = default;
+    GlyphAtlas(u32 width, u32 height);
+
+    // Returns nullptr if the glyph is not in the atlas. Marks the shelf of the glyph used in this frame.
+    // Returned pointers are valid until the next add.
+    const AtlasGlyph* find(u32 glyph_key, u64 frame_index);
+
+    // Reserves space for a glyph bitmap. The caller writes the bitmap to glyph->rect in pixels() and
+    // fills in the metrics. Returns nullptr if there is no space even after eviction.
+    AtlasGlyph* add(u32 glyph_key, u32 bitmap_width, u32 bitmap_height, u64 frame_index);
+
+    void touch_shelf(u32 shelf, u64 frame_index);
+
+    // Returns false if nothing has changed since the last call
+    bool take_dirty_rect(out_ptr<AtlasRect> out_rect);
+
+    u8* pixels() { return m_pixels.data(); }
+    u32 width() const { return m_width; }
+    u32 height() const { return m_height; }
+    u32 stride() const { return m_width; }
+
+    // Incremented when glyphs are evicted, anything that remembers atlas positions is stale after that
+    u64 generation() const { return m_generation; }
+    usz glyph_count() const { return m_glyphs.size(); }
+
+private:
+    struct Shelf
+    {
+        u32 y{};
+        u32 height{};
+        u32 cursor_x{};
+        u64 last_used_frame{};
+        vector<u32> glyph_keys;
+    };
+
+    u32 find_shelf(u32 padded_width, u32 padded_height, u64 frame_index);
+    void evict_shelf(u32 shelf_index);
+    void clear_rect(AtlasRect rect);
+    void mark_dirty(AtlasRect rect);
+
+    u32 m_width{};
+    u32 m_height{};
+    vector<u8> m_pixels;
+
+    vector<Shelf> m_shelves;
+    u32 m_next_shelf_y{};
+
+    hash_map<u32, AtlasGlyph> m_glyphs;
+
+    AtlasRect m_dirty_rect{};
+    bool m_is_dirty{};
+    u64 m_generation{};
+};
+
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2023, Roni Juppi <roni.juppi@gmail.com>
+
+#include "glyph_run_cache.h"
+#include "utils.h"
+
+using namespace bstr::core;
+
+namespace bstr::renderer {
+
+// Runs that are not drawn for this many frames are removed
+static constexpr u64 GLYPH_RUN_MAX_UNUSED_FRAMES = 120;
+
+static bool colors_equal(const Color& a, const Color& b)
+{
+    bool result = a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+    return result;
+}
+
+u64 GlyphRunCache::make_key(u64 font_id, string_view text, Color tint_color)
+{
+    u64 key = hash_bytes(&font_id, sizeof(font_id));
+    key = hash_bytes(&tint_color, sizeof(tint_color), key);
+    key = hash_bytes(text.data(), text.size(), key);
+    return key;
+}
+
+GlyphRun* GlyphRunCache::find(u64 font_id, string_view text, Color tint_color, u64 frame_index)
+{
+    auto it = m_runs.find(make_key(font_id, text, tint_color));
+    if (it == m_runs.end())
+    {
+        return nullptr;
+    }
+
+    // Different text with the same hash, treat as a miss and let insert replace it
+    GlyphRun& run = it->second;
+    if (run.font_id != font_id || run.text != text || !colors_equal(run.tint_color, tint_color))
+    {
+        return nullptr;
+    }
+
+    run.last_used_frame = frame_index;
+    return &run;
+}
+
+GlyphRun& GlyphRunCache::insert(u64 font_id, string_view text, Color tint_color, u64 frame_index)
+{
+    GlyphRun& run = m_runs[make_key(font_id, text, tint_color)];
+    run.font_id = font_id;
+    run.text = string(text);
+    run.tint_color = tint_color;
+    run.last_used_frame = frame_index;
+    run.sprites.clear();
+    run.atlas_shelves.clear();
+    return run;
+}
+
+void GlyphRunCache::evict_unused(u64 frame_index)
+{
+    // No need to walk through the whole cache every frame
+    if (frame_index - m_last_eviction_frame < GLYPH_RUN_MAX_UNUSED_FRAMES)
+    {
+        return;
+    }
+    m_last_eviction_frame = frame_index;
+
+    for (auto it = m_runs.begin(); it != m_runs.end();)
+    {
+        if (frame_index - it->second.last_used_frame > GLYPH_RUN_MAX_UNUSED_FRAMES)
+        {
+            it = m_runs.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+}
@@ -0,0 +1,56 @@
+// Copyright (c) 2023, Roni Juppi <roni.juppi@gmail.com>
+
+#pragma once
+
+#include "def.h"
+#include "containers/hashmap.h"
+#include "containers/small_vector.h"
+#include "containers/string.h"
+#include "containers/string_view.h"
+#include "containers/vector.h"
+#include "sprite_batch.h"
+
+namespace bstr::renderer {
+
+// Most text on screen is short labels, their sprites and shelves fit in the run without allocating
+static constexpr usz GLYPH_RUN_INLINE_SPRITES = 16;
+static constexpr usz GLYPH_RUN_INLINE_SHELVES = 4;
+
+// Laid out glyphs of a string, relative to the origin of the text
+struct GlyphRun
+{
+    u64 font_id{};
+    string text;
+    Color tint_color{};
+    u64 last_used_frame{};
+
+    small_vector<SpriteDrawCmd, GLYPH_RUN_INLINE_SPRITES> sprites;
+
+    // Glyph atlas shelves the sprites refer to, and the atlas generation they were laid out with
+    small_vector<u32, GLYPH_RUN_INLINE_SHELVES> atlas_shelves;
+    u64 atlas_generation{};
+};
+
+// Caches laid out text by (font, text, tint), so that text which does not change between frames
+// can be drawn by copying the glyph sprites instead of laying the text out again.
+// Runs that have not been used for a while are evicted.
+class GlyphRunCache {
+public:
+    // Returns nullptr if there is no cached run
+    GlyphRun* find(u64 font_id, string_view text, Color tint_color, u64 frame_index);
+
+    // The caller lays out the text of the returned run
+    GlyphRun& insert(u64 font_id, string_view text, Color tint_color, u64 frame_index);
+
+    void evict_unused(u64 frame_index);
+
+    usz size() const { return m_runs.size(); }
+
+private:
+    static u64 make_key(u64 font_id, string_view text, Color tint_color);
+
+    hash_map<u64, GlyphRun> m_runs;
+    u64 m_last_eviction_frame{};
+};
+
+}
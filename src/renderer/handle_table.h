@@ -0,0 +1,106 @@
+// Copyright (c) 2023, Roni Juppi <roni.juppi@gmail.com>
+
+#pragma once
+
+#include "def.h"
+#include "utils.h"
+#include "containers/vector.h"
+
+namespace bstr::renderer {
+
+// 32-bit generational handle, the low bits are a slot index and the high bits the generation of the slot.
+// A slot's generation is bumped when its resource is removed, so old ids of the slot stop resolving.
+// Zero is never a valid id.
+struct ResourceId
+{
+    static constexpr u32 INDEX_BITS = 20;
+    static constexpr u32 INDEX_MASK = (1u << INDEX_BITS) - 1;
+    static constexpr u32 GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+
+    u32 value{};
+
+    u32 index() const { return value & INDEX_MASK; }
+    u32 generation() const { return value >> INDEX_BITS; }
+    bool is_valid() const { return value != 0; }
+
+    bool operator==(ResourceId other) const { return value == other.value; }
+    bool operator!=(ResourceId other) const { return value != other.value; }
+};
+
+// Dense table from ids to resources. The table does not own the resources, they add themselves when
+// created and remove themselves when destroyed, so that only the API handles are reference counted.
+template<typename T>
+class HandleTable {
+public:
+    ResourceId insert(T* resource)
+    {
+        ASSERT(resource, "");
+
+        u32 index;
+        if (m_first_free != NO_FREE_SLOT)
+        {
+            index = m_first_free;
+            m_first_free = m_slots[index].next_free;
+        }
+        else
+        {
+            index = (u32)m_slots.size();
+            ASSERT(index <= ResourceId::INDEX_MASK, "handle table is full");
+            m_slots.emplace_back();
+        }
+
+        Slot& slot = m_slots[index];
+        slot.resource = resource;
+        slot.next_free = NO_FREE_SLOT;
+        m_count += 1;
+
+        ResourceId result = { (slot.generation << ResourceId::INDEX_BITS) | index };
+        return result;
+    }
+
+    void remove(ResourceId id)
+    {
+        ASSERT(get(id), "removing a stale resource id");
+
+        Slot& slot = m_slots[id.index()];
+        slot.resource = nullptr;
+        // Generation 0 is skipped so that no id is ever 0
+        slot.generation = (slot.generation + 1) & ResourceId::GENERATION_MASK;
+        if (slot.generation == 0)
+        {
+            slot.generation = 1;
+        }
+        slot.next_free = m_first_free;
+        m_first_free = id.index();
+        m_count -= 1;
+    }
+
+    // Returns nullptr if the resource of the id has been removed
+    T* get(ResourceId id) const
+    {
+        u32 index = id.index();
+        if (index >= m_slots.size() || m_slots[index].generation != id.generation())
+        {
+            return nullptr;
+        }
+        return m_slots[index].resource;
+    }
+
+    usz size() const { return m_count; }
+
+private:
+    static constexpr u32 NO_FREE_SLOT = ~0u;
+
+    struct Slot
+    {
+        T* resource{};
+        u32 generation = 1;
+        u32 next_free = NO_FREE_SLOT;
+    };
+
+    vector<Slot> m_slots;
+    u32 m_first_free = NO_FREE_SLOT;
+    usz m_count{};
+};
+
+}
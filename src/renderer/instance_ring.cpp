@@ -0,0 +1,40 @@
+// Copyright (c) 2023, Roni Juppi <roni.juppi@gmail.com>
+
+#include "instance_ring.h"
+#include "utils.h"
+
+namespace bstr::renderer {
+
+InstanceRingAllocator::InstanceRingAllocator(usz capacity_in_instances, usz instance_stride)
+    : m_capacity(capacity_in_instances)
+    , m_stride(instance_stride)
+{
+    ASSERT(m_stride > 0, "instance stride cannot be zero");
+}
+
+bool InstanceRingAllocator::allocate(usz count, out_ptr<InstanceRingAllocation> out_allocation)
+{
+    if (count == 0 || count > m_capacity)
+    {
+        return false;
+    }
+
+    bool needs_discard = !m_has_been_discarded;
+    if (m_head + count > m_capacity)
+    {
+        // Rest of the buffer might still be in use by the GPU, start over in a fresh buffer
+        m_head = 0;
+        m_wrap_count += 1;
+        needs_discard = true;
+    }
+    m_has_been_discarded = true;
+
+    out_allocation->first_instance = m_head;
+    out_allocation->byte_offset = m_head * m_stride;
+    out_allocation->needs_discard = needs_discard;
+
+    m_head += count;
+    return true;
+}
+
+}
@@ -0,0 +1,44 @@
+// Copyright (c) 2023, Roni Juppi <roni.juppi@gmail.com>
+
+#pragma once
+
+#include "def.h"
+#include "out_ptr.h"
+
+namespace bstr::renderer {
+
+struct InstanceRingAllocation
+{
+    usz first_instance{}; // Index of the first instance, used as the instance offset of the draw
+    usz byte_offset{};    // Where to write the instance data in the buffer
+    bool needs_discard{}; // Buffer must be mapped with discard (first use or wrapped), otherwise no-overwrite is safe
+};
+
+// Allocates instance data linearly from one large dynamic buffer that is shared by all the batches in a frame.
+// Batches append to the buffer, and only when the buffer runs out we wrap to the beginning and the caller
+// has to discard the buffer so the driver can rename it. All allocations in a ring must have the same stride,
+// so that the byte offset is always a whole instance offset.
+//
+// This does not know anything about the graphics API, the backend maps the buffer according to the allocation.
+class InstanceRingAllocator {
+public:
+    InstanceRingAllocator() = default;
+    InstanceRingAllocator(usz capacity_in_instances, usz instance_stride);
+
+    // Returns false if count does not fit in the buffer at all
+    bool allocate(usz count, out_ptr<InstanceRingAllocation> out_allocation);
+
+    usz capacity() const { return m_capacity; }
+    usz stride() const { return m_stride; }
+    usz head() const { return m_head; }
+    u64 wrap_count() const { return m_wrap_count; }
+
+private:
+    usz m_capacity{};
+    usz m_stride{};
+    usz m_head{};
+    u64 m_wrap_count{};
+    bool m_has_been_discarded{};
+};
+
+}
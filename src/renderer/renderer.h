@@ -3,12 +3,17 @@
 #pragma once
 
 #include "def.h"
+#include "bcn.h"
 #include "containers/string_view.h"
 #include "non_null.h"
 #include "out_ptr.h"
 #include "smart_ptr.h"
 #include "imgui.h"
 
+namespace bstr::core {
+class JobSystem;
+}
+
 namespace bstr::renderer {
 
 struct Color
@@ -22,6 +27,42 @@ struct Rect
     f32 w{}, h{};
 };
 
+enum FontType : u32 {
+    FontType_Bitmap,
+    FontType_SDF, // Signed distance field, one atlas per font file serves every size
+};
+
+// Everything is blended as premultiplied alpha, so both modes use the same blend state and can share a batch
+enum BlendMode : u32 {
+    BlendMode_Alpha,
+    BlendMode_Additive, // The color is added to what is behind it, tint alpha still scales it
+};
+
+struct RendererStats
+{
+    u64 draw_calls{};
+    u64 sprites_submitted{};
+    u64 sprites_culled{}; // Sprites that were outside of the viewport and never uploaded
+    u64 sprite_batches{};
+    u64 instance_bytes_uploaded{}; // Sprite batches and the changed parts of sprite layers
+};
+
+// Textures loaded from files and fonts are shared by every caller that asks for the same file (and size).
+// Hits and misses are counted from the start, the rest are for the resources that are alive.
+struct ResourceCacheStats
+{
+    u64 texture_hits{};
+    u64 texture_misses{};
+    u64 textures_alive{};
+    u64 texture_memory_bytes{};
+
+    u64 font_hits{};
+    u64 font_misses{};
+    u64 fonts_alive{};
+    u64 font_memory_bytes{}; // Font files and glyph atlases
+};
+
+// Backends allocate resources with core::make_pooled, so each resource type lives in a pool of its own
 struct RendererResource {
     RendererResource() = default;
     virtual ~RendererResource() = default;
@@ -36,17 +77,47 @@ struct Texture : RendererResource
 {
     u32 width{};
     u32 height{};
+
+    // Textures loaded asynchronously are drawn with a placeholder, and have its size, until they are loaded
+    bool is_loaded = true;
 };
 
 struct Font : RendererResource
 {
 };
 
+// Sprites that are uploaded once and stay resident on the GPU, e.g. backgrounds and tile layers.
+// All the sprites in a layer use the same texture and are drawn with a single call.
+struct SpriteLayer : RendererResource
+{
+    u32 capacity{};
+};
+
+// Text that is laid out once and can be drawn at any position without laying it out again
+struct TextLayout : RendererResource
+{
+};
+
+struct TextureLoadOptions
+{
+    // The image is encoded when it is first loaded, the image cache keeps the encoded blocks.
+    // The texture keeps the size of the image, only its storage is padded to whole blocks.
+    core::BlockCompression compression = core::BlockCompression_None;
+
+    // Gamma-correct, alpha weighted levels down to 1x1, so that minified textures do not alias
+    bool generate_mips = true;
+
+    // The image cache keeps the pixels zlib compressed, smaller on disk but inflated on every load
+    bool compress_cache = false;
+};
+
 template<typename T>
 using RendererResourceHandle = shared_ptr<T>;
 
 using TextureHandle = RendererResourceHandle<Texture>;
 using FontHandle = RendererResourceHandle<Font>;
+using SpriteLayerHandle = RendererResourceHandle<SpriteLayer>;
+using TextLayoutHandle = RendererResourceHandle<TextLayout>;
 
 class Renderer {
 public:
@@ -59,17 +130,46 @@ public:
     Renderer &operator=(Renderer&&) = delete;
 
     virtual void begin_frame(Color clear_color) = 0;
-    virtual void end_frame(bool use_vsync, out_ptr<u64> out_draw_calls) = 0;
+    virtual void end_frame(bool use_vsync, out_ptr<RendererStats> out_stats) = 0;
+    virtual void get_resource_cache_stats(out_ptr<ResourceCacheStats> out_stats) = 0;
 
+    // Pixels have premultiplied alpha, e.g. from core::premultiply_alpha. Textures loaded from files are premultiplied when loaded.
     virtual TextureHandle create_texture(non_null<u32> pixels, u32 width, u32 height) = 0;
-    virtual TextureHandle create_texture_from_file(non_null<const char> filename) = 0;
-    virtual FontHandle create_font(non_null<const char> font_file, f32 size) = 0;
-
-    virtual void draw_sprite(const TextureHandle &texture, Rect src, Rect dst, Color tint_color = {1,1,1,1}) = 0;
+    // Blocks as encoded by core::encode_block_compressed, mip_count levels one after another.
+    // width and height are the size of the image, the blocks cover core::get_block_padded_dimension of it and
+    // the mip levels are made from the padded size. The texture has the size of the image.
+    // Devices that cannot sample the format get the blocks decoded on the CPU.
+    virtual TextureHandle create_texture_compressed(
+        core::BlockCompression compression, non_null<const u8> blocks, u32 width, u32 height, u32 mip_count = 1) = 0;
+    // Files that cannot be loaded give a white texture, the same that placeholders are drawn with
+    virtual TextureHandle create_texture_from_file(non_null<const char> filename, const TextureLoadOptions& options = {}) = 0;
+    // Returns a placeholder texture at once. The file is decoded on a worker thread and uploaded at the start
+    // of a later frame, a few at a time, so loading does not stall the frame. A file that cannot be loaded
+    // leaves the placeholder white.
+    virtual TextureHandle create_texture_from_file_async(non_null<const char> filename, const TextureLoadOptions& options = {}) = 0;
+    virtual FontHandle create_font(non_null<const char> font_file, f32 size, FontType type = FontType_Bitmap) = 0;
+
+    // The tint is straight alpha, it is premultiplied when the sprite is queued
+    virtual void draw_sprite(
+        const TextureHandle &texture, Rect src, Rect dst, Color tint_color = {1,1,1,1}, BlendMode blend_mode = BlendMode_Alpha) = 0;
     virtual void draw_text(const FontHandle &font, string_view text, f32 x, f32 y, Color tint_color = {1,1,1,1}) = 0;
+
+    // For text the caller knows is static. draw_text caches recently drawn text too,
+    // but a layout is never evicted and does not need to be looked up.
+    virtual TextLayoutHandle create_text_layout(const FontHandle &font, string_view text, Color tint_color = {1,1,1,1}) = 0;
+    virtual void draw_text_layout(const TextLayoutHandle &layout, f32 x, f32 y) = 0;
+
+    // Only the sprites changed with set_layer_sprite since the last draw are re-uploaded.
+    // The offset is added to dst of every sprite in the layer, e.g. to scroll it with a camera.
+    virtual SpriteLayerHandle create_sprite_layer(const TextureHandle &texture, u32 capacity) = 0;
+    virtual void set_layer_sprite(
+        const SpriteLayerHandle &layer, u32 index, Rect src, Rect dst, Color tint_color = {1,1,1,1}, BlendMode blend_mode = BlendMode_Alpha) = 0;
+    virtual void draw_sprite_layer(const SpriteLayerHandle &layer, f32 offset_x, f32 offset_y) = 0;
 };
 
-::bstr::core::unique_ptr<Renderer> create_renderer();
+// Files are decoded with jobs of the job system, which has to outlive the renderer.
+// Every handle the renderer returns has to be released before the renderer is destroyed.
+::bstr::core::unique_ptr<Renderer> create_renderer(non_null<core::JobSystem> job_system);
 
 }
 
@@ -1,10 +1,28 @@
 // Copyright (c) 2021-2023, Roni Juppi <roni.juppi@gmail.com>
 
 #include "renderer.h"
+#include "sprite_batch.h"
+#include "instance_ring.h"
+#include "glyph_run_cache.h"
+#include "glyph_atlas.h"
+#include "sdf.h"
+#include "texture_loader.h"
+#include "resource_cache.h"
+#include "handle_table.h"
 #include "platform.h"
 #include "utils.h"
+#include "utf8.h"
+#include "image.h"
+#include "pool.h"
+#include "profiler.h"
+#include "string_id.h"
+#include "string_builder.h"
 #include "containers/common.h"
 #include "containers/list.h"
+#include "containers/small_vector.h"
+
+#include <algorithm>
+#include <cmath>
 
 #pragma warning(push, 0)
 #define STB_IMAGE_IMPLEMENTATION
@@ -71,41 +89,66 @@ struct D3D11_ShaderData : public RendererResource
     }
 };
 
+// How the pixel shader interprets the texture, keep in sync with shader.hlsl
+enum SampleMode : u32 {
+    SampleMode_Color = 0,
+    SampleMode_DistanceField = 1,
+    SampleMode_Coverage = 2, // One channel alpha, e.g. bitmap font atlases
+};
+
+class D3D11_Renderer;
+
 struct D3D11_Texture : public Texture
 {
     D3D11_Texture() = default;
+    ~D3D11_Texture();
 
-    ~D3D11_Texture()
-    {
-        if (sampler_state) sampler_state->Release();
-        if (texture) texture->Release();
-        if (texture_view) texture_view->Release();
-    }
+    // Batches refer to the texture by id, the renderer is told when the texture goes away
+    D3D11_Renderer* renderer{};
+    ResourceId id{};
 
     ID3D11SamplerState* sampler_state{};
     ID3D11Texture2D* texture{};
     ID3D11ShaderResourceView* texture_view{};
+    // Size of the D3D texture, which sprite source rects are scaled by. Block compressed textures
+    // are padded to whole blocks, so this can be larger than the size of the texture.
+    u32 allocated_width{};
+    u32 allocated_height{};
+
+    u32 sample_mode = SampleMode_Color;
+    usz memory_bytes{};
 };
 
-struct D3D11_Font : public Font
+// Font file and the atlas its glyphs are rasterized to. Bitmap fonts have a face of their own,
+// SDF fonts of the same file share one face and atlas for every size.
+struct D3D11_FontFace
 {
+    FontType type{};
+
+    // Glyphs are rasterized on demand, so the font file is kept in memory
+    vector<u8> font_data;
+    stbtt_fontinfo font_info{};
+    f32 raster_scale{};
+
+    GlyphAtlas glyphs;
     shared_ptr<D3D11_Texture> atlas{};
+};
 
-    vector<stbtt_packedchar> packed_chars;
-    u32 num_chars{};
-    u32 first_char{};
-    u32 last_char{};
+struct D3D11_Font : public Font
+{
+    D3D11_Font() = default;
+    ~D3D11_Font();
+
+    D3D11_Renderer* renderer{};
+    ResourceId id{}; // Also keys cached glyph runs
+
+    shared_ptr<D3D11_FontFace> face{};
+    f32 scale{};
 
     f32 ascent{};
     f32 descent{};
     f32 line_gap{};
 
-    u32 char_index(u32 character)
-    {
-        u32 result = character - first_char;
-        return result;
-    }
-
     f32 y_advance()
     {
         f32 result = ascent - descent + line_gap;
@@ -113,26 +156,94 @@ struct D3D11_Font : public Font
     }
 };
 
-struct SpriteDrawCmd
-{
-    Rect src{};
-    Rect dst{};
-    Color color{};
-};
-
 struct D3D11_SpriteBatch
 {
-    shared_ptr<D3D11_Texture> texture{};
+    ResourceId texture_id{};
     vector<SpriteDrawCmd> sprite_commands;
 
     bool is_valid()
     {
-        bool result = !(sprite_commands.empty() && texture == nullptr);
+        bool result = !(sprite_commands.empty() && !texture_id.is_valid());
         return result;
     }
 };
 
 
+// Sprites set apart from each other are uploaded in separate copies up to this many, past it in one span
+static constexpr u32 SPRITE_LAYER_MAX_DIRTY_RANGES = 8;
+
+struct D3D11_SpriteLayer : public SpriteLayer
+{
+    D3D11_SpriteLayer() = default;
+
+    ~D3D11_SpriteLayer()
+    {
+        if (instance_buffer) instance_buffer->Release();
+    }
+
+    shared_ptr<D3D11_Texture> texture{};
+
+    // Half-open range of sprite indices
+    struct SpriteRange
+    {
+        u32 begin{};
+        u32 end{};
+    };
+
+    // CPU copy of the instance data, the dirty ranges of it are uploaded on the next draw
+    vector<SpriteDrawCmd> sprites;
+    u32 used_count{};
+    // Sorted and apart from each other. A sprite that would need one range too many merges them all into one span.
+    small_vector<SpriteRange, SPRITE_LAYER_MAX_DIRTY_RANGES> dirty_ranges;
+
+    ID3D11Buffer* instance_buffer{};
+
+    void mark_dirty(u32 index)
+    {
+        // The first range that ends at or after the index, it either contains or touches the index or comes after it
+        usz i = 0;
+        while (i < dirty_ranges.size() && dirty_ranges[i].end < index)
+        {
+            ++i;
+        }
+
+        if (i < dirty_ranges.size() && dirty_ranges[i].begin <= index + 1)
+        {
+            SpriteRange& range = dirty_ranges[i];
+            range.begin = min(range.begin, index);
+            range.end = max(range.end, index + 1);
+            // The index may have been the gap to the next range
+            if (i + 1 < dirty_ranges.size() && dirty_ranges[i + 1].begin == range.end)
+            {
+                range.end = dirty_ranges[i + 1].end;
+                dirty_ranges.erase(&dirty_ranges[i + 1]);
+            }
+            return;
+        }
+
+        if (dirty_ranges.size() == SPRITE_LAYER_MAX_DIRTY_RANGES)
+        {
+            SpriteRange span = { min(dirty_ranges.front().begin, index), max(dirty_ranges.back().end, index + 1) };
+            dirty_ranges.clear();
+            dirty_ranges.push_back(span);
+            return;
+        }
+
+        dirty_ranges.push_back({});
+        for (usz j = dirty_ranges.size() - 1; j > i; --j)
+        {
+            dirty_ranges[j] = dirty_ranges[j - 1];
+        }
+        dirty_ranges[i] = { index, index + 1 };
+    }
+};
+
+struct D3D11_TextLayout : public TextLayout
+{
+    shared_ptr<D3D11_Font> font{};
+    GlyphRun run;
+};
+
 class D3D11_RendererState;
 
 class D3D11_Renderer : public Renderer {
@@ -140,18 +251,51 @@ public:
     ~D3D11_Renderer();
 
     void begin_frame(Color clear_color) override;
-    void end_frame(bool use_vsync, out_ptr<u64> out_draw_calls) override;
+    void end_frame(bool use_vsync, out_ptr<RendererStats> out_stats) override;
+    void get_resource_cache_stats(out_ptr<ResourceCacheStats> out_stats) override;
 
     TextureHandle create_texture(non_null<u32> pixels, u32 width, u32 height) override;
-    TextureHandle create_texture_from_file(non_null<const char> filename) override;
-    FontHandle create_font(const char* font_file, f32 size) override;
-
-    void draw_sprite(const TextureHandle& texture, Rect src, Rect dst, Color tint_color) override;
+    shared_ptr<D3D11_Texture> make_texture();
+    void release_texture(ResourceId id);
+    shared_ptr<D3D11_Texture> create_d3d11_texture(
+        const void* pixels, u32 width, u32 height, DXGI_FORMAT format, bool is_dynamic, u32 mip_count = 1);
+    TextureHandle create_texture_compressed(
+        BlockCompression compression, non_null<const u8> blocks, u32 width, u32 height, u32 mip_count) override;
+    TextureHandle create_texture_from_file(non_null<const char> filename, const TextureLoadOptions& options) override;
+    TextureHandle create_texture_from_file_async(non_null<const char> filename, const TextureLoadOptions& options) override;
+    shared_ptr<D3D11_Texture> create_texture_from_image(const DecodedImage& image);
+    StringId get_resource_id(const char* filename);
+    void upload_loaded_textures();
+    FontHandle create_font(const char* font_file, f32 size, FontType type) override;
+    shared_ptr<D3D11_Font> make_font();
+    void release_font(ResourceId id);
+    shared_ptr<D3D11_FontFace> create_font_face(const char* font_file, FontType type, f32 size);
+
+    void draw_sprite(const TextureHandle& texture, Rect src, Rect dst, Color tint_color, BlendMode blend_mode) override;
     void draw_text(const FontHandle& font, string_view text, f32 x, f32 y, Color tint_color) override;
 
+    SpriteLayerHandle create_sprite_layer(const TextureHandle& texture, u32 capacity) override;
+    void set_layer_sprite(const SpriteLayerHandle& layer, u32 index, Rect src, Rect dst, Color tint_color, BlendMode blend_mode) override;
+    void draw_sprite_layer(const SpriteLayerHandle& layer, f32 offset_x, f32 offset_y) override;
+
+    TextLayoutHandle create_text_layout(const FontHandle& font, string_view text, Color tint_color) override;
+    void draw_text_layout(const TextLayoutHandle& layout, f32 x, f32 y) override;
+
+    void flush_sprite_batch();
     void end_sprite_batch(D3D11_SpriteBatch& sprite_batch);
-    TextureHandle create_font_texture(non_null<u8> pixels, u32 width, u32 height);
-    void draw_glyph_and_advance(const shared_ptr<D3D11_Font> &font, u32 glyph, f32* x, f32* y, Color tint_color);
+    void draw_instances(
+        D3D11_Texture* texture,
+        ID3D11Buffer* instance_buffer,
+        u32 start_instance, u32 instance_count,
+        f32 offset_x, f32 offset_y);
+    shared_ptr<D3D11_Texture> create_font_texture(non_null<u8> pixels, u32 width, u32 height);
+    void update_font_texture(D3D11_FontFace& face);
+    const AtlasGlyph* get_glyph(D3D11_FontFace& face, u32 codepoint);
+    D3D11_SpriteBatch& begin_sprite_batch(ResourceId texture_id, usz sprite_count);
+    void layout_glyph_and_advance(D3D11_Font& font, u32 codepoint, f32* x, f32* y, GlyphRun* run);
+    void layout_text(D3D11_Font& font, GlyphRun* run);
+    void prepare_glyph_run(D3D11_Font& font, GlyphRun* run, bool needs_layout);
+    void draw_glyph_run(D3D11_Font& font, span<const SpriteDrawCmd> sprites, f32 x, f32 y);
     
     
     shared_ptr<D3D11_ShaderData> create_shader(
@@ -161,6 +305,10 @@ public:
         D3D_SHADER_MACRO const* defines);
 
 public:
+    // Declared first, so that they outlive the members below that hold resources
+    HandleTable<D3D11_Texture> m_textures;
+    HandleTable<D3D11_Font> m_fonts;
+
     HDC m_hdc{};
     HINSTANCE m_hinstance{};
     HWND m_hwnd{};
@@ -170,14 +318,41 @@ public:
     IDXGISwapChain* m_swap_chain{};
 
     D3D11_SpriteBatch m_current_sprite_batch;
+    GlyphRunCache m_glyph_run_cache;
+
+    u64 m_frame_index{};
+    // Set once the destructor has destroyed the resources the renderer holds itself
+    bool m_is_shutting_down{};
+
+    // DXGI_FORMAT_R8_UNORM when the device can sample it, otherwise font atlases are expanded to RGBA
+    DXGI_FORMAT m_font_atlas_format = DXGI_FORMAT_R8_UNORM;
+    // Bit for each BlockCompression the device can sample
+    u32 m_supported_block_compressions{};
+    // Keyed by the id of the canonical path, textures also by load options and fonts by size and type
+    ResourceCache<D3D11_Texture> m_texture_cache;
+    ResourceCache<D3D11_Font> m_font_cache;
+    ResourceCache<D3D11_FontFace> m_sdf_font_faces;
+    // Id of each file name as passed in to the id of its canonical path, so the path is only resolved once
+    hash_map<StringId, StringId> m_resource_ids;
 
     u32 m_window_width{};
     u32 m_window_height{};
 
-    u64 m_draw_calls_in_frame{};
+    RendererStats m_stats_in_frame{};
 
     TextureHandle m_white_texture{};
 
+    // Declared before the loader, whose workers use it
+    unique_ptr<ImageCache> m_image_cache;
+    unique_ptr<TextureLoader> m_texture_loader;
+    struct LoadingTexture
+    {
+        weak_ptr<D3D11_Texture> placeholder;
+        StringId cache_key{};
+    };
+    // Placeholders waiting for their file to be decoded, by loader request id
+    hash_map<u64, LoadingTexture> m_loading_textures;
+
     ID3D11RenderTargetView* m_render_target_view{};
     ID3D11RasterizerState* m_rasterizer_state{};
 
@@ -194,8 +369,23 @@ public:
     ID3D11Buffer* m_per_vertex_buffer{};
     ID3D11Buffer* m_per_instance_buffer{};
     ID3D11Buffer* m_index_buffer{};
+
+    InstanceRingAllocator m_instance_ring{};
 };
 
+D3D11_Texture::~D3D11_Texture()
+{
+    if (renderer) renderer->release_texture(id);
+    if (sampler_state) sampler_state->Release();
+    if (texture) texture->Release();
+    if (texture_view) texture_view->Release();
+}
+
+D3D11_Font::~D3D11_Font()
+{
+    if (renderer) renderer->release_font(id);
+}
+
 struct VertexData
 {
     f32 x{}, y{};
@@ -208,9 +398,14 @@ struct InstanceData
     f32 src_rect[4]{};
     f32 dst_rect[4]{};
 };
-
-// We allocate one large buffer for vertices needed in drawing. We cannot have more draw
-// commands in a batch than can fit into that buffer.
+// Sprite commands are copied to the instance buffer without conversion
+static_assert(sizeof(InstanceData) == sizeof(SpriteDrawCmd), "InstanceData and SpriteDrawCmd layouts differ");
+static_assert(offsetof(InstanceData, color) == offsetof(SpriteDrawCmd, color), "InstanceData and SpriteDrawCmd layouts differ");
+static_assert(offsetof(InstanceData, src_rect) == offsetof(SpriteDrawCmd, src), "InstanceData and SpriteDrawCmd layouts differ");
+static_assert(offsetof(InstanceData, dst_rect) == offsetof(SpriteDrawCmd, dst), "InstanceData and SpriteDrawCmd layouts differ");
+
+// We allocate one large buffer for vertices needed in drawing. All the batches in a frame are appended into
+// it as a ring (see InstanceRingAllocator). We cannot have more draw commands in a batch than can fit into that buffer.
 // For 6*MiB buffer we can have 131072 commands per sprite batch assuming sizeof(InstanceData) is 48
 static constexpr usz MAX_COMMANDS_PER_SPRITE_BATCH = ((6 * MiB) / sizeof(InstanceData));
 static_assert(sizeof(InstanceData) == 48); // This is an assumption in the comment above
@@ -221,6 +416,9 @@ struct ShaderConstants
     f32 window_size_y{};
     f32 texture_size_x{};
     f32 texture_size_y{};
+    f32 offset_x{};
+    f32 offset_y{};
+    u32 sample_mode{};
 };
 
 
@@ -293,7 +491,7 @@ shared_ptr<D3D11_ShaderData> D3D11_Renderer::create_shader(
         }
     }
 
-    result = make_shared<D3D11_ShaderData>();
+    result = make_pooled<D3D11_ShaderData>();
 
     if (vs_blob)
     {
@@ -346,7 +544,11 @@ static string make_shader_filename(const char *shader_name)
 
 void D3D11_Renderer::begin_frame(Color clear_color)
 {
-    m_draw_calls_in_frame = 0;
+    PROFILE_SCOPE("Renderer::begin_frame");
+    m_stats_in_frame = {};
+    m_frame_index += 1;
+    m_glyph_run_cache.evict_unused(m_frame_index);
+    upload_loaded_textures();
 
     ImGui_ImplDX11_NewFrame();
 
@@ -393,37 +595,64 @@ void D3D11_Renderer::begin_frame(Color clear_color)
 
 void D3D11_Renderer::end_sprite_batch(D3D11_SpriteBatch& sprite_batch)
 {
+    PROFILE_SCOPE("Renderer::end_sprite_batch");
     ASSERT(sprite_batch.is_valid(), "");
 
-    shared_ptr<D3D11_Texture> texture = sprite_batch.texture;
+    D3D11_Texture* texture = m_textures.get(sprite_batch.texture_id);
+    ASSERT(texture, "textures flush their batch before they are released");
+
+    // Drop the sprites that are completely outside of the window before they are uploaded
+    usz submitted_count = sprite_batch.sprite_commands.size();
+    Rect viewport = { 0, 0, (f32)m_window_width, (f32)m_window_height };
+    usz visible_count = cull_sprite_commands(sprite_batch.sprite_commands.data(), submitted_count, viewport);
+    sprite_batch.sprite_commands.resize(visible_count);
+
+    m_stats_in_frame.sprites_submitted += submitted_count;
+    m_stats_in_frame.sprites_culled += submitted_count - visible_count;
+
+    if (visible_count == 0)
+    {
+        return;
+    }
 
     // Set instance buffer data
+    InstanceRingAllocation instance_allocation;
     {
+        bool allocated = m_instance_ring.allocate(sprite_batch.sprite_commands.size(), &instance_allocation);
+        ASSERT(allocated, "sprite batch does not fit into the instance buffer");
+
+        D3D11_MAP map_type = instance_allocation.needs_discard
+            ? D3D11_MAP_WRITE_DISCARD
+            : D3D11_MAP_WRITE_NO_OVERWRITE;
         D3D11_MAPPED_SUBRESOURCE mapped_subresource;
         m_device_context->Map(
-            (ID3D11Resource*)m_per_instance_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_subresource);
-        InstanceData* instance_datas = (InstanceData*)mapped_subresource.pData;
-
-        for (usz cmd_idx = 0; cmd_idx < sprite_batch.sprite_commands.size(); ++cmd_idx)
-        {
-            auto& sprite_cmd = sprite_batch.sprite_commands[cmd_idx];
-            InstanceData& instance = *(instance_datas + cmd_idx);
-
-            instance.color[0] = sprite_cmd.color.r;
-            instance.color[1] = sprite_cmd.color.g;
-            instance.color[2] = sprite_cmd.color.b;
-            instance.color[3] = sprite_cmd.color.a;
-            instance.src_rect[0] = sprite_cmd.src.x;
-            instance.src_rect[1] = sprite_cmd.src.y;
-            instance.src_rect[2] = sprite_cmd.src.w;
-            instance.src_rect[3] = sprite_cmd.src.h;
-            instance.dst_rect[0] = sprite_cmd.dst.x;
-            instance.dst_rect[1] = sprite_cmd.dst.y;
-            instance.dst_rect[2] = sprite_cmd.dst.w;
-            instance.dst_rect[3] = sprite_cmd.dst.h;
-        }
+            (ID3D11Resource*)m_per_instance_buffer, 0, map_type, 0, &mapped_subresource);
+        copy_sprite_commands(
+            (SpriteDrawCmd*)((u8*)mapped_subresource.pData + instance_allocation.byte_offset),
+            sprite_batch.sprite_commands.data(),
+            sprite_batch.sprite_commands.size());
 
         m_device_context->Unmap((ID3D11Resource*)m_per_instance_buffer, 0);
+        m_stats_in_frame.instance_bytes_uploaded += sprite_batch.sprite_commands.size() * sizeof(InstanceData);
+    }
+    m_stats_in_frame.sprite_batches += 1;
+
+    draw_instances(
+        texture,
+        m_per_instance_buffer,
+        (u32)instance_allocation.first_instance, (u32)sprite_batch.sprite_commands.size(),
+        0, 0);
+}
+
+void D3D11_Renderer::draw_instances(
+    D3D11_Texture* texture,
+    ID3D11Buffer* instance_buffer,
+    u32 start_instance, u32 instance_count,
+    f32 offset_x, f32 offset_y)
+{
+    if (!texture->is_loaded)
+    {
+        texture = (D3D11_Texture*)m_white_texture.get();
     }
 
     m_device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
@@ -431,7 +660,7 @@ void D3D11_Renderer::end_sprite_batch(D3D11_SpriteBatch& sprite_batch)
 
     u32 vertex_offsets[2] = { 0, 0 };
     u32 vertex_strides[2] = { sizeof(VertexData), sizeof(InstanceData) };
-    ID3D11Buffer* vertex_buffers[2] = { m_per_vertex_buffer, m_per_instance_buffer };
+    ID3D11Buffer* vertex_buffers[2] = { m_per_vertex_buffer, instance_buffer };
     m_device_context->IASetVertexBuffers(
         0,
         2,
@@ -451,8 +680,11 @@ void D3D11_Renderer::end_sprite_batch(D3D11_SpriteBatch& sprite_batch)
         ShaderConstants* shader_constants = (ShaderConstants*)mapped_subresource.pData;
         shader_constants->window_size_x = (f32)m_window_width;
         shader_constants->window_size_y = (f32)m_window_height;
-        shader_constants->texture_size_x = (f32)texture->width;
-        shader_constants->texture_size_y = (f32)texture->height;
+        shader_constants->texture_size_x = (f32)texture->allocated_width;
+        shader_constants->texture_size_y = (f32)texture->allocated_height;
+        shader_constants->offset_x = offset_x;
+        shader_constants->offset_y = offset_y;
+        shader_constants->sample_mode = texture->sample_mode;
 
         m_device_context->Unmap(
             (ID3D11Resource*)m_constant_buffer, 0);
@@ -473,38 +705,157 @@ void D3D11_Renderer::end_sprite_batch(D3D11_SpriteBatch& sprite_batch)
         0, 1, &texture->sampler_state);
 
     u32 index_count = 6;
-    u32 instance_count = (u32)sprite_batch.sprite_commands.size();
     m_device_context->DrawIndexedInstanced(
         index_count, instance_count,
-        0, 0, 0);
+        0, 0, start_instance);
 
-    m_draw_calls_in_frame += 1;
+    m_stats_in_frame.draw_calls += 1;
 }
 
-void D3D11_Renderer::end_frame(bool use_vsync, u64* out_draw_calls)
+void D3D11_Renderer::flush_sprite_batch()
 {
     if (m_current_sprite_batch.is_valid()) {
         end_sprite_batch(m_current_sprite_batch);
-        m_current_sprite_batch.texture = nullptr;
+        m_current_sprite_batch.texture_id = {};
         m_current_sprite_batch.sprite_commands.clear();
     }
+}
+
+void D3D11_Renderer::end_frame(bool use_vsync, out_ptr<RendererStats> out_stats)
+{
+    flush_sprite_batch();
 
     ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 
     UINT sync_interval = 0;
     m_swap_chain->Present(sync_interval, 0);
-    *out_draw_calls = m_draw_calls_in_frame;
+    *out_stats = m_stats_in_frame;
+}
+
+void D3D11_Renderer::get_resource_cache_stats(out_ptr<ResourceCacheStats> out_stats)
+{
+    ResourceCacheStats stats = {};
+    stats.texture_hits = m_texture_cache.hits();
+    stats.texture_misses = m_texture_cache.misses();
+    m_texture_cache.for_each_alive([&](const D3D11_Texture& texture) {
+        stats.textures_alive += 1;
+        stats.texture_memory_bytes += texture.memory_bytes;
+    });
+
+    // SDF fonts of different sizes share a face, count each face once
+    small_vector<const D3D11_FontFace*, 16> counted_faces;
+    stats.font_hits = m_font_cache.hits();
+    stats.font_misses = m_font_cache.misses();
+    m_font_cache.for_each_alive([&](const D3D11_Font& font) {
+        stats.fonts_alive += 1;
+        const D3D11_FontFace* face = font.face.get();
+        if (std::find(counted_faces.begin(), counted_faces.end(), face) == counted_faces.end())
+        {
+            counted_faces.push_back(face);
+            stats.font_memory_bytes += face->font_data.size() + face->atlas->memory_bytes;
+        }
+    });
+
+    *out_stats = stats;
+}
+
+shared_ptr<D3D11_Texture> D3D11_Renderer::make_texture()
+{
+    auto result = make_pooled<D3D11_Texture>();
+    result->renderer = this;
+    result->id = m_textures.insert(result.get());
+    return result;
+}
+
+void D3D11_Renderer::release_texture(ResourceId id)
+{
+    // The handle table goes away with the renderer
+    if (m_is_shutting_down)
+    {
+        return;
+    }
+    // Queued sprites may still use the texture
+    if (m_current_sprite_batch.texture_id == id)
+    {
+        flush_sprite_batch();
+    }
+    m_textures.remove(id);
+}
+
+shared_ptr<D3D11_Font> D3D11_Renderer::make_font()
+{
+    auto result = make_pooled<D3D11_Font>();
+    result->renderer = this;
+    result->id = m_fonts.insert(result.get());
+    return result;
+}
+
+void D3D11_Renderer::release_font(ResourceId id)
+{
+    m_fonts.remove(id);
 }
 
 TextureHandle D3D11_Renderer::create_texture(u32* pixels, u32 width, u32 height)
+{
+    bool is_dynamic = false;
+    auto result = create_d3d11_texture(pixels, width, height, DXGI_FORMAT_R8G8B8A8_UNORM, is_dynamic);
+    return result;
+}
+
+static DXGI_FORMAT get_block_compressed_format(BlockCompression compression)
+{
+    switch (compression)
+    {
+    case BlockCompression_BC1: return DXGI_FORMAT_BC1_UNORM;
+    case BlockCompression_BC3: return DXGI_FORMAT_BC3_UNORM;
+    case BlockCompression_BC7: return DXGI_FORMAT_BC7_UNORM;
+    default: break;
+    }
+    ASSERT_UNREACHED();
+    return DXGI_FORMAT_UNKNOWN;
+}
+
+// Block compressed formats are laid out in rows of 4x4 blocks
+static void get_texture_pitch(DXGI_FORMAT format, u32 width, u32 height, out_ptr<u32> out_row_pitch, out_ptr<u32> out_row_count)
+{
+    switch (format)
+    {
+    case DXGI_FORMAT_R8_UNORM:
+        *out_row_pitch = width;
+        *out_row_count = height;
+        return;
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+        *out_row_pitch = width * 4;
+        *out_row_count = height;
+        return;
+    case DXGI_FORMAT_BC1_UNORM:
+        *out_row_pitch = (width + 3) / 4 * 8;
+        *out_row_count = (height + 3) / 4;
+        return;
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC7_UNORM:
+        *out_row_pitch = (width + 3) / 4 * 16;
+        *out_row_count = (height + 3) / 4;
+        return;
+    default:
+        break;
+    }
+    ASSERT(false, "unsupported texture format");
+}
+
+// pixels has mip_count levels one after another
+shared_ptr<D3D11_Texture> D3D11_Renderer::create_d3d11_texture(
+    const void* pixels, u32 width, u32 height, DXGI_FORMAT format, bool is_dynamic, u32 mip_count)
 {
     HRESULT hr;
 
-    auto tex_ptr = make_shared<D3D11_Texture>();
+    auto tex_ptr = make_texture();
     auto& tex = *tex_ptr;
     
     tex.width = width;
     tex.height = height;
+    tex.allocated_width = width;
+    tex.allocated_height = height;
 
     D3D11_SAMPLER_DESC sampler_desc = {};
     sampler_desc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
@@ -518,19 +869,30 @@ TextureHandle D3D11_Renderer::create_texture(u32* pixels, u32 width, u32 height)
     D3D11_TEXTURE2D_DESC texture_desc = {0};
     texture_desc.Width = width;
     texture_desc.Height = height;
-    texture_desc.MipLevels = 1;
+    texture_desc.MipLevels = mip_count;
     texture_desc.ArraySize = 1;
-    texture_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    texture_desc.Format = format;
     texture_desc.SampleDesc.Count = 1;
-    texture_desc.Usage = D3D11_USAGE_IMMUTABLE;
+    // Dynamic textures are updated in parts with UpdateSubresource
+    texture_desc.Usage = is_dynamic ? D3D11_USAGE_DEFAULT : D3D11_USAGE_IMMUTABLE;
     texture_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 
-    D3D11_SUBRESOURCE_DATA texture_subresource_data = {0};
-    texture_subresource_data.pSysMem = pixels;
-    texture_subresource_data.SysMemPitch = width * sizeof(*pixels);
+    ASSERT(mip_count <= D3D11_REQ_MIP_LEVELS, "too many mip levels");
+    D3D11_SUBRESOURCE_DATA subresource_data[D3D11_REQ_MIP_LEVELS] = {};
+    const u8* level_pixels = (const u8*)pixels;
+    tex.memory_bytes = 0;
+    for (u32 level = 0; level < mip_count; ++level)
+    {
+        u32 row_pitch = 0, row_count = 0;
+        get_texture_pitch(format, get_mip_dimension(width, level), get_mip_dimension(height, level), &row_pitch, &row_count);
+        subresource_data[level].pSysMem = level_pixels;
+        subresource_data[level].SysMemPitch = row_pitch;
+        level_pixels += (usz)row_pitch * row_count;
+        tex.memory_bytes += (usz)row_pitch * row_count;
+    }
 
     hr = m_device->CreateTexture2D(
-        &texture_desc, &texture_subresource_data, &tex.texture);
+        &texture_desc, subresource_data, &tex.texture);
     ASSERT_UNCHECKED(SUCCEEDED(hr), "");
 
     hr = m_device->CreateShaderResourceView(
@@ -540,169 +902,579 @@ TextureHandle D3D11_Renderer::create_texture(u32* pixels, u32 width, u32 height)
     return tex_ptr;
 }
 
-TextureHandle D3D11_Renderer::create_texture_from_file(const char* filename)
+// Id of the canonical path of a resource file, or of the name as is if the file does not exist
+StringId D3D11_Renderer::get_resource_id(const char* filename)
 {
-    int req_comps = 4;
-    int width, height, num_comps;
-    u8* pixels = stbi_load(filename, &width, &height, &num_comps, req_comps);
-    TextureHandle result = create_texture((u32*)pixels, width, height);
-    stbi_image_free(pixels);
+    StringId name_id = intern_string(filename);
+    auto it = m_resource_ids.find(name_id);
+    if (it != m_resource_ids.end())
+    {
+        return it->second;
+    }
+
+    string canonical_path = get_canonical_path(filename);
+    StringId result = canonical_path.empty() ? name_id : intern_string(canonical_path);
+    m_resource_ids[name_id] = result;
     return result;
 }
 
-TextureHandle D3D11_Renderer::create_font_texture(non_null<u8> pixels, u32 width, u32 height)
+TextureHandle D3D11_Renderer::create_texture_compressed(
+    BlockCompression compression, non_null<const u8> blocks, u32 width, u32 height, u32 mip_count)
 {
-    usz pixels_len = width * height;
-    vector<u32> gpu_pixels(pixels_len);
+    u32 padded_width = get_block_padded_dimension(compression, width);
+    u32 padded_height = get_block_padded_dimension(compression, height);
+
+    // Only the D3D texture is padded, the texture has the size of the image
+    bool is_dynamic = false;
+    if (m_supported_block_compressions & (1u << compression))
+    {
+        auto result = create_d3d11_texture(
+            blocks, padded_width, padded_height, get_block_compressed_format(compression), is_dynamic, mip_count);
+        result->width = width;
+        result->height = height;
+        return result;
+    }
+
+    vector<u8> pixels(get_mip_chain_size(BlockCompression_None, padded_width, padded_height, mip_count));
+    const u8* level_blocks = blocks;
+    u8* level_pixels = pixels.data();
+    for (u32 level = 0; level < mip_count; ++level)
+    {
+        u32 level_width = get_mip_dimension(padded_width, level);
+        u32 level_height = get_mip_dimension(padded_height, level);
+        if (!decode_block_compressed(compression, level_blocks, level_width, level_height, level_pixels))
+        {
+            LOG_WARN("Texture has blocks that cannot be decoded on the CPU");
+        }
+        level_blocks += block_compressed_size(compression, level_width, level_height);
+        level_pixels += (usz)level_width * level_height * 4;
+    }
+    auto result = create_d3d11_texture(pixels.data(), padded_width, padded_height, DXGI_FORMAT_R8G8B8A8_UNORM, is_dynamic, mip_count);
+    result->width = width;
+    result->height = height;
+    return result;
+}
 
-    u32 r = 0xFF;
-    u32 g = 0xFF;
-    u32 b = 0xFF;
-    for (usz pixel_idx = 0; pixel_idx < pixels_len; ++pixel_idx)
+shared_ptr<D3D11_Texture> D3D11_Renderer::create_texture_from_image(const DecodedImage& image)
+{
+    if (image.compression != BlockCompression_None)
     {
-        u32 a = (u32)pixels[pixel_idx];
-        u32 pixel = (a << 24) | (b << 16) | (g << 8) | (r << 0);
-        gpu_pixels[pixel_idx] = pixel;
+        auto result = static_pointer_cast<D3D11_Texture>(
+            create_texture_compressed(image.compression, image.pixels(), image.width, image.height, image.mip_count));
+        return result;
     }
 
-    auto result = create_texture(gpu_pixels.data(), width, height);
+    bool is_dynamic = false;
+    auto result = create_d3d11_texture(image.pixels(), image.width, image.height, DXGI_FORMAT_R8G8B8A8_UNORM, is_dynamic, image.mip_count);
     return result;
 }
 
-void D3D11_Renderer::draw_sprite(const TextureHandle &texture, Rect src, Rect dst, Color tint_color)
+// The same file loaded with different options are different textures
+static StringId make_texture_key(StringId file_id, const TextureLoadOptions& options)
+{
+    stack_string_builder<32> suffix;
+    suffix.append_format("|{}|{}", (u32)options.compression, options.generate_mips);
+    StringId result = extend_string_id(file_id, suffix.data(), suffix.size());
+    return result;
+}
+
+TextureHandle D3D11_Renderer::create_texture_from_file(const char* filename, const TextureLoadOptions& options)
+{
+    StringId cache_key = make_texture_key(get_resource_id(filename), options);
+    auto cached = m_texture_cache.find(cache_key);
+    if (cached && cached->is_loaded)
+    {
+        return cached;
+    }
+
+    DecodedImage image;
+    if (!decode_image_file(m_image_cache.get(), filename, options, &image))
+    {
+        // Drawn white like a placeholder, and not cached, so a fixed file loads the next time
+        LOG_ERROR("Failed to load texture {}", filename);
+        return m_white_texture;
+    }
+
+    auto result = create_texture_from_image(image);
+    // A texture that is still loading asynchronously stays cached, its handles get the pixels when the decode is done
+    if (!cached)
+    {
+        m_texture_cache.insert(cache_key, result);
+    }
+    return result;
+}
+
+// A file that is still loading is found in the cache too, in which case the placeholder is shared
+TextureHandle D3D11_Renderer::create_texture_from_file_async(non_null<const char> filename, const TextureLoadOptions& options)
+{
+    StringId cache_key = make_texture_key(get_resource_id(filename), options);
+    if (auto cached = m_texture_cache.find(cache_key))
+    {
+        return cached;
+    }
+
+    auto placeholder = make_texture();
+    placeholder->width = m_white_texture->width;
+    placeholder->height = m_white_texture->height;
+    placeholder->is_loaded = false;
+
+    u64 request_id = m_texture_loader->request(filename, options);
+    m_loading_textures[request_id] = { placeholder, cache_key };
+    m_texture_cache.insert(cache_key, placeholder);
+    return placeholder;
+}
+
+// Uploading a large image can take milliseconds, so only this many bytes of decoded images are uploaded per frame.
+// At least one image is uploaded each frame even if it is larger.
+static constexpr usz TEXTURE_UPLOAD_BUDGET_PER_FRAME = 16 * MiB;
+
+void D3D11_Renderer::upload_loaded_textures()
+{
+    usz uploaded_bytes = 0;
+    DecodedImage image;
+    while (uploaded_bytes < TEXTURE_UPLOAD_BUDGET_PER_FRAME && m_texture_loader->take_decoded(&image))
+    {
+        auto it = m_loading_textures.find(image.request_id);
+        ASSERT(it != m_loading_textures.end(), "decoded image was not requested");
+        shared_ptr<D3D11_Texture> placeholder = it->second.placeholder.lock();
+        StringId cache_key = it->second.cache_key;
+        m_loading_textures.erase(it);
+
+        if (!image.pixels())
+        {
+            // The handles keep drawing white. The placeholder is not cached any more, so the next load of the
+            // file tries again. While it is alive the cache key still maps to it, otherwise the key may be a newer load.
+            LOG_ERROR("Failed to load texture {}", image.filename);
+            if (placeholder)
+            {
+                m_texture_cache.erase(cache_key);
+            }
+            continue;
+        }
+        if (!placeholder)
+        {
+            // Every handle was released before the image was decoded
+            continue;
+        }
+
+        auto loaded = create_texture_from_image(image);
+
+        // Handles refer to the placeholder, so it takes over the resources of the loaded texture
+        std::swap(placeholder->sampler_state, loaded->sampler_state);
+        std::swap(placeholder->texture, loaded->texture);
+        std::swap(placeholder->texture_view, loaded->texture_view);
+        placeholder->width = loaded->width;
+        placeholder->height = loaded->height;
+        placeholder->allocated_width = loaded->allocated_width;
+        placeholder->allocated_height = loaded->allocated_height;
+        placeholder->memory_bytes = loaded->memory_bytes;
+        placeholder->is_loaded = true;
+
+        uploaded_bytes += loaded->memory_bytes;
+    }
+}
+
+// Font atlases are 8-bit coverage or distance, which the shader reads from the red channel. Devices that
+// cannot sample R8 get the value replicated to every channel of an RGBA texture.
+shared_ptr<D3D11_Texture> D3D11_Renderer::create_font_texture(non_null<u8> pixels, u32 width, u32 height)
+{
+    bool is_dynamic = true;
+    if (m_font_atlas_format == DXGI_FORMAT_R8_UNORM)
+    {
+        auto result = create_d3d11_texture(pixels, width, height, DXGI_FORMAT_R8_UNORM, is_dynamic);
+        return result;
+    }
+
+    vector<u32> gpu_pixels((usz)width * height);
+    expand_r8_to_rgba8(pixels, gpu_pixels.data(), gpu_pixels.size());
+    auto result = create_d3d11_texture(gpu_pixels.data(), width, height, DXGI_FORMAT_R8G8B8A8_UNORM, is_dynamic);
+    return result;
+}
+
+void D3D11_Renderer::update_font_texture(D3D11_FontFace& face)
+{
+    AtlasRect dirty_rect;
+    if (!face.glyphs.take_dirty_rect(&dirty_rect))
+    {
+        return;
+    }
+
+    // R8 atlases are uploaded straight from the CPU copy
+    const u8* first_pixel = face.glyphs.pixels() + (usz)dirty_rect.y * face.glyphs.stride() + dirty_rect.x;
+    const void* upload_pixels = first_pixel;
+    u32 upload_pitch = face.glyphs.stride();
+
+    vector<u32> gpu_pixels;
+    if (m_font_atlas_format != DXGI_FORMAT_R8_UNORM)
+    {
+        gpu_pixels.resize((usz)dirty_rect.width * dirty_rect.height);
+        for (u32 y = 0; y < dirty_rect.height; ++y)
+        {
+            const u8* row = first_pixel + (usz)y * face.glyphs.stride();
+            expand_r8_to_rgba8(row, gpu_pixels.data() + (usz)y * dirty_rect.width, dirty_rect.width);
+        }
+        upload_pixels = gpu_pixels.data();
+        upload_pitch = dirty_rect.width * sizeof(u32);
+    }
+
+    D3D11_BOX dirty_box = {};
+    dirty_box.left = dirty_rect.x;
+    dirty_box.right = dirty_rect.x + dirty_rect.width;
+    dirty_box.top = dirty_rect.y;
+    dirty_box.bottom = dirty_rect.y + dirty_rect.height;
+    dirty_box.front = 0;
+    dirty_box.back = 1;
+    m_device_context->UpdateSubresource(
+        (ID3D11Resource*)face.atlas->texture, 0, &dirty_box,
+        upload_pixels, upload_pitch, 0);
+}
+
+D3D11_SpriteBatch& D3D11_Renderer::begin_sprite_batch(ResourceId texture_id, usz sprite_count)
 {
     // TODO: More intelligent batching? now it just batches if you draw the same texture multiple times in a row,
     // but maybe sometimes it could batch even if the user doesn't know to do that 
 
     D3D11_SpriteBatch &batch = m_current_sprite_batch;
 
-    auto d3d11_tex = static_pointer_cast<D3D11_Texture>(texture);
-
-    if (batch.texture != d3d11_tex || batch.sprite_commands.size() >= MAX_COMMANDS_PER_SPRITE_BATCH) {
-        if (batch.texture) {
+    if (batch.texture_id != texture_id || batch.sprite_commands.size() + sprite_count > MAX_COMMANDS_PER_SPRITE_BATCH) {
+        if (batch.texture_id.is_valid()) {
             end_sprite_batch(batch);
         }
         batch.sprite_commands.clear();
-        batch.texture = d3d11_tex;
+        batch.texture_id = texture_id;
     }
 
-    ASSERT(batch.sprite_commands.size() + 1 <= MAX_COMMANDS_PER_SPRITE_BATCH, "");
+    ASSERT(batch.sprite_commands.size() + sprite_count <= MAX_COMMANDS_PER_SPRITE_BATCH, "");
+    return batch;
+}
+
+// Textures are premultiplied, and the blend state is ONE, INV_SRC_ALPHA. With zero alpha the color is only added.
+static Color premultiply_tint(Color color, BlendMode blend_mode)
+{
+    Color result = { color.r * color.a, color.g * color.a, color.b * color.a, color.a };
+    if (blend_mode == BlendMode_Additive)
+    {
+        result.a = 0.0f;
+    }
+    return result;
+}
+
+void D3D11_Renderer::draw_sprite(const TextureHandle &texture, Rect src, Rect dst, Color tint_color, BlendMode blend_mode)
+{
+    ASSERT(texture, "drawing a sprite with a null texture handle");
+    // Only the id is needed from the handle, copying it would touch the reference count for every sprite
+    ResourceId texture_id = static_cast<const D3D11_Texture*>(texture.get())->id;
+    D3D11_SpriteBatch &batch = begin_sprite_batch(texture_id, 1);
+
     SpriteDrawCmd& cmd = batch.sprite_commands.emplace_back();
+    cmd.color = premultiply_tint(tint_color, blend_mode);
     cmd.src = src;
     cmd.dst = dst;
-    cmd.color = tint_color;
 }
 
+SpriteLayerHandle D3D11_Renderer::create_sprite_layer(const TextureHandle& texture, u32 capacity)
+{
+    ASSERT(capacity > 0, "sprite layer capacity cannot be zero");
 
-FontHandle D3D11_Renderer::create_font(non_null<const char> font_file, f32 size)
+    HRESULT hr;
+
+    auto layer_ptr = make_pooled<D3D11_SpriteLayer>();
+    auto& layer = *layer_ptr;
+
+    layer.capacity = capacity;
+    layer.texture = static_pointer_cast<D3D11_Texture>(texture);
+    layer.sprites.resize(capacity);
+
+    D3D11_BUFFER_DESC instance_buffer_desc = {};
+    instance_buffer_desc.ByteWidth = (UINT)(sizeof(InstanceData) * capacity);
+    instance_buffer_desc.Usage = D3D11_USAGE_DEFAULT;
+    instance_buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    hr = m_device->CreateBuffer(
+        &instance_buffer_desc,
+        NULL,
+        &layer.instance_buffer);
+    ASSERT_UNCHECKED(SUCCEEDED(hr), "");
+
+    return layer_ptr;
+}
+
+void D3D11_Renderer::set_layer_sprite(const SpriteLayerHandle& layer_, u32 index, Rect src, Rect dst, Color tint_color, BlendMode blend_mode)
 {
-    shared_ptr<D3D11_Font> result;
-    
-    auto font_data = read_entire_file_as_bytes(font_file);
-    ASSERT_UNCHECKED(!font_data.empty(), "");
+    auto layer = static_cast<D3D11_SpriteLayer*>(layer_.get());
+    ASSERT(index < layer->capacity, "sprite layer index out of bounds");
 
-    f32 ascent;
-    f32 descent;
-    f32 line_gap;
-    stbtt_GetScaledFontVMetrics(font_data.data(), 0, size, &ascent, &descent, &line_gap);
+    SpriteDrawCmd& cmd = layer->sprites[index];
+    cmd.color = premultiply_tint(tint_color, blend_mode);
+    cmd.src = src;
+    cmd.dst = dst;
 
-    // ASCII range
-    u32 first_char = 0;
-    u32 last_char = 255;
-    u32 num_chars = last_char - first_char;
+    layer->used_count = max(layer->used_count, index + 1);
+    layer->mark_dirty(index);
+}
 
-    // TODO: Adjust atlas size somehow based on font size etc?
-    u32 width = 512;
-    u32 height = 512;
-    u32 stride = width;
+void D3D11_Renderer::draw_sprite_layer(const SpriteLayerHandle& layer_, f32 offset_x, f32 offset_y)
+{
+    auto layer = static_cast<D3D11_SpriteLayer*>(layer_.get());
+    if (layer->used_count == 0)
+    {
+        return;
+    }
 
-    vector<u8> pixels(width * height);
+    // Keep the draw order, anything queued before the layer has to be drawn before it
+    flush_sprite_batch();
 
-    stbtt_pack_context pc;
-    if (stbtt_PackBegin(&pc, pixels.data(), width, height, stride, 1, 0) != 0)
+    for (const D3D11_SpriteLayer::SpriteRange& range : layer->dirty_ranges)
     {
-        vector<stbtt_packedchar> temp_packed_chars(num_chars);
-        if (stbtt_PackFontRange(&pc, font_data.data(), 0, size, first_char, num_chars, temp_packed_chars.data()) != 0)
-        {
-            result = make_shared<D3D11_Font>();
-           
-            result->packed_chars = move(temp_packed_chars);
+        D3D11_BOX dirty_box = {};
+        dirty_box.left = (UINT)(range.begin * sizeof(InstanceData));
+        dirty_box.right = (UINT)(range.end * sizeof(InstanceData));
+        dirty_box.top = 0;
+        dirty_box.bottom = 1;
+        dirty_box.front = 0;
+        dirty_box.back = 1;
+        m_device_context->UpdateSubresource(
+            (ID3D11Resource*)layer->instance_buffer, 0, &dirty_box,
+            layer->sprites.data() + range.begin, 0, 0);
+        m_stats_in_frame.instance_bytes_uploaded += (range.end - range.begin) * sizeof(InstanceData);
+    }
+    layer->dirty_ranges.clear();
 
-            result->first_char = first_char;
-            result->last_char = last_char;
-            result->num_chars = num_chars;
+    draw_instances(
+        layer->texture.get(),
+        layer->instance_buffer,
+        0, layer->used_count,
+        offset_x, offset_y);
+}
 
-            result->ascent = ascent;
-            result->descent = descent;
-            result->line_gap = line_gap;
+// Font atlases are square and sized to hold about this many glyphs, glyphs past that evict the least recently used ones
+static constexpr u32 FONT_ATLAS_GLYPH_COUNT = 256;
+static constexpr u32 FONT_ATLAS_MIN_SIZE = 256;
+static constexpr u32 FONT_ATLAS_MAX_SIZE = 4096;
+
+static u32 get_font_atlas_size(f32 glyph_pixel_size)
+{
+    // Glyphs are about as large as the pixel height, and a square of them fits sqrt(count) to a side
+    f32 side = glyph_pixel_size * sqrtf((f32)FONT_ATLAS_GLYPH_COUNT);
+    u32 result = (u32)next_power_of_two((uptr)ceilf(side));
+    result = min(max(result, FONT_ATLAS_MIN_SIZE), FONT_ATLAS_MAX_SIZE);
+    return result;
+}
+
+shared_ptr<D3D11_FontFace> D3D11_Renderer::create_font_face(const char* font_file, FontType type, f32 size)
+{
+    auto font_data = read_entire_file_as_bytes(font_file);
+    if (font_data.empty())
+    {
+        LOG_ERROR("Could not read font file {}", font_file);
+        return nullptr;
+    }
+
+    auto face = make_pooled<D3D11_FontFace>();
+    face->type = type;
+    face->font_data = move(font_data);
+
+    int font_offset = stbtt_GetFontOffsetForIndex(face->font_data.data(), 0);
+    if (stbtt_InitFont(&face->font_info, face->font_data.data(), font_offset) == 0)
+    {
+        LOG_ERROR("stbtt_InitFont failed for {}", font_file);
+        return nullptr;
+    }
+
+    f32 raster_pixel_height = type == FontType_SDF ? SDF_RASTER_PIXEL_HEIGHT : size;
+    face->raster_scale = stbtt_ScaleForPixelHeight(&face->font_info, raster_pixel_height);
+
+    // Glyphs are added to the atlas when they are first drawn, and least recently used ones are evicted.
+    // SDF glyphs have the distance field padding around them.
+    f32 glyph_pixel_size = type == FontType_SDF ? raster_pixel_height + 2 * SDF_PADDING : raster_pixel_height;
+    u32 width = get_font_atlas_size(glyph_pixel_size);
+    u32 height = width;
+    face->glyphs = GlyphAtlas(width, height);
+    face->atlas = create_font_texture(face->glyphs.pixels(), width, height);
+    face->atlas->sample_mode = type == FontType_SDF ? SampleMode_DistanceField : SampleMode_Coverage;
+
+    return face;
+}
+
+FontHandle D3D11_Renderer::create_font(non_null<const char> font_file, f32 size, FontType type)
+{
+    StringId file_key = get_resource_id(font_file);
+    stack_string_builder<32> suffix;
+    suffix.append_format("|{}|{}", size, (u32)type);
+    StringId font_key = extend_string_id(file_key, suffix.data(), suffix.size());
+    if (auto cached = m_font_cache.find(font_key))
+    {
+        return cached;
+    }
 
-            result->atlas = static_pointer_cast<D3D11_Texture>(
-                create_font_texture(pixels.data(), width, height));
+    shared_ptr<D3D11_FontFace> face;
+    if (type == FontType_SDF)
+    {
+        face = m_sdf_font_faces.find(file_key);
+    }
+
+    if (!face)
+    {
+        face = create_font_face(font_file, type, size);
+        if (!face)
+        {
+            return nullptr;
         }
-        else
+        if (type == FontType_SDF)
         {
-            LOG_ERROR("stbtt_PackFontRange failed");
+            m_sdf_font_faces.insert(file_key, face);
         }
+    }
+
+    auto result = make_font();
+    result->face = move(face);
+    result->scale = stbtt_ScaleForPixelHeight(&result->face->font_info, size);
+
+    int ascent, descent, line_gap;
+    stbtt_GetFontVMetrics(&result->face->font_info, &ascent, &descent, &line_gap);
+    result->ascent = (f32)ascent * result->scale;
+    result->descent = (f32)descent * result->scale;
+    result->line_gap = (f32)line_gap * result->scale;
+
+    m_font_cache.insert(font_key, result);
+    return result;
+}
 
-        stbtt_PackEnd(&pc);
+const AtlasGlyph* D3D11_Renderer::get_glyph(D3D11_FontFace& face, u32 codepoint)
+{
+    const AtlasGlyph* cached_glyph = face.glyphs.find(codepoint, m_frame_index);
+    if (cached_glyph)
+    {
+        return cached_glyph;
+    }
+
+    int glyph_index = stbtt_FindGlyphIndex(&face.font_info, (int)codepoint);
+
+    AtlasGlyph* glyph = nullptr;
+    if (face.type == FontType_SDF)
+    {
+        int width = 0, height = 0, x_offset = 0, y_offset = 0;
+        u8* sdf = stbtt_GetGlyphSDF(
+            &face.font_info, face.raster_scale, glyph_index,
+            SDF_PADDING, SDF_ONEDGE_VALUE, SDF_PIXEL_DIST_SCALE,
+            &width, &height, &x_offset, &y_offset);
+        defer { if (sdf) stbtt_FreeSDF(sdf, NULL); };
+
+        glyph = face.glyphs.add(codepoint, sdf ? (u32)width : 0, sdf ? (u32)height : 0, m_frame_index);
+        if (glyph)
+        {
+            if (glyph->shelf != GLYPH_ATLAS_NO_SHELF)
+            {
+                for (u32 row = 0; row < glyph->rect.height; ++row)
+                {
+                    u8* dst = face.glyphs.pixels() + (usz)(glyph->rect.y + row) * face.glyphs.stride() + glyph->rect.x;
+                    memcpy(dst, sdf + (usz)row * width, glyph->rect.width);
+                }
+            }
+            glyph->x_offset = (f32)x_offset;
+            glyph->y_offset = (f32)y_offset;
+        }
     }
     else
     {
-        LOG_ERROR("stbtt_PackBegin failed");
+        int x0, y0, x1, y1;
+        stbtt_GetGlyphBitmapBox(&face.font_info, glyph_index, face.raster_scale, face.raster_scale, &x0, &y0, &x1, &y1);
+
+        glyph = face.glyphs.add(codepoint, (u32)(x1 - x0), (u32)(y1 - y0), m_frame_index);
+        if (glyph)
+        {
+            if (glyph->shelf != GLYPH_ATLAS_NO_SHELF)
+            {
+                u8* bitmap = face.glyphs.pixels() + (usz)glyph->rect.y * face.glyphs.stride() + glyph->rect.x;
+                stbtt_MakeGlyphBitmap(
+                    &face.font_info, bitmap,
+                    (int)glyph->rect.width, (int)glyph->rect.height, (int)face.glyphs.stride(),
+                    face.raster_scale, face.raster_scale, glyph_index);
+            }
+            glyph->x_offset = (f32)x0;
+            glyph->y_offset = (f32)y0;
+        }
     }
 
-    return result;
+    if (!glyph)
+    {
+        LOG_WARN("Glyph atlas is full, cannot draw codepoint {}", codepoint);
+        return nullptr;
+    }
+
+    int advance_width, left_side_bearing;
+    stbtt_GetGlyphHMetrics(&face.font_info, glyph_index, &advance_width, &left_side_bearing);
+    glyph->x_advance = (f32)advance_width * face.raster_scale;
+
+    return glyph;
 }
 
-void D3D11_Renderer::draw_glyph_and_advance(
-    const shared_ptr<D3D11_Font> &font,
-    u32 glyph,
+void D3D11_Renderer::layout_glyph_and_advance(
+    D3D11_Font& font,
+    u32 codepoint,
     f32* x, f32* y,
-    Color tint_color)
+    GlyphRun* run)
 {
-    stbtt_aligned_quad quad;
-    int align_to_integer = true;
-    stbtt_GetPackedQuad(font->packed_chars.data(), font->atlas->width, font->atlas->height, font->char_index(glyph), x, y, &quad, align_to_integer);
-
-    Rect source;
+    D3D11_FontFace& face = *font.face;
+    const AtlasGlyph* glyph = get_glyph(face, codepoint);
+    if (!glyph)
     {
-        f32 x0 = quad.s0 * font->atlas->width;
-        f32 y0 = quad.t0 * font->atlas->height;
-        f32 x1 = quad.s1 * font->atlas->width;
-        f32 y1 = quad.t1 * font->atlas->height;
-
-        source.x = x0;
-        source.y = y0;
-        source.w = (x1 - x0);
-        source.h = (y1 - y0);
+        return;
     }
 
-    Rect dest;
+    // Glyph metrics are in the scale of the atlas, which differs from the font size for SDF fonts
+    f32 glyph_scale = font.scale / face.raster_scale;
+
+    if (glyph->shelf != GLYPH_ATLAS_NO_SHELF)
     {
-        f32 x0 = quad.x0;
-        f32 x1 = quad.x1;
-        f32 y0 = quad.y0;
-        f32 y1 = quad.y1;
+        Rect source;
+        source.x = (f32)glyph->rect.x;
+        source.y = (f32)glyph->rect.y;
+        source.w = (f32)glyph->rect.width;
+        source.h = (f32)glyph->rect.height;
+
+        Rect dest;
+        dest.x = *x + glyph->x_offset * glyph_scale;
+        dest.y = *y + glyph->y_offset * glyph_scale;
+        dest.w = source.w * glyph_scale;
+        dest.h = source.h * glyph_scale;
+        if (face.type == FontType_Bitmap)
+        {
+            // Align to integer pixels
+            dest.x = floorf(dest.x + 0.5f);
+            dest.y = floorf(dest.y + 0.5f);
+        }
+
+        SpriteDrawCmd& cmd = run->sprites.emplace_back();
+        cmd.color = premultiply_tint(run->tint_color, BlendMode_Alpha);
+        cmd.src = source;
+        cmd.dst = dest;
 
-        dest.x = x0;
-        dest.y = y0;
-        dest.w = (x1 - x0);
-        dest.h = (y1 - y0);
+        auto& shelves = run->atlas_shelves;
+        if (std::find(shelves.begin(), shelves.end(), glyph->shelf) == shelves.end())
+        {
+            shelves.push_back(glyph->shelf);
+        }
     }
 
-    draw_sprite(font->atlas, source, dest, tint_color);
+    *x += glyph->x_advance * glyph_scale;
 }
 
-void D3D11_Renderer::draw_text(const FontHandle& font_, string_view text, f32 x, f32 y, Color tint_color)
+void D3D11_Renderer::layout_text(D3D11_Font& font, GlyphRun* run)
 {
-    auto font = static_pointer_cast<D3D11_Font>(font_);
-    
+    run->sprites.clear();
+    run->atlas_shelves.clear();
+
+    // Glyphs are laid out relative to the top-left of the text, and moved in place when they are drawn
+    f32 x = 0;
+    f32 y = 0;
     f32 line_begin_x = x;
-    y += font->ascent + font->descent; // I want text to have top-left as origin
-    for (char ch : text)
+    y += font.ascent + font.descent; // I want text to have top-left as origin
+
+    string_view text = run->text;
+    usz text_index = 0;
+    while (text_index < text.size())
     {
-        // TODO: UTF-8
-        u32 codepoint = ch;
+        u32 codepoint = utf8_decode_next(text, &text_index);
         if (codepoint == '\r')
         {
             continue;
@@ -710,23 +1482,93 @@ void D3D11_Renderer::draw_text(const FontHandle& font_, string_view text, f32 x,
         if (codepoint == '\n')
         {
             x = line_begin_x;
-            y += font->y_advance();
+            y += font.y_advance();
             continue;
         }
         if (codepoint == '\t') // tab as 4 spaces
         {
             for (int i = 0; i < 4; ++i)
             {
-                draw_glyph_and_advance(font, ' ', &x, &y, tint_color);
+                layout_glyph_and_advance(font, ' ', &x, &y, run);
             }
             continue;
         }
         // else just draw the thing
-        draw_glyph_and_advance(font, codepoint, &x, &y, tint_color);
+        layout_glyph_and_advance(font, codepoint, &x, &y, run);
+    }
+
+    run->atlas_generation = font.face->glyphs.generation();
+    update_font_texture(*font.face);
+}
+
+void D3D11_Renderer::prepare_glyph_run(D3D11_Font& font, GlyphRun* run, bool needs_layout)
+{
+    // Evicting glyphs from the atlas moves glyphs around, and the sprites of older runs are stale after that
+    if (needs_layout || run->atlas_generation != font.face->glyphs.generation())
+    {
+        layout_text(font, run);
+    }
+    else
+    {
+        // Glyphs of the run are used in this frame, they cannot be evicted before the batch is drawn
+        for (u32 shelf : run->atlas_shelves)
+        {
+            font.face->glyphs.touch_shelf(shelf, m_frame_index);
+        }
     }
 }
 
-::bstr::core::unique_ptr<Renderer> create_renderer()
+void D3D11_Renderer::draw_glyph_run(D3D11_Font& font, span<const SpriteDrawCmd> sprites, f32 x, f32 y)
+{
+    if (sprites.empty())
+    {
+        return;
+    }
+
+    D3D11_SpriteBatch& batch = begin_sprite_batch(font.face->atlas->id, sprites.size());
+
+    usz first_cmd = batch.sprite_commands.size();
+    batch.sprite_commands.resize(first_cmd + sprites.size());
+    copy_sprite_commands_with_offset(
+        batch.sprite_commands.data() + first_cmd, sprites.data(), sprites.size(), x, y);
+}
+
+void D3D11_Renderer::draw_text(const FontHandle& font_, string_view text, f32 x, f32 y, Color tint_color)
+{
+    PROFILE_SCOPE("Renderer::draw_text");
+    auto& font = *static_cast<D3D11_Font*>(font_.get());
+
+    GlyphRun* run = m_glyph_run_cache.find(font.id.value, text, tint_color, m_frame_index);
+    bool needs_layout = run == nullptr;
+    if (!run)
+    {
+        run = &m_glyph_run_cache.insert(font.id.value, text, tint_color, m_frame_index);
+    }
+    prepare_glyph_run(font, run, needs_layout);
+
+    draw_glyph_run(font, run->sprites, x, y);
+}
+
+TextLayoutHandle D3D11_Renderer::create_text_layout(const FontHandle& font, string_view text, Color tint_color)
+{
+    auto layout = make_pooled<D3D11_TextLayout>();
+    layout->font = static_pointer_cast<D3D11_Font>(font);
+    layout->run.font_id = layout->font->id.value;
+    layout->run.text = string(text);
+    layout->run.tint_color = tint_color;
+    layout_text(*layout->font, &layout->run);
+    return layout;
+}
+
+void D3D11_Renderer::draw_text_layout(const TextLayoutHandle& layout_, f32 x, f32 y)
+{
+    auto& layout = *static_cast<D3D11_TextLayout*>(layout_.get());
+    bool needs_layout = false;
+    prepare_glyph_run(*layout.font, &layout.run, needs_layout);
+    draw_glyph_run(*layout.font, layout.run.sprites, x, y);
+}
+
+::bstr::core::unique_ptr<Renderer> create_renderer(non_null<JobSystem> job_system)
 {
     HINSTANCE instance = GetModuleHandle(0);
 
@@ -783,6 +1625,25 @@ void D3D11_Renderer::draw_text(const FontHandle& font_, string_view text, f32 x,
         LOG_ERROR("Failed to initialize dear imgui");
     }
 
+    UINT r8_support = 0;
+    UINT sampled_texture_support = D3D11_FORMAT_SUPPORT_TEXTURE2D | D3D11_FORMAT_SUPPORT_SHADER_SAMPLE;
+    hr = renderer->m_device->CheckFormatSupport(DXGI_FORMAT_R8_UNORM, &r8_support);
+    if (FAILED(hr) || (r8_support & sampled_texture_support) != sampled_texture_support)
+    {
+        LOG_WARN("R8 textures are not supported, font atlases fall back to RGBA");
+        renderer->m_font_atlas_format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    }
+
+    for (BlockCompression compression : { BlockCompression_BC1, BlockCompression_BC3, BlockCompression_BC7 })
+    {
+        UINT format_support = 0;
+        hr = renderer->m_device->CheckFormatSupport(get_block_compressed_format(compression), &format_support);
+        if (SUCCEEDED(hr) && (format_support & sampled_texture_support) == sampled_texture_support)
+        {
+            renderer->m_supported_block_compressions |= 1u << compression;
+        }
+    }
+
 #if defined(IS_INTERNAL_BUILD) && IS_INTERNAL_BUILD
     // Set up debug layer to break on D3D11 errors
     ID3D11Debug* d3d_debug = NULL;
@@ -825,10 +1686,11 @@ void D3D11_Renderer::draw_text(const FontHandle& font_, string_view text, f32 x,
 
     D3D11_BLEND_DESC blend_desc = {};
     blend_desc.RenderTarget[0].BlendEnable = true;
-    blend_desc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+    // Premultiplied alpha, additive sprites come out of the shader with zero alpha
+    blend_desc.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;
     blend_desc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
     blend_desc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
-    blend_desc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_SRC_ALPHA;
+    blend_desc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
     blend_desc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
     blend_desc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
     blend_desc.RenderTarget[0].RenderTargetWriteMask = D3D10_COLOR_WRITE_ENABLE_ALL;
@@ -880,6 +1742,10 @@ void D3D11_Renderer::draw_text(const FontHandle& font_, string_view text, f32 x,
         NULL,
         &renderer->m_per_instance_buffer);
     ASSERT_UNCHECKED(SUCCEEDED(hr), "");
+    renderer->m_instance_ring = InstanceRingAllocator(MAX_COMMANDS_PER_SPRITE_BATCH, sizeof(InstanceData));
+
+    renderer->m_image_cache = make_unique<ImageCache>("cache");
+    renderer->m_texture_loader = make_unique<TextureLoader>(job_system, renderer->m_image_cache.get());
 
     static const u16 indices[] = {
         0, 1, 2,
@@ -916,12 +1782,25 @@ void D3D11_Renderer::draw_text(const FontHandle& font_, string_view text, f32 x,
 
 D3D11_Renderer::~D3D11_Renderer()
 {
+    // Queued sprites are dropped, and the resources the renderer holds are destroyed while the device objects
+    // they use still exist. Destroying a texture must not flush the batch after this.
+    m_current_sprite_batch.texture_id = {};
+    m_current_sprite_batch.sprite_commands.clear();
+    m_texture_loader.reset();
+    m_loading_textures.clear();
+    m_white_texture.reset();
+    ASSERT(
+        m_textures.size() == 0 && m_fonts.size() == 0,
+        "textures and fonts have to be released before the renderer, they refer back to it");
+    m_is_shutting_down = true;
+
     ImGui_ImplDX11_Shutdown();
 
     m_blend_state->Release();
     m_constant_buffer->Release();
     m_per_vertex_buffer->Release();
     m_per_instance_buffer->Release();
+    m_index_buffer->Release();
     m_render_target_view->Release();
     m_rasterizer_state->Release();
 
@@ -0,0 +1,80 @@
+// Copyright (c) 2023, Roni Juppi <roni.juppi@gmail.com>
+
+#pragma once
+
+#include "def.h"
+#include "smart_ptr.h"
+#include "containers/hashmap.h"
+#include "string_id.h"
+
+namespace bstr::renderer {
+
+// Maps a key, e.g. the id of the canonical path of a file, to a resource that is already loaded. The cache only holds
+// weak references, so a resource is freed when the last handle to it is released and loaded again the next time.
+template<typename T>
+class ResourceCache {
+public:
+    // Counts a hit or a miss. Returns nullptr if the resource is not loaded.
+    shared_ptr<T> find(StringId key)
+    {
+        shared_ptr<T> result;
+        auto it = m_resources.find(key);
+        if (it != m_resources.end())
+        {
+            result = it->second.lock();
+            if (!result)
+            {
+                m_resources.erase(it);
+            }
+        }
+
+        if (result)
+        {
+            m_hits += 1;
+        }
+        else
+        {
+            m_misses += 1;
+        }
+        return result;
+    }
+
+    void insert(StringId key, const shared_ptr<T>& resource)
+    {
+        m_resources[key] = resource;
+    }
+
+    // The resource stays alive for its handles, it is just not found any more
+    void erase(StringId key)
+    {
+        m_resources.erase(key);
+    }
+
+    // Calls func for every resource that is still alive and forgets the rest
+    template<typename Func>
+    void for_each_alive(Func&& func)
+    {
+        for (auto it = m_resources.begin(); it != m_resources.end();)
+        {
+            if (shared_ptr<T> resource = it->second.lock())
+            {
+                func(*resource);
+                ++it;
+            }
+            else
+            {
+                it = m_resources.erase(it);
+            }
+        }
+    }
+
+    u64 hits() const { return m_hits; }
+    u64 misses() const { return m_misses; }
+
+private:
+    hash_map<StringId, weak_ptr<T>> m_resources;
+    u64 m_hits{};
+    u64 m_misses{};
+};
+
+}
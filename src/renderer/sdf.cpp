@@ -0,0 +1,55 @@
+// Copyright (c) 2023, Roni Juppi <roni.juppi@gmail.com>
+
+#include "sdf.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace bstr::core;
+
+namespace bstr::renderer {
+
+static f32 fetch_clamped(const u8* sdf, u32 width, u32 height, u32 stride, s32 x, s32 y)
+{
+    x = std::clamp(x, 0, (s32)width - 1);
+    y = std::clamp(y, 0, (s32)height - 1);
+    f32 result = (f32)sdf[(usz)y * stride + (usz)x] / 255.f;
+    return result;
+}
+
+static f32 smoothstep(f32 edge0, f32 edge1, f32 x)
+{
+    f32 t = std::clamp((x - edge0) / (edge1 - edge0), 0.f, 1.f);
+    f32 result = t * t * (3.f - 2.f * t);
+    return result;
+}
+
+f32 sample_sdf_coverage(non_null<const u8> sdf, u32 width, u32 height, u32 stride, f32 x, f32 y, f32 screen_pixel_in_texels)
+{
+    ASSERT(width > 0 && height > 0, "empty distance field");
+
+    // Bilinear filtering like the GPU sampler does
+    f32 texel_x = x - 0.5f;
+    f32 texel_y = y - 0.5f;
+    f32 x0f = floorf(texel_x);
+    f32 y0f = floorf(texel_y);
+    f32 fx = texel_x - x0f;
+    f32 fy = texel_y - y0f;
+    s32 x0 = (s32)x0f;
+    s32 y0 = (s32)y0f;
+
+    f32 d00 = fetch_clamped(sdf, width, height, stride, x0, y0);
+    f32 d10 = fetch_clamped(sdf, width, height, stride, x0 + 1, y0);
+    f32 d01 = fetch_clamped(sdf, width, height, stride, x0, y0 + 1);
+    f32 d11 = fetch_clamped(sdf, width, height, stride, x0 + 1, y0 + 1);
+    f32 distance = (d00 * (1 - fx) + d10 * fx) * (1 - fy) + (d01 * (1 - fx) + d11 * fx) * fy;
+
+    // Change of the normalized distance over one screen pixel
+    f32 edge = (f32)SDF_ONEDGE_VALUE / 255.f;
+    f32 edge_width = max(SDF_PIXEL_DIST_SCALE / 255.f * screen_pixel_in_texels, 1e-4f);
+    f32 result = smoothstep(edge - edge_width, edge + edge_width, distance);
+    return result;
+}
+
+}
@@ -0,0 +1,24 @@
+// Copyright (c) 2023, Roni Juppi <roni.juppi@gmail.com>
+
+#pragma once
+
+#include "def.h"
+#include "non_null.h"
+
+namespace bstr::renderer {
+
+// Glyphs of signed distance field fonts are rasterized once at this size, and scaled to any size when drawn
+static constexpr f32 SDF_RASTER_PIXEL_HEIGHT = 48.f;
+
+// Parameters for stbtt_GetGlyphSDF. Distance of SDF_PADDING pixels outside the edge maps to 0,
+// and the edge itself is SDF_ONEDGE_VALUE.
+static constexpr int SDF_PADDING = 5;
+static constexpr u8 SDF_ONEDGE_VALUE = 128;
+static constexpr f32 SDF_PIXEL_DIST_SCALE = (f32)SDF_ONEDGE_VALUE / (f32)SDF_PADDING;
+
+// CPU reference of how shader.hlsl turns a distance field into coverage. Samples the field bilinearly at
+// (x, y) in texels, with pixel centers at .5, and smooths the edge over screen_pixel_in_texels, which is
+// what fwidth gives on the GPU. Meant for tests and tools, drawing does not use this.
+f32 sample_sdf_coverage(non_null<const u8> sdf, u32 width, u32 height, u32 stride, f32 x, f32 y, f32 screen_pixel_in_texels);
+
+}
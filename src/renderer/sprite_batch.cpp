@@ -0,0 +1,106 @@
+// Copyright (c) 2023, Roni Juppi <roni.juppi@gmail.com>
+
+#include "sprite_batch.h"
+#include "utils.h"
+#include "simd.h"
+
+#include <cstring>
+
+namespace bstr::renderer {
+
+void copy_sprite_commands(non_null<SpriteDrawCmd> dst, const SpriteDrawCmd* src, usz count)
+{
+    if (((uptr)dst & 15) != 0)
+    {
+        memcpy(dst, src, count * sizeof(SpriteDrawCmd));
+        return;
+    }
+
+    const f32* in = (const f32*)src;
+    f32* out = (f32*)dst;
+    for (usz cmd_idx = 0; cmd_idx < count; ++cmd_idx)
+    {
+        __m128 color = _mm_loadu_ps(in + 0);
+        __m128 src_rect = _mm_loadu_ps(in + 4);
+        __m128 dst_rect = _mm_loadu_ps(in + 8);
+        _mm_stream_ps(out + 0, color);
+        _mm_stream_ps(out + 4, src_rect);
+        _mm_stream_ps(out + 8, dst_rect);
+        in += 12;
+        out += 12;
+    }
+    // Streaming stores are weakly ordered, make sure they are visible before the buffer is unmapped
+    _mm_sfence();
+}
+
+void copy_sprite_commands_with_offset(SpriteDrawCmd* dst, const SpriteDrawCmd* src, usz count, f32 offset_x, f32 offset_y)
+{
+    __m128 offset = _mm_setr_ps(offset_x, offset_y, 0, 0);
+    for (usz cmd_idx = 0; cmd_idx < count; ++cmd_idx)
+    {
+        const f32* in = (const f32*)(src + cmd_idx);
+        f32* out = (f32*)(dst + cmd_idx);
+        _mm_storeu_ps(out + 0, _mm_loadu_ps(in + 0));
+        _mm_storeu_ps(out + 4, _mm_loadu_ps(in + 4));
+        _mm_storeu_ps(out + 8, _mm_add_ps(_mm_loadu_ps(in + 8), offset));
+    }
+}
+
+usz cull_sprite_commands(SpriteDrawCmd* cmds, usz count, Rect viewport)
+{
+    __m128 viewport_min_x = _mm_set1_ps(viewport.x);
+    __m128 viewport_min_y = _mm_set1_ps(viewport.y);
+    __m128 viewport_max_x = _mm_set1_ps(viewport.x + viewport.w);
+    __m128 viewport_max_y = _mm_set1_ps(viewport.y + viewport.h);
+
+    usz visible_count = 0;
+    usz cmd_idx = 0;
+
+    // Test blocks of four commands at once. Fully visible blocks are moved as a whole,
+    // and fully invisible blocks are skipped without touching the commands any further.
+    for (; cmd_idx + 4 <= count; cmd_idx += 4)
+    {
+        __m128 x = _mm_loadu_ps(&cmds[cmd_idx + 0].dst.x);
+        __m128 y = _mm_loadu_ps(&cmds[cmd_idx + 1].dst.x);
+        __m128 w = _mm_loadu_ps(&cmds[cmd_idx + 2].dst.x);
+        __m128 h = _mm_loadu_ps(&cmds[cmd_idx + 3].dst.x);
+        _MM_TRANSPOSE4_PS(x, y, w, h);
+
+        __m128 max_x = _mm_add_ps(x, w);
+        __m128 max_y = _mm_add_ps(y, h);
+        __m128 overlap_x = _mm_and_ps(_mm_cmplt_ps(x, viewport_max_x), _mm_cmpgt_ps(max_x, viewport_min_x));
+        __m128 overlap_y = _mm_and_ps(_mm_cmplt_ps(y, viewport_max_y), _mm_cmpgt_ps(max_y, viewport_min_y));
+        int visible_mask = _mm_movemask_ps(_mm_and_ps(overlap_x, overlap_y));
+
+        if (visible_mask == 0xF)
+        {
+            if (visible_count != cmd_idx)
+            {
+                memmove(&cmds[visible_count], &cmds[cmd_idx], 4 * sizeof(SpriteDrawCmd));
+            }
+            visible_count += 4;
+        }
+        else if (visible_mask != 0)
+        {
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                if (visible_mask & (1 << lane))
+                {
+                    cmds[visible_count++] = cmds[cmd_idx + lane];
+                }
+            }
+        }
+    }
+
+    for (; cmd_idx < count; ++cmd_idx)
+    {
+        if (rect_overlaps(cmds[cmd_idx].dst, viewport))
+        {
+            cmds[visible_count++] = cmds[cmd_idx];
+        }
+    }
+
+    return visible_count;
+}
+
+}
@@ -0,0 +1,45 @@
+// Copyright (c) 2023, Roni Juppi <roni.juppi@gmail.com>
+
+#pragma once
+
+#include "def.h"
+#include "non_null.h"
+#include "renderer.h"
+
+#include <cstddef>
+
+namespace bstr::renderer {
+
+// Per sprite data recorded by draw_sprite. The layout is exactly the per instance vertex data
+// the shader reads (COL, SRC, DST), so recorded commands can be copied to the instance buffer as-is.
+struct SpriteDrawCmd
+{
+    Color color{};
+    Rect src{};
+    Rect dst{};
+};
+static_assert(sizeof(SpriteDrawCmd) == 48, "SpriteDrawCmd must match the instance layout in shader.hlsl");
+static_assert(offsetof(SpriteDrawCmd, color) == 0, "SpriteDrawCmd must match the instance layout in shader.hlsl");
+static_assert(offsetof(SpriteDrawCmd, src) == 16, "SpriteDrawCmd must match the instance layout in shader.hlsl");
+static_assert(offsetof(SpriteDrawCmd, dst) == 32, "SpriteDrawCmd must match the instance layout in shader.hlsl");
+
+// Copies sprite commands to GPU visible memory. Destination is expected to be write-combined memory
+// (e.g. a mapped dynamic buffer), so when it is 16 byte aligned we use streaming stores that bypass the cache.
+void copy_sprite_commands(non_null<SpriteDrawCmd> dst, const SpriteDrawCmd* src, usz count);
+
+// Copies sprite commands and moves their dst rects by the offset, e.g. to place a cached glyph run.
+void copy_sprite_commands_with_offset(SpriteDrawCmd* dst, const SpriteDrawCmd* src, usz count, f32 offset_x, f32 offset_y);
+
+// Rects that only touch the edge of the viewport do not overlap it
+inline bool rect_overlaps(const Rect& rect, const Rect& viewport)
+{
+    bool result = rect.x < viewport.x + viewport.w && rect.x + rect.w > viewport.x
+        && rect.y < viewport.y + viewport.h && rect.y + rect.h > viewport.y;
+    return result;
+}
+
+// Removes the commands whose dst rect does not overlap the viewport. Visible commands are compacted in order
+// to the beginning of the array. Returns the number of visible commands.
+usz cull_sprite_commands(SpriteDrawCmd* cmds, usz count, Rect viewport);
+
+}
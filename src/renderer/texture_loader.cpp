@@ -0,0 +1,203 @@
+// Copyright (c) 2023, Roni Juppi <roni.juppi@gmail.com>
+
+#include "texture_loader.h"
+#include "profiler.h"
+#include "utils.h"
+
+#include <cstring>
+#include <thread>
+
+#pragma warning(push, 0)
+#include <stb_image.h>
+#pragma warning(pop)
+
+using namespace bstr::core;
+
+namespace bstr::renderer {
+
+void DecodedPixelsDeleter::operator()(u8* pixels) const
+{
+    stbi_image_free(pixels);
+}
+
+// Block compressed textures with mips have to be whole blocks, the edge pixels are repeated to fill them
+static vector<u8> pad_to_whole_blocks(const u8* pixels, u32 width, u32 height, u32 padded_width, u32 padded_height)
+{
+    vector<u8> result((usz)padded_width * padded_height * 4);
+    for (u32 y = 0; y < padded_height; ++y)
+    {
+        const u8* src_row = pixels + (usz)min(y, height - 1) * width * 4;
+        u8* dst_row = result.data() + (usz)y * padded_width * 4;
+        memcpy(dst_row, src_row, (usz)width * 4);
+        for (u32 x = width; x < padded_width; ++x)
+        {
+            memcpy(dst_row + (usz)x * 4, src_row + (usz)(width - 1) * 4, 4);
+        }
+    }
+    return result;
+}
+
+bool decode_image_file(
+    const ImageCache* image_cache,
+    non_null<const char> filename,
+    const TextureLoadOptions& options,
+    out_ptr<DecodedImage> out_image)
+{
+    BlockCompression compression = options.compression;
+    out_image->compression = compression;
+
+    u32 cache_flags = ImageCacheFlags_Premultiplied;
+    if (options.generate_mips)
+    {
+        cache_flags |= ImageCacheFlags_Mipmapped;
+    }
+    if (options.compress_cache)
+    {
+        cache_flags |= ImageCacheFlags_Zlib;
+    }
+    if (image_cache && image_cache->load(filename, cache_flags, compression, &out_image->cached))
+    {
+        out_image->width = out_image->cached.width();
+        out_image->height = out_image->cached.height();
+        out_image->mip_count = out_image->cached.mip_count();
+        return true;
+    }
+
+    vector<u8> source_data = read_entire_file_as_bytes(filename);
+    if (source_data.empty())
+    {
+        return false;
+    }
+
+    int req_comps = 4;
+    int width, height, num_comps;
+    out_image->decoded_pixels.reset(stbi_load_from_memory(
+        source_data.data(), (int)source_data.size(), &width, &height, &num_comps, req_comps));
+    if (!out_image->decoded_pixels)
+    {
+        return false;
+    }
+    out_image->width = (u32)width;
+    out_image->height = (u32)height;
+
+    // Each step reads the result of the previous one. The image keeps its size, only the pixels are padded.
+    u8* pixels = out_image->decoded_pixels.get();
+    u32 padded_width = get_block_padded_dimension(compression, out_image->width);
+    u32 padded_height = get_block_padded_dimension(compression, out_image->height);
+    vector<u8> padded;
+    if (padded_width != out_image->width || padded_height != out_image->height)
+    {
+        padded = pad_to_whole_blocks(pixels, out_image->width, out_image->height, padded_width, padded_height);
+        pixels = padded.data();
+    }
+
+    vector<u8> mip_chain;
+    if (options.generate_mips)
+    {
+        out_image->mip_count = get_mip_count(padded_width, padded_height);
+        mip_chain.resize(get_mip_chain_size(BlockCompression_None, padded_width, padded_height, out_image->mip_count));
+        generate_mip_chain(pixels, padded_width, padded_height, MipFilter_Kaiser, MipFlags_Srgb, mip_chain.data());
+        pixels = mip_chain.data();
+    }
+
+    // The mip filter weights straight colors by alpha itself, so the whole chain is premultiplied afterwards
+    usz pixel_count = get_mip_chain_size(BlockCompression_None, padded_width, padded_height, out_image->mip_count) / 4;
+    premultiply_alpha((u32*)pixels, pixel_count);
+
+    if (compression != BlockCompression_None)
+    {
+        out_image->processed_pixels.resize(get_mip_chain_size(compression, padded_width, padded_height, out_image->mip_count));
+        const u8* src = pixels;
+        u8* dst = out_image->processed_pixels.data();
+        for (u32 level = 0; level < out_image->mip_count; ++level)
+        {
+            u32 level_width = get_mip_dimension(padded_width, level);
+            u32 level_height = get_mip_dimension(padded_height, level);
+            encode_block_compressed(compression, src, level_width, level_height, dst);
+            src += (usz)level_width * level_height * 4;
+            dst += block_compressed_size(compression, level_width, level_height);
+        }
+    }
+    else if (!mip_chain.empty())
+    {
+        out_image->processed_pixels = move(mip_chain);
+    }
+    if (!out_image->processed_pixels.empty())
+    {
+        out_image->decoded_pixels.reset();
+    }
+
+    if (image_cache)
+    {
+        image_cache->store(filename, source_data, out_image->pixels(), out_image->width, out_image->height, cache_flags, compression);
+    }
+    return true;
+}
+
+TextureLoader::TextureLoader(non_null<JobSystem> job_system, const ImageCache* image_cache)
+    : m_image_cache(image_cache)
+    , m_job_system(job_system)
+{
+}
+
+TextureLoader::~TextureLoader()
+{
+    m_is_stopping.store(true, std::memory_order_relaxed);
+    // Not JobSystem::wait, the decodes run on workers only
+    while (!m_decodes_in_flight.is_done())
+    {
+        std::this_thread::yield();
+    }
+}
+
+u64 TextureLoader::request(string_view filename, const TextureLoadOptions& options)
+{
+    u64 request_id = m_next_request_id++;
+    // The request is larger than a job can hold
+    auto request = make_unique<Request>(Request{ request_id, string(filename), options });
+    // The thread that polls for decoded images may be the one that created the job system, so decodes
+    // go to the workers. Otherwise waiting for any job on this thread could run a whole decode.
+    m_job_system->run_on_worker(&m_decodes_in_flight, [this, request = move(request)] { decode(*request); });
+    return request_id;
+}
+
+bool TextureLoader::take_decoded(out_ptr<DecodedImage> out_image)
+{
+    bool result = m_decoded.try_pop(out_image);
+    if (!result && m_overflow_count.load(std::memory_order_acquire) > 0)
+    {
+        std::lock_guard lock(m_overflow_mutex);
+        if (!m_overflow.empty())
+        {
+            *out_image = move(m_overflow.back());
+            m_overflow.pop_back();
+            m_overflow_count.store(m_overflow.size(), std::memory_order_release);
+            result = true;
+        }
+    }
+    return result;
+}
+
+void TextureLoader::decode(const Request& request)
+{
+    PROFILE_SCOPE("TextureLoader::decode");
+    if (m_is_stopping.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    DecodedImage image;
+    image.request_id = request.id;
+
+    decode_image_file(m_image_cache, request.filename.c_str(), request.options, &image);
+    image.filename = request.filename;
+
+    if (!m_decoded.try_push(move(image)))
+    {
+        std::lock_guard lock(m_overflow_mutex);
+        m_overflow.push_back(move(image));
+        m_overflow_count.store(m_overflow.size(), std::memory_order_release);
+    }
+}
+
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2023, Roni Juppi <roni.juppi@gmail.com>
+
+#pragma once
+
+#include "def.h"
+#include "image_cache.h"
+#include "jobs.h"
+#include "renderer.h"
+#include "out_ptr.h"
+#include "smart_ptr.h"
+#include "containers/mpmc_queue.h"
+#include "containers/string.h"
+#include "containers/string_view.h"
+#include "containers/vector.h"
+
+#include <atomic>
+#include <mutex>
+
+namespace bstr::renderer {
+
+// Decoded images waiting for the renderer to take them without a lock. Images decoded while the queue is full
+// wait in a list behind a lock instead, decoding never blocks a worker.
+static constexpr usz TEXTURE_LOADER_QUEUE_CAPACITY = 64;
+
+struct DecodedPixelsDeleter
+{
+    void operator()(u8* pixels) const;
+};
+
+struct DecodedImage
+{
+    u64 request_id{};
+    string filename;
+
+    // Decoded by stb_image, then possibly mipmapped and block compressed, or loaded from the image cache
+    unique_ptr<u8, DecodedPixelsDeleter> decoded_pixels;
+    vector<u8> processed_pixels;
+    core::CachedImage cached;
+    core::BlockCompression compression{};
+    u32 width{}; // Of the image, blocks of compressed images cover get_block_padded_dimension of the size
+    u32 height{};
+    u32 mip_count = 1; // Levels of the padded size
+
+    // RGBA8 pixels with premultiplied alpha or blocks of the compression, every mip level one after another.
+    // nullptr if the file could not be decoded.
+    const u8* pixels() const
+    {
+        if (!processed_pixels.empty()) return processed_pixels.data();
+        if (decoded_pixels) return decoded_pixels.get();
+        return cached.pixels();
+    }
+};
+
+// Takes the pixels from the image cache when it has them, otherwise decodes and processes the file as the options say
+// and adds it to the cache. image_cache can be nullptr. Returns false if the file could not be read or decoded.
+bool decode_image_file(
+    const core::ImageCache* image_cache,
+    non_null<const char> filename,
+    const TextureLoadOptions& options,
+    out_ptr<DecodedImage> out_image);
+
+// Decodes image files as jobs on the workers of the job system. The renderer polls for decoded images and uploads them itself,
+// so the loader does not know about any graphics API.
+class TextureLoader {
+public:
+    // The job system and image cache must outlive the loader, the image cache can be nullptr
+    TextureLoader(non_null<core::JobSystem> job_system, const core::ImageCache* image_cache);
+    // Files that have not started decoding are skipped, the ones being decoded are waited for and dropped
+    ~TextureLoader();
+
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    // Returns an id that is used to match the decoded image to the request. Called from one thread only.
+    u64 request(string_view filename, const TextureLoadOptions& options);
+
+    // Returns false if no image has been decoded since the last call
+    bool take_decoded(out_ptr<DecodedImage> out_image);
+
+private:
+    struct Request
+    {
+        u64 id{};
+        string filename;
+        TextureLoadOptions options;
+    };
+
+    void decode(const Request& request);
+
+    mpmc_queue<DecodedImage> m_decoded{ TEXTURE_LOADER_QUEUE_CAPACITY };
+    // Decoded images that did not fit in the queue, taken after the ones in it
+    std::mutex m_overflow_mutex;
+    vector<DecodedImage> m_overflow;
+    std::atomic<usz> m_overflow_count{};
+    u64 m_next_request_id = 1;
+    std::atomic<bool> m_is_stopping{};
+
+    const core::ImageCache* m_image_cache{};
+    core::JobSystem* m_job_system{};
+    core::JobCounter m_decodes_in_flight;
+};
+
+}
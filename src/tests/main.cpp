@@ -0,0 +1,79 @@
+#include "test.h"
+
+#include <cstring>
+
+namespace bstr::tests {
+
+static TestCase* g_first_test = nullptr;
+static TestCase* g_last_test = nullptr;
+static u32 g_failure_count = 0;
+
+TestRegistration::TestRegistration(TestCase* test)
+{
+    // In registration order, which is the order of the files and of the tests in them
+    if (g_last_test)
+    {
+        g_last_test->next = test;
+    }
+    else
+    {
+        g_first_test = test;
+    }
+    g_last_test = test;
+}
+
+void report_failure(const char* file, int line, const char* expression)
+{
+    LOG_ERROR("{}({}): CHECK({}) failed", file, line, expression);
+    g_failure_count += 1;
+}
+
+}
+
+using namespace bstr;
+using namespace bstr::tests;
+
+// tests [--bench] [name filter]
+int main(int argc, char** argv)
+{
+    TestKind kind = TestKind_Test;
+    const char* filter = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--bench") == 0)
+        {
+            kind = TestKind_Benchmark;
+        }
+        else
+        {
+            filter = argv[i];
+        }
+    }
+
+    u32 run_count = 0;
+    u32 failed_count = 0;
+    for (TestCase* test = g_first_test; test; test = test->next)
+    {
+        if (test->kind != kind || (filter && !strstr(test->name, filter)))
+        {
+            continue;
+        }
+
+        LOG_INFO("{}", test->name);
+        u32 failures_before = g_failure_count;
+        test->function();
+        run_count += 1;
+        if (g_failure_count != failures_before)
+        {
+            failed_count += 1;
+        }
+    }
+
+    if (failed_count > 0)
+    {
+        LOG_ERROR("{} of {} failed", failed_count, run_count);
+        return 1;
+    }
+    LOG_INFO("{} passed", run_count);
+    return 0;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "def.h"
+#include "utils.h"
+
+#include <chrono>
+
+// Tests and benchmarks register themselves when the program starts. The runner runs every test, or every
+// benchmark when given --bench, and an optional name filter. A test fails if any of its CHECKs fails.
+#define TEST(name) TEST_CASE_(name, ::bstr::tests::TestKind_Test)
+#define BENCHMARK(name) TEST_CASE_(name, ::bstr::tests::TestKind_Benchmark)
+
+#define CHECK(expression) \
+    do { if (!(expression)) ::bstr::tests::report_failure(__FILE__, __LINE__, #expression); } while (0)
+
+#define TEST_CASE_(name, kind) \
+    static void name(); \
+    static ::bstr::tests::TestCase CONCAT(name, _case_) = { #name, name, kind }; \
+    static const ::bstr::tests::TestRegistration CONCAT(name, _registration_)(&CONCAT(name, _case_)); \
+    static void name()
+
+namespace bstr::tests {
+
+enum TestKind : u32 {
+    TestKind_Test,
+    TestKind_Benchmark,
+};
+
+struct TestCase
+{
+    const char* name{};
+    void (*function)(){};
+    TestKind kind{};
+    TestCase* next{};
+};
+
+struct TestRegistration
+{
+    explicit TestRegistration(TestCase* test);
+};
+
+void report_failure(const char* file, int line, const char* expression);
+
+// Keeps the compiler from optimizing away the work of a benchmark
+template<typename T>
+inline void do_not_optimize(const T& value)
+{
+    const volatile T* volatile pointer = &value;
+    UNUSED(pointer);
+}
+
+// Calls func until at least min_seconds have passed and logs the rate. Every call does items_per_call items.
+// Returns the items per second.
+template<typename Func>
+f64 run_benchmark(const char* name, usz items_per_call, Func&& func, f64 min_seconds = 0.25)
+{
+    // The first call warms up the caches and the allocators
+    func();
+
+    using Clock = std::chrono::steady_clock;
+    usz call_count = 0;
+    Clock::time_point start = Clock::now();
+    f64 elapsed = 0;
+    while (elapsed < min_seconds)
+    {
+        func();
+        call_count += 1;
+        elapsed = std::chrono::duration<f64>(Clock::now() - start).count();
+    }
+
+    f64 result = (f64)(call_count * items_per_call) / elapsed;
+    LOG_INFO("  {:<40} {:>10.2f} M/s", name, result / 1e6);
+    return result;
+}
+
+}
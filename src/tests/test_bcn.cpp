@@ -0,0 +1,153 @@
+#include "test.h"
+#include "bcn.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace bstr;
+using namespace bstr::core;
+using namespace bstr::tests;
+
+// Interpolation weights of 4-bit indices from the BC7 specification
+static const u32 SPEC_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Writes a BC7 mode 6 block bit by bit, least significant bit first, in the field order of the specification
+struct Mode6Block
+{
+    u8 bytes[16]{};
+    u32 position{};
+
+    void write(u32 value, u32 bit_count)
+    {
+        for (u32 i = 0; i < bit_count; ++i, ++position)
+        {
+            bytes[position / 8] |= (u8)(((value >> i) & 1) << (position % 8));
+        }
+    }
+
+    // Endpoints are 7 bits per channel and a p-bit, which is taken from the lowest bit of red
+    Mode6Block(const u8 endpoint0[4], const u8 endpoint1[4], const u32 indices[16])
+    {
+        write(1 << 6, 7);
+        for (u32 c = 0; c < 4; ++c)
+        {
+            write(endpoint0[c] >> 1, 7);
+            write(endpoint1[c] >> 1, 7);
+        }
+        write(endpoint0[0] & 1, 1);
+        write(endpoint1[0] & 1, 1);
+        write(indices[0], 3);
+        for (u32 i = 1; i < 16; ++i)
+        {
+            write(indices[i], 4);
+        }
+    }
+};
+
+TEST(bc7_decodes_solid_block)
+{
+    u8 white[4] = { 255, 255, 255, 255 };
+    u32 indices[16] = {};
+    Mode6Block block(white, white, indices);
+
+    u8 pixels[16 * 4];
+    CHECK(decode_block_compressed(BlockCompression_BC7, block.bytes, 4, 4, pixels));
+    for (u32 i = 0; i < 16 * 4; ++i)
+    {
+        CHECK(pixels[i] == 255);
+    }
+}
+
+TEST(bc7_decodes_every_index_weight)
+{
+    u8 endpoint0[4] = { 0, 0, 0, 0 };
+    u8 endpoint1[4] = { 255, 255, 255, 255 };
+    u8 mixed0[4] = { 10, 200, 64, 254 };
+    u8 mixed1[4] = { 250, 20, 129, 1 };
+    u32 indices[16];
+    for (u32 i = 0; i < 16; ++i)
+    {
+        indices[i] = i;
+    }
+    // The p-bit of an endpoint is written from its red channel and is the lowest bit of every channel
+    const u8* pairs[][2] = { { endpoint0, endpoint1 }, { mixed0, mixed1 } };
+    for (auto& pair : pairs)
+    {
+        Mode6Block block(pair[0], pair[1], indices);
+        u8 pixels[16 * 4];
+        CHECK(decode_block_compressed(BlockCompression_BC7, block.bytes, 4, 4, pixels));
+        for (u32 i = 0; i < 16; ++i)
+        {
+            for (u32 c = 0; c < 4; ++c)
+            {
+                u32 e0 = (pair[0][c] & ~1u) | (pair[0][0] & 1);
+                u32 e1 = (pair[1][c] & ~1u) | (pair[1][0] & 1);
+                u32 expected = ((64 - SPEC_WEIGHTS4[i]) * e0 + SPEC_WEIGHTS4[i] * e1 + 32) >> 6;
+                CHECK(pixels[i * 4 + c] == expected);
+            }
+        }
+    }
+}
+
+TEST(bc7_other_modes_decode_to_transparent_black)
+{
+    // Mode 0, which the decoder does not support
+    u8 block[16] = { 0x01, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    u8 pixels[16 * 4];
+    memset(pixels, 0x55, sizeof(pixels));
+    CHECK(!decode_block_compressed(BlockCompression_BC7, block, 4, 4, pixels));
+    for (u32 i = 0; i < 16 * 4; ++i)
+    {
+        CHECK(pixels[i] == 0);
+    }
+}
+
+TEST(bc7_round_trip_keeps_opaque_and_transparent_alpha)
+{
+    srand(1);
+    for (u32 block_index = 0; block_index < 1000; ++block_index)
+    {
+        // Dark colors used to pick the p-bit that decodes opaque alpha to 254
+        u8 pixels[16 * 4];
+        u8 alpha = block_index % 2 ? 255 : 0;
+        u32 color_range = block_index % 3 == 0 ? 16 : 256;
+        for (u32 i = 0; i < 16; ++i)
+        {
+            pixels[i * 4 + 0] = (u8)(rand() % color_range);
+            pixels[i * 4 + 1] = (u8)(rand() % color_range);
+            pixels[i * 4 + 2] = (u8)(rand() % color_range);
+            pixels[i * 4 + 3] = alpha;
+        }
+
+        u8 block[16];
+        u8 decoded[16 * 4];
+        encode_block_compressed(BlockCompression_BC7, pixels, 4, 4, block);
+        CHECK(decode_block_compressed(BlockCompression_BC7, block, 4, 4, decoded));
+        for (u32 i = 0; i < 16; ++i)
+        {
+            CHECK(decoded[i * 4 + 3] == alpha);
+        }
+    }
+}
+
+TEST(bc7_round_trip_of_gradient_is_close)
+{
+    // Colors on a line are what one subset represents well
+    u8 pixels[16 * 4];
+    for (u32 i = 0; i < 16; ++i)
+    {
+        pixels[i * 4 + 0] = (u8)(i * 16);
+        pixels[i * 4 + 1] = (u8)(255 - i * 16);
+        pixels[i * 4 + 2] = (u8)(64 + i * 8);
+        pixels[i * 4 + 3] = (u8)(128 + i * 8);
+    }
+
+    u8 block[16];
+    u8 decoded[16 * 4];
+    encode_block_compressed(BlockCompression_BC7, pixels, 4, 4, block);
+    CHECK(decode_block_compressed(BlockCompression_BC7, block, 4, 4, decoded));
+    for (u32 i = 0; i < 16 * 4; ++i)
+    {
+        CHECK(abs((s32)decoded[i] - (s32)pixels[i]) <= 6);
+    }
+}
@@ -0,0 +1,167 @@
+#include "test.h"
+#include "glyph_atlas.h"
+
+#include <cstring>
+
+using namespace bstr;
+using namespace bstr::renderer;
+using namespace bstr::tests;
+
+static bool rects_overlap(const AtlasRect& a, const AtlasRect& b)
+{
+    bool result = a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+    return result;
+}
+
+static bool rect_contains(const AtlasRect& outer, const AtlasRect& inner)
+{
+    bool result = inner.x >= outer.x && inner.y >= outer.y
+        && inner.x + inner.width <= outer.x + outer.width && inner.y + inner.height <= outer.y + outer.height;
+    return result;
+}
+
+static bool is_rect_zero(GlyphAtlas& atlas, const AtlasRect& rect)
+{
+    for (u32 y = rect.y; y < rect.y + rect.height; ++y)
+    {
+        for (u32 x = rect.x; x < rect.x + rect.width; ++x)
+        {
+            if (atlas.pixels()[(usz)y * atlas.stride() + x] != 0)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+TEST(glyph_atlas_packs_glyphs_on_shelves)
+{
+    GlyphAtlas atlas(64, 64);
+
+    // Glyphs of the same height go side by side on one shelf, with padding between them
+    AtlasRect rects[6];
+    for (u32 key = 0; key < 6; ++key)
+    {
+        AtlasGlyph* glyph = atlas.add(key, 8, 10, 1);
+        CHECK(glyph != nullptr);
+        if (glyph)
+        {
+            rects[key] = glyph->rect;
+            CHECK(glyph->shelf == 0);
+            CHECK(glyph->rect.width == 8 && glyph->rect.height == 10);
+        }
+    }
+    CHECK(rects[0].x == rects[1].x - 10 && rects[0].y == rects[1].y);
+
+    // A much shorter glyph gets a shelf of its own below the first one
+    AtlasGlyph* short_glyph = atlas.add(6, 8, 2, 1);
+    CHECK(short_glyph && short_glyph->shelf == 1 && short_glyph->rect.y > rects[0].y + rects[0].height);
+
+    // A glyph that does not fit on the rest of the first shelf starts a new one
+    AtlasGlyph* wide_glyph = atlas.add(7, 20, 10, 1);
+    CHECK(wide_glyph && wide_glyph->shelf == 2);
+
+    AtlasRect all_rects[8];
+    memcpy(all_rects, rects, sizeof(rects));
+    all_rects[6] = atlas.find(6, 1)->rect;
+    all_rects[7] = atlas.find(7, 1)->rect;
+    AtlasRect bounds = { 0, 0, atlas.width(), atlas.height() };
+    for (u32 i = 0; i < 8; ++i)
+    {
+        CHECK(rect_contains(bounds, all_rects[i]));
+        for (u32 j = i + 1; j < 8; ++j)
+        {
+            CHECK(!rects_overlap(all_rects[i], all_rects[j]));
+        }
+    }
+    CHECK(atlas.glyph_count() == 8);
+
+    // The dirty rect covers every glyph added since it was last taken
+    AtlasRect dirty_rect;
+    CHECK(atlas.take_dirty_rect(&dirty_rect));
+    for (const AtlasRect& rect : all_rects)
+    {
+        CHECK(rect_contains(dirty_rect, rect));
+    }
+    CHECK(!atlas.take_dirty_rect(&dirty_rect));
+}
+
+TEST(glyph_atlas_keeps_glyphs_without_a_bitmap_off_the_shelves)
+{
+    GlyphAtlas atlas(32, 32);
+    AtlasGlyph* space = atlas.add(' ', 0, 0, 1);
+    CHECK(space && space->shelf == GLYPH_ATLAS_NO_SHELF);
+    AtlasRect dirty_rect;
+    CHECK(!atlas.take_dirty_rect(&dirty_rect));
+    CHECK(atlas.find(' ', 2) != nullptr);
+
+    // Too large for the atlas at all
+    CHECK(atlas.add('W', 40, 8, 1) == nullptr);
+    CHECK(atlas.find('W', 1) == nullptr);
+}
+
+// 32x24 atlas with two shelves of two 14x10 glyphs each, which are 16x12 with padding
+static constexpr u32 SMALL_ATLAS_WIDTH = 32;
+static constexpr u32 SMALL_ATLAS_HEIGHT = 24;
+static constexpr u32 GLYPH_WIDTH = 14;
+static constexpr u32 GLYPH_HEIGHT = 10;
+
+TEST(glyph_atlas_evicts_the_least_recently_used_shelf)
+{
+    GlyphAtlas atlas(SMALL_ATLAS_WIDTH, SMALL_ATLAS_HEIGHT);
+    CHECK(atlas.add(1, GLYPH_WIDTH, GLYPH_HEIGHT, 1) && atlas.add(2, GLYPH_WIDTH, GLYPH_HEIGHT, 1));
+    CHECK(atlas.add(3, GLYPH_WIDTH, GLYPH_HEIGHT, 2) && atlas.add(4, GLYPH_WIDTH, GLYPH_HEIGHT, 2));
+    CHECK(atlas.generation() == 0);
+
+    // Stale pixels that the eviction has to clear
+    memset(atlas.pixels(), 0xff, (usz)atlas.stride() * atlas.height());
+
+    // Using glyph 1 in frame 3 makes the second shelf the least recently used one
+    CHECK(atlas.find(1, 3) != nullptr);
+    AtlasGlyph* glyph = atlas.add(5, GLYPH_WIDTH, GLYPH_HEIGHT, 4);
+    CHECK(glyph != nullptr);
+    if (glyph)
+    {
+        CHECK(glyph->shelf == 1);
+        AtlasRect padded = { glyph->rect.x - 1, glyph->rect.y - 1, glyph->rect.width + 2, glyph->rect.height + 2 };
+        CHECK(is_rect_zero(atlas, padded));
+    }
+    CHECK(atlas.generation() == 1);
+    CHECK(atlas.find(3, 4) == nullptr && atlas.find(4, 4) == nullptr);
+    CHECK(atlas.find(1, 4) != nullptr && atlas.find(2, 4) != nullptr);
+    CHECK(atlas.glyph_count() == 3);
+
+    // The evicted shelf has room for one more glyph, so no other shelf is evicted
+    CHECK(atlas.add(6, GLYPH_WIDTH, GLYPH_HEIGHT, 4) != nullptr);
+    CHECK(atlas.generation() == 1);
+}
+
+TEST(glyph_atlas_never_evicts_shelves_used_in_the_current_frame)
+{
+    GlyphAtlas atlas(SMALL_ATLAS_WIDTH, SMALL_ATLAS_HEIGHT);
+    for (u32 key = 1; key <= 4; ++key)
+    {
+        CHECK(atlas.add(key, GLYPH_WIDTH, GLYPH_HEIGHT, 1) != nullptr);
+    }
+
+    // Both shelves are used in frame 2, so a new glyph in frame 2 gets no space and nothing is evicted
+    CHECK(atlas.find(1, 2) != nullptr);
+    CHECK(atlas.find(3, 2) != nullptr);
+    CHECK(atlas.add(5, GLYPH_WIDTH, GLYPH_HEIGHT, 2) == nullptr);
+    CHECK(atlas.generation() == 0);
+    CHECK(atlas.glyph_count() == 4);
+
+    // Touching a shelf directly protects it too
+    atlas.touch_shelf(atlas.find(1, 2)->shelf, 3);
+    AtlasGlyph* glyph = atlas.add(5, GLYPH_WIDTH, GLYPH_HEIGHT, 3);
+    CHECK(glyph != nullptr);
+    CHECK(atlas.generation() == 1);
+    CHECK(atlas.find(1, 3) != nullptr && atlas.find(2, 3) != nullptr);
+    CHECK(atlas.find(3, 3) == nullptr);
+
+    // Now each shelf has a glyph from frame 3
+    CHECK(atlas.add(6, GLYPH_WIDTH, GLYPH_HEIGHT, 3) != nullptr);
+    CHECK(atlas.add(7, GLYPH_WIDTH, GLYPH_HEIGHT, 3) == nullptr);
+    CHECK(atlas.generation() == 1);
+}
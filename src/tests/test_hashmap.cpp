@@ -0,0 +1,285 @@
+#include "test.h"
+#include "containers/hashmap.h"
+#include "containers/string.h"
+#include "containers/string_view.h"
+#include "containers/vector.h"
+
+#include <random>
+#include <unordered_map>
+
+using namespace bstr;
+using namespace bstr::tests;
+
+// Counts live instances, so that tests see every value constructed by the map is also destroyed
+struct CountedValue
+{
+    static inline s64 live_count = 0;
+
+    u64 value{};
+
+    CountedValue(u64 value = 0) : value(value) { live_count += 1; }
+    CountedValue(const CountedValue& other) : value(other.value) { live_count += 1; }
+    CountedValue(CountedValue&& other) : value(other.value) { live_count += 1; }
+    CountedValue& operator=(const CountedValue& other) = default;
+    CountedValue& operator=(CountedValue&& other) = default;
+    ~CountedValue() { live_count -= 1; }
+};
+
+// Every key lands in the same group, so lookups have to probe past full groups and tombstones
+struct ConstantHash
+{
+    u64 operator()(u64) const { return 0; }
+};
+
+TEST(hash_map_matches_unordered_map)
+{
+    hash_map<u64, u64> map;
+    std::unordered_map<u64, u64> reference;
+    std::mt19937_64 random(1);
+    for (u32 i = 0; i < 200000; ++i)
+    {
+        // Small key range, so that inserts, hits, misses and erases of the same keys mix
+        u64 key = random() % 5000;
+        switch (random() % 4)
+        {
+        case 0:
+        case 1:
+            map[key] = i;
+            reference[key] = i;
+            break;
+        case 2:
+            CHECK(map.erase(key) == reference.erase(key));
+            break;
+        case 3:
+        {
+            auto it = map.find(key);
+            auto reference_it = reference.find(key);
+            CHECK((it == map.end()) == (reference_it == reference.end()));
+            if (it != map.end() && reference_it != reference.end())
+            {
+                CHECK(it->second == reference_it->second);
+            }
+            break;
+        }
+        }
+        CHECK(map.size() == reference.size());
+    }
+
+    usz visited = 0;
+    for (const auto& [key, value] : map)
+    {
+        auto reference_it = reference.find(key);
+        CHECK(reference_it != reference.end() && reference_it->second == value);
+        visited += 1;
+    }
+    CHECK(visited == reference.size());
+}
+
+TEST(hash_map_probes_past_full_groups)
+{
+    hash_map<u64, u64, ConstantHash> map;
+    for (u64 key = 0; key < 100; ++key)
+    {
+        map[key] = key * 2;
+    }
+    for (u64 key = 0; key < 100; key += 2)
+    {
+        CHECK(map.erase(key) == 1);
+    }
+    for (u64 key = 0; key < 100; ++key)
+    {
+        auto it = map.find(key);
+        CHECK((it != map.end()) == (key % 2 == 1));
+        if (it != map.end())
+        {
+            CHECK(it->second == key * 2);
+        }
+    }
+    CHECK(map.find(1000) == map.end());
+    CHECK(map.size() == 50);
+}
+
+TEST(hash_map_finds_strings_by_string_view)
+{
+    hash_map<string, u32> map;
+    map["apple"] = 1;
+    map["banana"] = 2;
+    map[string(1000, 'x')] = 3;
+
+    // Heterogeneous lookups do not make a string
+    string_view banana = "banana";
+    CHECK(map.contains(banana));
+    CHECK(map.find(banana)->second == 2);
+    CHECK(map.find("apple")->second == 1);
+    CHECK(map.find(string_view("cherry")) == map.end());
+    CHECK(map.find(string(1000, 'x'))->second == 3);
+    CHECK(map.erase(string_view("apple")) == 1);
+    CHECK(!map.contains(string_view("apple")));
+    CHECK(map.size() == 2);
+}
+
+TEST(hash_map_try_emplace_keeps_existing_value)
+{
+    hash_map<u32, string> map;
+    auto first = map.try_emplace(7u, "first");
+    CHECK(first.second);
+    auto second = map.try_emplace(7u, "second");
+    CHECK(!second.second);
+    CHECK(second.first->second == "first");
+    CHECK(map.size() == 1);
+}
+
+TEST(hash_map_erase_while_iterating)
+{
+    hash_map<u32, u32> map;
+    for (u32 i = 0; i < 1000; ++i)
+    {
+        map[i] = i;
+    }
+    for (auto it = map.begin(); it != map.end();)
+    {
+        if (it->first % 3 == 0)
+        {
+            it = map.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    CHECK(map.size() == 666);
+    for (u32 i = 0; i < 1000; ++i)
+    {
+        CHECK(map.contains(i) == (i % 3 != 0));
+    }
+}
+
+TEST(hash_map_copy_and_move)
+{
+    hash_map<u32, string> map = { { 1, "one" }, { 2, "two" }, { 3, "three" } };
+    hash_map<u32, string> copy = map;
+    CHECK(copy.size() == 3 && copy.find(2)->second == "two");
+    copy[4] = "four";
+    CHECK(map.size() == 3);
+
+    hash_map<u32, string> moved = move(copy);
+    CHECK(moved.size() == 4 && moved.find(4)->second == "four");
+    CHECK(copy.empty());
+
+    copy = moved;
+    CHECK(copy.size() == 4 && copy.find(1)->second == "one");
+}
+
+TEST(hash_map_destroys_every_value)
+{
+    CountedValue::live_count = 0;
+    {
+        hash_map<u64, CountedValue> map;
+        for (u64 i = 0; i < 1000; ++i)
+        {
+            map.try_emplace(i, i);
+        }
+        for (u64 i = 0; i < 1000; i += 4)
+        {
+            map.erase(i);
+        }
+        CHECK(CountedValue::live_count == 750);
+
+        map.clear();
+        CHECK(CountedValue::live_count == 0);
+        CHECK(map.empty());
+
+        // Still usable after clear, without growing again
+        usz capacity = map.capacity();
+        for (u64 i = 0; i < 500; ++i)
+        {
+            map.try_emplace(i, i);
+        }
+        CHECK(map.capacity() == capacity);
+        CHECK(CountedValue::live_count == 500);
+    }
+    CHECK(CountedValue::live_count == 0);
+}
+
+TEST(hash_map_reserve_does_not_grow_while_filling)
+{
+    hash_map<u64, u64> map;
+    map.reserve(10000);
+    usz capacity = map.capacity();
+    for (u64 i = 0; i < 10000; ++i)
+    {
+        map[i] = i;
+    }
+    CHECK(map.capacity() == capacity);
+}
+
+template<typename Map>
+static void benchmark_map(const char* name, const vector<u64>& keys, const vector<u64>& missing_keys)
+{
+    usz count = keys.size();
+    string label;
+
+    label = string(name) + " insert";
+    run_benchmark(label.c_str(), count, [&] {
+        Map map;
+        for (u64 key : keys)
+        {
+            map[key] = key;
+        }
+        do_not_optimize(map.size());
+    });
+
+    Map map;
+    for (u64 key : keys)
+    {
+        map[key] = key;
+    }
+
+    label = string(name) + " find hit";
+    run_benchmark(label.c_str(), count, [&] {
+        u64 sum = 0;
+        for (u64 key : keys)
+        {
+            sum += map.find(key)->second;
+        }
+        do_not_optimize(sum);
+    });
+
+    label = string(name) + " find miss";
+    run_benchmark(label.c_str(), count, [&] {
+        usz found = 0;
+        for (u64 key : missing_keys)
+        {
+            found += map.find(key) != map.end();
+        }
+        do_not_optimize(found);
+    });
+
+    label = string(name) + " erase";
+    run_benchmark(label.c_str(), count, [&] {
+        Map erased = map;
+        for (u64 key : keys)
+        {
+            erased.erase(key);
+        }
+        do_not_optimize(erased.size());
+    });
+}
+
+BENCHMARK(hash_map_against_unordered_map)
+{
+    // Erase includes copying the map, the copy is the same for both
+    static constexpr usz KEY_COUNT = 100000;
+    std::mt19937_64 random(1);
+    vector<u64> keys(KEY_COUNT);
+    vector<u64> missing_keys(KEY_COUNT);
+    for (usz i = 0; i < KEY_COUNT; ++i)
+    {
+        // Even keys are in the map, odd ones are not
+        keys[i] = random() & ~1ull;
+        missing_keys[i] = random() | 1;
+    }
+
+    benchmark_map<hash_map<u64, u64>>("hash_map", keys, missing_keys);
+    benchmark_map<std::unordered_map<u64, u64>>("std::unordered_map", keys, missing_keys);
+}
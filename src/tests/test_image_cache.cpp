@@ -0,0 +1,194 @@
+#include "test.h"
+#include "image_cache.h"
+#include "image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+using namespace bstr;
+using namespace bstr::core;
+using namespace bstr::tests;
+
+namespace fs = std::filesystem;
+
+static constexpr u32 IMAGE_WIDTH = 16;
+static constexpr u32 IMAGE_HEIGHT = 8;
+static constexpr u32 IMAGE_FLAGS = ImageCacheFlags_Premultiplied;
+
+// An empty directory for the cache and the sources of one test
+static fs::path make_test_directory(const char* name)
+{
+    fs::path result = fs::temp_directory_path() / "bstr_test_image_cache" / name;
+    fs::remove_all(result);
+    fs::create_directories(result);
+    return result;
+}
+
+static vector<u8> write_source(const fs::path& filename, const char* contents)
+{
+    vector<u8> result(contents, contents + strlen(contents));
+    FILE* file = fopen(filename.string().c_str(), "wb");
+    if (file)
+    {
+        fwrite(result.data(), 1, result.size(), file);
+        fclose(file);
+    }
+    return result;
+}
+
+static vector<u8> make_pixels()
+{
+    vector<u8> result(get_mip_chain_size(BlockCompression_None, IMAGE_WIDTH, IMAGE_HEIGHT, 1));
+    for (usz i = 0; i < result.size(); ++i)
+    {
+        result[i] = (u8)(i / 7);
+    }
+    return result;
+}
+
+static u32 count_files(const fs::path& directory, const char* extension)
+{
+    u32 result = 0;
+    for (const fs::directory_entry& entry : fs::directory_iterator(directory))
+    {
+        if (entry.path().extension() == extension)
+        {
+            ++result;
+        }
+    }
+    return result;
+}
+
+static bool load_matches(const ImageCache& cache, const fs::path& source, u32 flags, const vector<u8>& pixels)
+{
+    CachedImage image;
+    if (!cache.load(source.string().c_str(), flags, BlockCompression_None, &image))
+    {
+        return false;
+    }
+    bool result = image.width() == IMAGE_WIDTH && image.height() == IMAGE_HEIGHT && image.mip_count() == 1
+        && memcmp(image.pixels(), pixels.data(), pixels.size()) == 0;
+    return result;
+}
+
+TEST(image_cache_round_trips_with_and_without_zlib)
+{
+    fs::path directory = make_test_directory("round_trip");
+    ImageCache cache((directory / "cache").string());
+    vector<u8> pixels = make_pixels();
+
+    fs::path raw_source = directory / "raw.png";
+    vector<u8> raw_data = write_source(raw_source, "raw source");
+    CHECK(!load_matches(cache, raw_source, IMAGE_FLAGS, pixels));
+    cache.store(raw_source.string().c_str(), raw_data, pixels.data(), IMAGE_WIDTH, IMAGE_HEIGHT, IMAGE_FLAGS, BlockCompression_None);
+    CHECK(load_matches(cache, raw_source, IMAGE_FLAGS, pixels));
+
+    fs::path zlib_source = directory / "zlib.png";
+    vector<u8> zlib_data = write_source(zlib_source, "zlib source");
+    cache.store(zlib_source.string().c_str(), zlib_data, pixels.data(), IMAGE_WIDTH, IMAGE_HEIGHT,
+        IMAGE_FLAGS | ImageCacheFlags_Zlib, BlockCompression_None);
+    CHECK(load_matches(cache, zlib_source, IMAGE_FLAGS | ImageCacheFlags_Zlib, pixels));
+
+    // How the pixels are stored does not matter to the loader
+    CHECK(load_matches(cache, zlib_source, IMAGE_FLAGS, pixels));
+    CHECK(load_matches(cache, raw_source, IMAGE_FLAGS | ImageCacheFlags_Zlib, pixels));
+
+    // The other flags do
+    CHECK(!load_matches(cache, raw_source, IMAGE_FLAGS | ImageCacheFlags_Mipmapped, pixels));
+    CHECK(!load_matches(cache, raw_source, ImageCacheFlags_None, pixels));
+
+    // The repeating pixels compress well
+    uintmax_t image_sizes[2] = {};
+    u32 image_count = 0;
+    for (const fs::directory_entry& entry : fs::directory_iterator(directory / "cache"))
+    {
+        if (entry.path().extension() == ".image" && image_count < 2)
+        {
+            image_sizes[image_count++] = entry.file_size();
+        }
+    }
+    CHECK(image_count == 2);
+    CHECK(image_sizes[0] != image_sizes[1]);
+    CHECK(std::min(image_sizes[0], image_sizes[1]) < sizeof(ImageCacheHeader) + pixels.size() / 2);
+}
+
+TEST(image_cache_shares_image_files_between_sources_with_the_same_contents)
+{
+    fs::path directory = make_test_directory("shared");
+    ImageCache cache((directory / "cache").string());
+    vector<u8> pixels = make_pixels();
+
+    fs::path source = directory / "a.png";
+    fs::path copy = directory / "b.png";
+    vector<u8> data = write_source(source, "same contents");
+    write_source(copy, "same contents");
+
+    cache.store(source.string().c_str(), data, pixels.data(), IMAGE_WIDTH, IMAGE_HEIGHT, IMAGE_FLAGS, BlockCompression_None);
+    CHECK(load_matches(cache, copy, IMAGE_FLAGS, pixels));
+    CHECK(count_files(directory / "cache", ".image") == 1);
+    CHECK(count_files(directory / "cache", ".index") == 2);
+}
+
+TEST(image_cache_misses_after_the_source_is_edited)
+{
+    fs::path directory = make_test_directory("edited");
+    ImageCache cache((directory / "cache").string());
+    vector<u8> pixels = make_pixels();
+
+    fs::path source = directory / "a.png";
+    vector<u8> data = write_source(source, "first contents");
+    cache.store(source.string().c_str(), data, pixels.data(), IMAGE_WIDTH, IMAGE_HEIGHT, IMAGE_FLAGS, BlockCompression_None);
+    CHECK(load_matches(cache, source, IMAGE_FLAGS, pixels));
+
+    // An edit of the same size, only the modify time sends the load on to hash the contents
+    fs::file_time_type modify_time = fs::last_write_time(source);
+    write_source(source, "other contents");
+    fs::last_write_time(source, modify_time + std::chrono::seconds(1));
+    CHECK(!load_matches(cache, source, IMAGE_FLAGS, pixels));
+
+    // Restoring the contents finds the first image file again
+    write_source(source, "first contents");
+    CHECK(load_matches(cache, source, IMAGE_FLAGS, pixels));
+}
+
+TEST(image_cache_hits_when_only_the_modify_time_changes)
+{
+    fs::path directory = make_test_directory("touched");
+    ImageCache cache((directory / "cache").string());
+    vector<u8> pixels = make_pixels();
+
+    fs::path source = directory / "a.png";
+    vector<u8> data = write_source(source, "contents");
+    cache.store(source.string().c_str(), data, pixels.data(), IMAGE_WIDTH, IMAGE_HEIGHT, IMAGE_FLAGS, BlockCompression_None);
+
+    fs::path index_filename;
+    for (const fs::directory_entry& entry : fs::directory_iterator(directory / "cache"))
+    {
+        if (entry.path().extension() == ".index")
+        {
+            index_filename = entry.path();
+        }
+    }
+    CHECK(!index_filename.empty());
+    if (index_filename.empty())
+    {
+        return;
+    }
+
+    // Like after a fresh checkout, the contents are hashed again and the index is updated to the new time
+    fs::last_write_time(source, fs::last_write_time(source) + std::chrono::hours(1));
+    CHECK(load_matches(cache, source, IMAGE_FLAGS, pixels));
+
+    ImageCacheIndexEntry entry = {};
+    FILE* file = fopen(index_filename.string().c_str(), "rb");
+    CHECK(file != nullptr);
+    if (file)
+    {
+        CHECK(fread(&entry, sizeof(entry), 1, file) == 1);
+        fclose(file);
+    }
+    CHECK(entry.source_modify_time == platform::get_file_modify_time(source.string().c_str()));
+}
@@ -0,0 +1,91 @@
+#include "test.h"
+#include "instance_ring.h"
+
+using namespace bstr;
+using namespace bstr::renderer;
+using namespace bstr::tests;
+
+TEST(instance_ring_discards_on_first_use_only)
+{
+    InstanceRingAllocator ring(100, 48);
+    InstanceRingAllocation allocation;
+    CHECK(ring.allocate(10, &allocation));
+    CHECK(allocation.needs_discard);
+    CHECK(allocation.first_instance == 0 && allocation.byte_offset == 0);
+
+    CHECK(ring.allocate(20, &allocation));
+    CHECK(!allocation.needs_discard);
+    CHECK(allocation.first_instance == 10 && allocation.byte_offset == 10 * 48);
+    CHECK(ring.head() == 30);
+    CHECK(ring.wrap_count() == 0);
+}
+
+TEST(instance_ring_wraps_when_allocation_does_not_fit)
+{
+    InstanceRingAllocator ring(100, 16);
+    InstanceRingAllocation allocation;
+    CHECK(ring.allocate(60, &allocation));
+
+    // Exactly filling the buffer does not wrap
+    CHECK(ring.allocate(40, &allocation));
+    CHECK(!allocation.needs_discard && allocation.first_instance == 60);
+    CHECK(ring.head() == 100);
+
+    CHECK(ring.allocate(1, &allocation));
+    CHECK(allocation.needs_discard);
+    CHECK(allocation.first_instance == 0 && allocation.byte_offset == 0);
+    CHECK(ring.wrap_count() == 1);
+    CHECK(ring.head() == 1);
+
+    CHECK(ring.allocate(1, &allocation));
+    CHECK(!allocation.needs_discard && allocation.first_instance == 1);
+}
+
+TEST(instance_ring_rejects_empty_and_too_large)
+{
+    InstanceRingAllocator ring(100, 16);
+    InstanceRingAllocation allocation;
+    CHECK(!ring.allocate(0, &allocation));
+    CHECK(!ring.allocate(101, &allocation));
+    CHECK(ring.head() == 0);
+
+    // A rejected allocation does not use up the first discard
+    CHECK(ring.allocate(100, &allocation));
+    CHECK(allocation.needs_discard);
+}
+
+TEST(instance_ring_allocations_never_overlap_between_wraps)
+{
+    InstanceRingAllocator ring(1000, 48);
+    InstanceRingAllocation allocation;
+    usz expected_head = 0;
+    for (usz i = 0; i < 10000; ++i)
+    {
+        usz count = 1 + (i * 7919) % 97;
+        CHECK(ring.allocate(count, &allocation));
+        if (expected_head + count > ring.capacity())
+        {
+            CHECK(allocation.needs_discard);
+            expected_head = 0;
+        }
+        CHECK(allocation.first_instance == expected_head);
+        CHECK(allocation.byte_offset == expected_head * ring.stride());
+        CHECK(allocation.first_instance + count <= ring.capacity());
+        expected_head += count;
+    }
+}
+
+BENCHMARK(instance_ring_allocate)
+{
+    // Mostly small batches, like glyph runs between sprites, in a ring the size of the renderer's
+    static constexpr usz ALLOCATION_COUNT = 64 * 1024;
+    InstanceRingAllocator ring(128 * 1024, 48);
+    run_benchmark("allocate 1-16 instances", ALLOCATION_COUNT, [&] {
+        InstanceRingAllocation allocation;
+        for (usz i = 0; i < ALLOCATION_COUNT; ++i)
+        {
+            ring.allocate(1 + (i & 15), &allocation);
+        }
+        do_not_optimize(allocation);
+    });
+}
@@ -0,0 +1,153 @@
+#include "test.h"
+#include "jobs.h"
+#include "containers/vector.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+using namespace bstr;
+using namespace bstr::core;
+using namespace bstr::tests;
+
+TEST(jobs_run_every_job_once)
+{
+    JobSystem job_system(3);
+    std::atomic<u64> sum{};
+    JobCounter counter;
+    for (u64 i = 1; i <= 10000; ++i)
+    {
+        job_system.run(&counter, [&sum, i] { sum.fetch_add(i, std::memory_order_relaxed); });
+    }
+    job_system.wait(counter);
+    CHECK(counter.is_done());
+    CHECK(sum.load() == 10000ull * 10001 / 2);
+}
+
+TEST(jobs_wait_inside_jobs)
+{
+    // Every job waits for jobs of its own, which only finishes if waiting runs other jobs
+    JobSystem job_system(2);
+    std::atomic<u32> leaf_count{};
+    JobCounter counter;
+    for (u32 i = 0; i < 64; ++i)
+    {
+        job_system.run(&counter, [&job_system, &leaf_count] {
+            JobCounter inner_counter;
+            for (u32 j = 0; j < 64; ++j)
+            {
+                job_system.run(&inner_counter, [&leaf_count] { leaf_count.fetch_add(1, std::memory_order_relaxed); });
+            }
+            job_system.wait(inner_counter);
+        });
+    }
+    job_system.wait(counter);
+    CHECK(leaf_count.load() == 64 * 64);
+}
+
+TEST(jobs_run_from_other_threads)
+{
+    JobSystem job_system(2);
+    std::atomic<u32> run_count{};
+    JobCounter counter;
+    vector<std::thread> threads;
+    for (u32 i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([&] {
+            for (u32 j = 0; j < 1000; ++j)
+            {
+                job_system.run(&counter, [&run_count] { run_count.fetch_add(1, std::memory_order_relaxed); });
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    job_system.wait(counter);
+    CHECK(run_count.load() == 4000);
+}
+
+TEST(jobs_run_on_worker_never_runs_on_creating_thread)
+{
+    JobSystem job_system(2);
+    std::thread::id creating_thread = std::this_thread::get_id();
+    std::atomic<u32> on_creating_thread{};
+    std::atomic<u32> run_count{};
+    JobCounter counter;
+    for (u32 i = 0; i < 1000; ++i)
+    {
+        job_system.run_on_worker(&counter, [&, creating_thread] {
+            on_creating_thread.fetch_add(std::this_thread::get_id() == creating_thread, std::memory_order_relaxed);
+            run_count.fetch_add(1, std::memory_order_relaxed);
+        });
+    }
+    // The creating thread runs jobs while it waits, but not these
+    job_system.wait(counter);
+    CHECK(run_count.load() == 1000);
+    CHECK(on_creating_thread.load() == 0);
+}
+
+TEST(parallel_for_covers_every_index_once)
+{
+    JobSystem job_system(3);
+    for (usz count : { (usz)0, (usz)1, (usz)63, (usz)64, (usz)65, (usz)10007 })
+    {
+        vector<std::atomic<u32>> visits(count);
+        parallel_for(job_system, count, 64, [&](usz begin, usz end) {
+            CHECK(begin < end && end - begin <= 64 && end <= count);
+            for (usz i = begin; i < end; ++i)
+            {
+                visits[i].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        for (usz i = 0; i < count; ++i)
+        {
+            CHECK(visits[i].load() == 1);
+        }
+    }
+}
+
+BENCHMARK(jobs_scaling)
+{
+    // The same work with more and more workers, the rate should grow with them up to the core count
+    static constexpr usz VALUE_COUNT = 4 * 1024 * 1024;
+    static constexpr usz GRAIN_SIZE = 16 * 1024;
+    vector<f32> values(VALUE_COUNT);
+    for (usz i = 0; i < VALUE_COUNT; ++i)
+    {
+        values[i] = (f32)(i % 1000) * 0.001f;
+    }
+
+    u32 max_worker_count = max(std::thread::hardware_concurrency(), 2u) - 1;
+    for (u32 worker_count = 0; worker_count <= max_worker_count; worker_count = max(worker_count * 2, 1u))
+    {
+        JobSystem job_system(worker_count);
+        char label[64];
+        snprintf(label, sizeof(label), "parallel_for %u workers", worker_count);
+        run_benchmark(label, VALUE_COUNT, [&] {
+            std::atomic<u64> checksum{};
+            parallel_for(job_system, VALUE_COUNT, GRAIN_SIZE, [&](usz begin, usz end) {
+                f32 sum = 0;
+                for (usz i = begin; i < end; ++i)
+                {
+                    sum += sqrtf(values[i]) * values[i];
+                }
+                checksum.fetch_add((u64)sum, std::memory_order_relaxed);
+            });
+            do_not_optimize(checksum.load());
+        });
+
+        // Cost of a job itself, with nothing to do in it
+        snprintf(label, sizeof(label), "empty jobs %u workers", worker_count);
+        run_benchmark(label, 10000, [&] {
+            JobCounter counter;
+            for (u32 i = 0; i < 10000; ++i)
+            {
+                job_system.run(&counter, [] {});
+            }
+            job_system.wait(counter);
+        });
+    }
+}
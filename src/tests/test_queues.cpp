@@ -0,0 +1,222 @@
+#include "test.h"
+#include "containers/mpmc_queue.h"
+#include "containers/spsc_queue.h"
+#include "containers/string.h"
+#include "containers/vector.h"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+using namespace bstr;
+using namespace bstr::tests;
+
+// Not trivially copyable, counts live instances, so that tests see values left in a queue are destroyed with it
+struct QueuedValue
+{
+    static inline std::atomic<s64> live_count{};
+
+    u64 value{};
+    string text;
+
+    QueuedValue(u64 value = 0) : value(value), text(32, 'q') { live_count += 1; }
+    QueuedValue(const QueuedValue& other) : value(other.value), text(other.text) { live_count += 1; }
+    QueuedValue(QueuedValue&& other) : value(other.value), text(move(other.text)) { live_count += 1; }
+    QueuedValue& operator=(const QueuedValue& other) = default;
+    QueuedValue& operator=(QueuedValue&& other) = default;
+    ~QueuedValue() { live_count -= 1; }
+};
+
+template<typename Queue>
+static void check_fifo_and_full(Queue& queue)
+{
+    CHECK(queue.capacity() == 8);
+    CHECK(queue.empty());
+    for (u64 i = 0; i < 8; ++i)
+    {
+        CHECK(queue.try_push(i));
+    }
+    CHECK(!queue.try_push(100));
+
+    // Wraps around a few times, so that every slot is reused on a later lap
+    u64 value = 0;
+    for (u64 i = 0; i < 100; ++i)
+    {
+        CHECK(queue.try_pop(&value) && value == i);
+        CHECK(queue.try_push(i + 8));
+        CHECK(!queue.try_push(100));
+    }
+    for (u64 i = 100; i < 108; ++i)
+    {
+        CHECK(queue.try_pop(&value) && value == i);
+    }
+    CHECK(!queue.try_pop(&value));
+    CHECK(queue.empty());
+}
+
+TEST(spsc_queue_is_fifo_and_bounded)
+{
+    // Capacity is rounded up to a power of two
+    spsc_queue<u64> queue(5);
+    check_fifo_and_full(queue);
+}
+
+TEST(mpmc_queue_is_fifo_and_bounded)
+{
+    mpmc_queue<u64> queue(8);
+    check_fifo_and_full(queue);
+}
+
+TEST(queues_destroy_values_left_in_them)
+{
+    QueuedValue::live_count = 0;
+    {
+        spsc_queue<QueuedValue> spsc(16);
+        mpmc_queue<QueuedValue> mpmc(16);
+        for (u64 i = 0; i < 10; ++i)
+        {
+            spsc.try_emplace(i);
+            mpmc.try_emplace(i);
+        }
+        QueuedValue value;
+        CHECK(spsc.try_pop(&value) && value.value == 0 && value.text.size() == 32);
+        CHECK(mpmc.try_pop(&value) && value.value == 0 && value.text.size() == 32);
+        CHECK(QueuedValue::live_count == 19);
+    }
+    CHECK(QueuedValue::live_count == 0);
+}
+
+TEST(spsc_queue_keeps_order_between_threads)
+{
+    // Small queue, so that both sides keep running into a full and an empty queue
+    static constexpr u64 VALUE_COUNT = 200000;
+    spsc_queue<u64> queue(16);
+    std::thread producer([&] {
+        for (u64 i = 0; i < VALUE_COUNT; ++i)
+        {
+            queue.push(move(i));
+        }
+    });
+
+    bool in_order = true;
+    u64 value = 0;
+    for (u64 i = 0; i < VALUE_COUNT; ++i)
+    {
+        queue.pop(&value);
+        in_order = in_order && value == i;
+    }
+    producer.join();
+    CHECK(in_order);
+    CHECK(queue.empty());
+}
+
+TEST(mpmc_queue_delivers_every_value_once)
+{
+    static constexpr u32 PRODUCER_COUNT = 4;
+    static constexpr u32 CONSUMER_COUNT = 4;
+    static constexpr u64 VALUES_PER_PRODUCER = 50000;
+    mpmc_queue<u64> queue(64);
+
+    // Values are unique across producers. Every consumer checks that the values of each producer arrive in order.
+    std::atomic<u64> sum{};
+    std::atomic<u64> popped_count{};
+    std::atomic<u32> out_of_order_count{};
+    vector<std::thread> threads;
+    for (u32 p = 0; p < PRODUCER_COUNT; ++p)
+    {
+        threads.emplace_back([&, p] {
+            for (u64 i = 0; i < VALUES_PER_PRODUCER; ++i)
+            {
+                queue.push(p * VALUES_PER_PRODUCER + i);
+            }
+        });
+    }
+    for (u32 c = 0; c < CONSUMER_COUNT; ++c)
+    {
+        threads.emplace_back([&] {
+            u64 last_values[PRODUCER_COUNT];
+            bool has_last_value[PRODUCER_COUNT] = {};
+            u64 value = 0;
+            while (popped_count.fetch_add(1, std::memory_order_relaxed) < PRODUCER_COUNT * VALUES_PER_PRODUCER)
+            {
+                queue.pop(&value);
+                u64 producer = value / VALUES_PER_PRODUCER;
+                if (has_last_value[producer] && value <= last_values[producer])
+                {
+                    out_of_order_count.fetch_add(1, std::memory_order_relaxed);
+                }
+                last_values[producer] = value;
+                has_last_value[producer] = true;
+                sum.fetch_add(value, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    u64 value_count = PRODUCER_COUNT * VALUES_PER_PRODUCER;
+    CHECK(sum.load() == value_count * (value_count - 1) / 2);
+    CHECK(out_of_order_count.load() == 0);
+    CHECK(queue.empty());
+}
+
+BENCHMARK(queues_under_contention)
+{
+    static constexpr u64 VALUES_PER_CALL = 200000;
+
+    run_benchmark("spsc_queue 1 producer", VALUES_PER_CALL, [] {
+        spsc_queue<u64> queue(1024);
+        std::thread producer([&] {
+            for (u64 i = 0; i < VALUES_PER_CALL; ++i)
+            {
+                queue.push(move(i));
+            }
+        });
+        u64 value = 0;
+        u64 sum = 0;
+        for (u64 i = 0; i < VALUES_PER_CALL; ++i)
+        {
+            queue.pop(&value);
+            sum += value;
+        }
+        producer.join();
+        do_not_optimize(sum);
+    });
+
+    // One consumer, like the queues that hand results back to the main thread
+    u32 max_producer_count = max(std::thread::hardware_concurrency(), 2u) - 1;
+    for (u32 producer_count = 1; producer_count <= max_producer_count; producer_count *= 2)
+    {
+        char label[64];
+        snprintf(label, sizeof(label), "mpmc_queue %u producers", producer_count);
+        run_benchmark(label, VALUES_PER_CALL, [producer_count] {
+            mpmc_queue<u64> queue(1024);
+            vector<std::thread> producers;
+            for (u32 p = 0; p < producer_count; ++p)
+            {
+                u64 begin = VALUES_PER_CALL * p / producer_count;
+                u64 end = VALUES_PER_CALL * (p + 1) / producer_count;
+                producers.emplace_back([&queue, begin, end] {
+                    for (u64 i = begin; i < end; ++i)
+                    {
+                        queue.push(move(i));
+                    }
+                });
+            }
+            u64 value = 0;
+            u64 sum = 0;
+            for (u64 i = 0; i < VALUES_PER_CALL; ++i)
+            {
+                queue.pop(&value);
+                sum += value;
+            }
+            for (std::thread& producer : producers)
+            {
+                producer.join();
+            }
+            do_not_optimize(sum);
+        });
+    }
+}
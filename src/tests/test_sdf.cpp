@@ -0,0 +1,92 @@
+#include "test.h"
+#include "sdf.h"
+
+#include <cmath>
+
+using namespace bstr;
+using namespace bstr::renderer;
+using namespace bstr::tests;
+
+static constexpr u32 FIELD_WIDTH = 16;
+static constexpr u32 FIELD_HEIGHT = 4;
+// Wider than the field, the padding is filled with garbage that must never be read
+static constexpr u32 FIELD_STRIDE = 20;
+// Texels left of this x are inside the glyph
+static constexpr f32 EDGE_X = 8.f;
+
+// Distance field of a vertical edge, encoded like stbtt_GetGlyphSDF encodes it
+static void make_edge_field(u8 out_field[FIELD_STRIDE * FIELD_HEIGHT])
+{
+    for (u32 y = 0; y < FIELD_HEIGHT; ++y)
+    {
+        for (u32 x = 0; x < FIELD_STRIDE; ++x)
+        {
+            f32 distance_inside = EDGE_X - ((f32)x + 0.5f);
+            f32 value = (f32)SDF_ONEDGE_VALUE + distance_inside * SDF_PIXEL_DIST_SCALE;
+            value = value < 0 ? 0 : value > 255 ? 255 : value;
+            out_field[y * FIELD_STRIDE + x] = x < FIELD_WIDTH ? (u8)(value + 0.5f) : 0xcd;
+        }
+    }
+}
+
+static f32 sample_edge(const u8* field, f32 x, f32 screen_pixel_in_texels)
+{
+    f32 result = sample_sdf_coverage(field, FIELD_WIDTH, FIELD_HEIGHT, FIELD_STRIDE, x, 2.f, screen_pixel_in_texels);
+    return result;
+}
+
+TEST(sdf_coverage_is_half_on_the_edge)
+{
+    u8 field[FIELD_STRIDE * FIELD_HEIGHT];
+    make_edge_field(field);
+    CHECK(fabsf(sample_edge(field, EDGE_X, 1.f) - 0.5f) < 0.02f);
+    CHECK(fabsf(sample_edge(field, EDGE_X, 0.25f) - 0.5f) < 0.02f);
+}
+
+TEST(sdf_coverage_is_full_inside_and_empty_outside)
+{
+    u8 field[FIELD_STRIDE * FIELD_HEIGHT];
+    make_edge_field(field);
+    CHECK(sample_edge(field, EDGE_X - 2.f, 1.f) == 1.f);
+    CHECK(sample_edge(field, EDGE_X + 2.f, 1.f) == 0.f);
+}
+
+TEST(sdf_coverage_falls_across_the_edge)
+{
+    u8 field[FIELD_STRIDE * FIELD_HEIGHT];
+    make_edge_field(field);
+    f32 previous = 1.f;
+    for (f32 x = EDGE_X - 1.5f; x <= EDGE_X + 1.5f; x += 0.125f)
+    {
+        f32 coverage = sample_edge(field, x, 1.f);
+        CHECK(coverage <= previous);
+        previous = coverage;
+    }
+}
+
+TEST(sdf_edge_is_one_screen_pixel_wide_at_any_scale)
+{
+    // Magnified a lot, a quarter of a screen pixel from the edge is already solid
+    u8 field[FIELD_STRIDE * FIELD_HEIGHT];
+    make_edge_field(field);
+    f32 magnified = 1.f / 16.f;
+    CHECK(sample_edge(field, EDGE_X - 0.25f, magnified) > 0.99f);
+    CHECK(sample_edge(field, EDGE_X + 0.25f, magnified) < 0.01f);
+
+    // Minified, the same distance in texels is only part of a screen pixel and stays blended
+    f32 minified = 4.f;
+    f32 inside = sample_edge(field, EDGE_X - 0.25f, minified);
+    f32 outside = sample_edge(field, EDGE_X + 0.25f, minified);
+    CHECK(inside > 0.5f && inside < 0.75f);
+    CHECK(outside < 0.5f && outside > 0.25f);
+}
+
+TEST(sdf_samples_outside_the_field_are_clamped)
+{
+    u8 field[FIELD_STRIDE * FIELD_HEIGHT];
+    make_edge_field(field);
+    CHECK(sample_edge(field, -10.f, 1.f) == sample_edge(field, 0.5f, 1.f));
+    CHECK(sample_edge(field, (f32)FIELD_WIDTH + 10.f, 1.f) == sample_edge(field, (f32)FIELD_WIDTH - 0.5f, 1.f));
+    f32 below = sample_sdf_coverage(field, FIELD_WIDTH, FIELD_HEIGHT, FIELD_STRIDE, EDGE_X, 100.f, 1.f);
+    CHECK(below == sample_edge(field, EDGE_X, 1.f));
+}
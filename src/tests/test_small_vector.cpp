@@ -0,0 +1,243 @@
+#include "test.h"
+#include "containers/fixed_vector.h"
+#include "containers/small_vector.h"
+#include "containers/span.h"
+#include "containers/string.h"
+#include "containers/vector.h"
+
+#include <random>
+
+using namespace bstr;
+using namespace bstr::tests;
+
+// Not trivially copyable, so it relocates by moving. Counts live instances, so that tests see every element
+// constructed by a container is also destroyed.
+struct TrackedValue
+{
+    static inline s64 live_count = 0;
+
+    u32 value{};
+    string text;
+
+    TrackedValue(u32 value = 0) : value(value), text(64, (char)('a' + value % 26)) { live_count += 1; }
+    TrackedValue(const TrackedValue& other) : value(other.value), text(other.text) { live_count += 1; }
+    TrackedValue(TrackedValue&& other) : value(other.value), text(move(other.text)) { live_count += 1; }
+    TrackedValue& operator=(const TrackedValue& other) = default;
+    TrackedValue& operator=(TrackedValue&& other) = default;
+    ~TrackedValue() { live_count -= 1; }
+
+    bool is_valid(u32 expected) const { return value == expected && text == string(64, (char)('a' + expected % 26)); }
+};
+
+static u32 sum_values(span<const u32> values)
+{
+    u32 result = 0;
+    for (u32 value : values)
+    {
+        result += value;
+    }
+    return result;
+}
+
+TEST(small_vector_grows_from_inline_to_heap)
+{
+    small_vector<u32, 4> values;
+    CHECK(values.is_inline() && values.capacity() == 4);
+    for (u32 i = 0; i < 4; ++i)
+    {
+        values.push_back(i);
+    }
+    CHECK(values.is_inline());
+
+    values.push_back(4);
+    CHECK(!values.is_inline() && values.capacity() >= 5);
+    for (u32 i = 5; i < 100; ++i)
+    {
+        values.push_back(i);
+    }
+    CHECK(values.size() == 100);
+    for (u32 i = 0; i < 100; ++i)
+    {
+        CHECK(values[i] == i);
+    }
+
+    // Clear keeps the heap memory
+    usz capacity = values.capacity();
+    values.clear();
+    CHECK(values.empty() && values.capacity() == capacity && !values.is_inline());
+}
+
+TEST(small_vector_relocates_non_trivial_elements)
+{
+    TrackedValue::live_count = 0;
+    {
+        small_vector<TrackedValue, 3> values;
+        for (u32 i = 0; i < 50; ++i)
+        {
+            values.emplace_back(i);
+            CHECK(TrackedValue::live_count == (s64)values.size());
+        }
+        for (u32 i = 0; i < 50; ++i)
+        {
+            CHECK(values[i].is_valid(i));
+        }
+
+        // Erase keeps the order of the rest
+        values.erase(values.begin() + 10);
+        CHECK(values.size() == 49 && values[10].is_valid(11) && values.back().is_valid(49));
+        values.pop_back();
+        values.resize(10);
+        CHECK(TrackedValue::live_count == 10);
+    }
+    CHECK(TrackedValue::live_count == 0);
+}
+
+TEST(small_vector_push_back_of_own_element_while_growing)
+{
+    // The argument refers to an element that moves when the vector grows
+    small_vector<TrackedValue, 2> values;
+    values.emplace_back(7);
+    values.emplace_back(8);
+    values.push_back(values[0]);
+    CHECK(values.size() == 3 && values[2].is_valid(7) && values[0].is_valid(7));
+}
+
+TEST(small_vector_copy_and_move)
+{
+    TrackedValue::live_count = 0;
+    {
+        small_vector<TrackedValue, 4> inline_values = { 1, 2, 3 };
+        small_vector<TrackedValue, 4> heap_values = { 1, 2, 3, 4, 5, 6 };
+
+        small_vector<TrackedValue, 4> copy = heap_values;
+        CHECK(copy.size() == 6 && copy[5].is_valid(6));
+        copy = inline_values;
+        CHECK(copy.size() == 3 && copy[2].is_valid(3));
+
+        // Moving an inline vector relocates its elements, moving a heap vector takes its memory
+        small_vector<TrackedValue, 4> moved_inline = move(inline_values);
+        CHECK(moved_inline.is_inline() && moved_inline.size() == 3 && moved_inline[0].is_valid(1));
+        CHECK(inline_values.empty() && inline_values.is_inline());
+
+        const TrackedValue* heap_data = heap_values.data();
+        small_vector<TrackedValue, 4> moved_heap = move(heap_values);
+        CHECK(moved_heap.data() == heap_data && moved_heap.size() == 6);
+        CHECK(heap_values.empty() && heap_values.is_inline());
+
+        moved_heap = move(moved_inline);
+        CHECK(moved_heap.is_inline() && moved_heap.size() == 3 && moved_heap[1].is_valid(2));
+        CHECK(TrackedValue::live_count == 6);
+    }
+    CHECK(TrackedValue::live_count == 0);
+}
+
+TEST(small_vector_and_fixed_vector_pass_as_span)
+{
+    small_vector<u32, 4> small = { 1, 2, 3 };
+    fixed_vector<u32, 8> fixed = { 4, 5, 6 };
+    CHECK(sum_values(small) == 6);
+    CHECK(sum_values(fixed) == 15);
+
+    small.push_back(4);
+    small.push_back(5);
+    CHECK(sum_values(small) == 15);
+}
+
+TEST(fixed_vector_fills_to_capacity)
+{
+    TrackedValue::live_count = 0;
+    {
+        fixed_vector<TrackedValue, 8> values;
+        CHECK(values.capacity() == 8 && values.empty());
+        for (u32 i = 0; i < 8; ++i)
+        {
+            values.emplace_back(i);
+        }
+        CHECK(values.full() && TrackedValue::live_count == 8);
+
+        values.erase(values.begin());
+        CHECK(values.size() == 7 && values.front().is_valid(1) && values.back().is_valid(7));
+
+        fixed_vector<TrackedValue, 8> copy = values;
+        fixed_vector<TrackedValue, 8> moved = move(values);
+        CHECK(values.empty() && moved.size() == 7 && moved[3].is_valid(4));
+        CHECK(copy.size() == 7 && copy[3].is_valid(4));
+        CHECK(TrackedValue::live_count == 14);
+
+        moved.resize(2);
+        copy = moved;
+        CHECK(copy.size() == 2 && TrackedValue::live_count == 4);
+    }
+    CHECK(TrackedValue::live_count == 0);
+}
+
+// Sizes and contents of many short lists, like the sprites of glyph runs. They are made at run time from a
+// random seed, so the compiler cannot know them and fold the push_back loops of the benchmarks away.
+struct ShortLists
+{
+    vector<u32> sizes;
+    vector<u32> values; // The values of each list follow those of the previous one
+};
+
+static ShortLists make_short_lists(usz list_count, u32 min_size, u32 max_size)
+{
+    std::mt19937 random(1);
+    ShortLists result;
+    result.sizes.reserve(list_count);
+    for (usz i = 0; i < list_count; ++i)
+    {
+        u32 size = min_size + random() % (max_size - min_size + 1);
+        result.sizes.push_back(size);
+        for (u32 j = 0; j < size; ++j)
+        {
+            result.values.push_back(random());
+        }
+    }
+    return result;
+}
+
+template<typename Vector>
+static void run_short_lists_benchmark(const char* name, const ShortLists& lists)
+{
+    run_benchmark(name, lists.values.size(), [&lists] {
+        const u32* value = lists.values.data();
+        for (u32 size : lists.sizes)
+        {
+            Vector values;
+            for (u32 j = 0; j < size; ++j)
+            {
+                values.push_back(*value++);
+            }
+            do_not_optimize(values);
+        }
+    });
+}
+
+BENCHMARK(small_vector_against_vector)
+{
+    // Short lists, which is what small_vector is for. Sizes between 4 and 8 fit the inline elements.
+    ShortLists lists = make_short_lists(10000, 4, 8);
+    run_short_lists_benchmark<small_vector<u32, 8>>("small_vector<u32, 8> short lists", lists);
+    run_short_lists_benchmark<vector<u32>>("vector<u32> short lists", lists);
+    run_short_lists_benchmark<fixed_vector<u32, 8>>("fixed_vector<u32, 8> short lists", lists);
+
+    // Growing past the inline elements, where small_vector works like vector
+    static constexpr usz LONG_LIST_SIZE = 1000;
+    run_benchmark("small_vector<u32, 8> long list", LONG_LIST_SIZE, [] {
+        small_vector<u32, 8> values;
+        for (u32 j = 0; j < LONG_LIST_SIZE; ++j)
+        {
+            values.push_back(j);
+        }
+        do_not_optimize(values.back());
+    });
+
+    run_benchmark("vector<u32> long list", LONG_LIST_SIZE, [] {
+        vector<u32> values;
+        for (u32 j = 0; j < LONG_LIST_SIZE; ++j)
+        {
+            values.push_back(j);
+        }
+        do_not_optimize(values.back());
+    });
+}
@@ -0,0 +1,133 @@
+#include "test.h"
+#include "sprite_batch.h"
+#include "containers/vector.h"
+
+#include <cstring>
+#include <random>
+
+using namespace bstr;
+using namespace bstr::renderer;
+using namespace bstr::tests;
+
+static vector<SpriteDrawCmd> make_sprite_commands(usz count)
+{
+    vector<SpriteDrawCmd> result(count);
+    for (usz i = 0; i < count; ++i)
+    {
+        f32 f = (f32)i;
+        result[i].color = { f, f + 0.25f, f + 0.5f, 1 };
+        result[i].src = { f, 2 * f, 16, 16 };
+        result[i].dst = { 3 * f, 4 * f, 32, 32 };
+    }
+    return result;
+}
+
+TEST(copy_sprite_commands_to_aligned_memory)
+{
+    vector<SpriteDrawCmd> cmds = make_sprite_commands(37);
+    alignas(16) SpriteDrawCmd copied[37];
+    copy_sprite_commands(copied, cmds.data(), cmds.size());
+    CHECK(memcmp(copied, cmds.data(), sizeof(copied)) == 0);
+}
+
+TEST(copy_sprite_commands_to_unaligned_memory)
+{
+    vector<SpriteDrawCmd> cmds = make_sprite_commands(37);
+    alignas(16) u8 buffer[sizeof(SpriteDrawCmd) * 37 + 4];
+    SpriteDrawCmd* copied = (SpriteDrawCmd*)(buffer + 4);
+    copy_sprite_commands(copied, cmds.data(), cmds.size());
+    CHECK(memcmp(copied, cmds.data(), sizeof(SpriteDrawCmd) * cmds.size()) == 0);
+}
+
+TEST(copy_sprite_commands_with_offset_moves_dst_only)
+{
+    vector<SpriteDrawCmd> cmds = make_sprite_commands(5);
+    SpriteDrawCmd copied[5];
+    copy_sprite_commands_with_offset(copied, cmds.data(), cmds.size(), 10, -20);
+    for (usz i = 0; i < cmds.size(); ++i)
+    {
+        CHECK(memcmp(&copied[i].color, &cmds[i].color, sizeof(Color)) == 0);
+        CHECK(memcmp(&copied[i].src, &cmds[i].src, sizeof(Rect)) == 0);
+        CHECK(copied[i].dst.x == cmds[i].dst.x + 10 && copied[i].dst.y == cmds[i].dst.y - 20);
+        CHECK(copied[i].dst.w == cmds[i].dst.w && copied[i].dst.h == cmds[i].dst.h);
+    }
+}
+
+TEST(cull_sprite_commands_matches_rect_overlaps)
+{
+    // Rects on a coarse grid, so many of them touch the edges of the viewport exactly. Counts that are
+    // not multiples of four also go through the scalar tail.
+    std::mt19937 random(1);
+    Rect viewport = { 8, 4, 16, 12 };
+    for (u32 iteration = 0; iteration < 2000; ++iteration)
+    {
+        usz count = random() % 24;
+        vector<SpriteDrawCmd> cmds(count);
+        for (usz i = 0; i < count; ++i)
+        {
+            cmds[i].color.r = (f32)i;
+            cmds[i].dst = { (f32)(random() % 40) - 8, (f32)(random() % 32) - 8, (f32)(random() % 12), (f32)(random() % 12) };
+        }
+
+        vector<SpriteDrawCmd> expected;
+        for (const SpriteDrawCmd& cmd : cmds)
+        {
+            if (rect_overlaps(cmd.dst, viewport))
+            {
+                expected.push_back(cmd);
+            }
+        }
+
+        usz visible_count = cull_sprite_commands(cmds.data(), count, viewport);
+        CHECK(visible_count == expected.size());
+        if (visible_count == expected.size())
+        {
+            CHECK(memcmp(cmds.data(), expected.data(), visible_count * sizeof(SpriteDrawCmd)) == 0);
+        }
+    }
+}
+
+// The instance layout and conversion end_sprite_batch used before commands were recorded in the instance layout
+struct ConvertedInstance
+{
+    f32 color[4];
+    f32 src_rect[4];
+    f32 dst_rect[4];
+};
+
+static void convert_sprite_commands(ConvertedInstance* dst, const SpriteDrawCmd* src, usz count)
+{
+    for (usz i = 0; i < count; ++i)
+    {
+        dst[i].color[0] = src[i].color.r;
+        dst[i].color[1] = src[i].color.g;
+        dst[i].color[2] = src[i].color.b;
+        dst[i].color[3] = src[i].color.a;
+        dst[i].src_rect[0] = src[i].src.x;
+        dst[i].src_rect[1] = src[i].src.y;
+        dst[i].src_rect[2] = src[i].src.w;
+        dst[i].src_rect[3] = src[i].src.h;
+        dst[i].dst_rect[0] = src[i].dst.x;
+        dst[i].dst_rect[1] = src[i].dst.y;
+        dst[i].dst_rect[2] = src[i].dst.w;
+        dst[i].dst_rect[3] = src[i].dst.h;
+    }
+}
+
+BENCHMARK(sprite_command_upload)
+{
+    // One full batch. This writes ordinary cached memory, where the streaming stores of copy_sprite_commands
+    // can lose to plain stores, they pay off on the write-combined memory of a mapped buffer.
+    static constexpr usz SPRITE_COUNT = 16 * 1024;
+    vector<SpriteDrawCmd> cmds = make_sprite_commands(SPRITE_COUNT);
+    vector<ConvertedInstance> instances(SPRITE_COUNT);
+
+    run_benchmark("convert field by field (before)", SPRITE_COUNT, [&] {
+        convert_sprite_commands(instances.data(), cmds.data(), SPRITE_COUNT);
+        do_not_optimize(instances[SPRITE_COUNT - 1]);
+    });
+    run_benchmark("copy_sprite_commands", SPRITE_COUNT, [&] {
+        copy_sprite_commands((SpriteDrawCmd*)instances.data(), cmds.data(), SPRITE_COUNT);
+        do_not_optimize(instances[SPRITE_COUNT - 1]);
+    });
+}
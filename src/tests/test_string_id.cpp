@@ -0,0 +1,91 @@
+#include "test.h"
+#include "string_id.h"
+#include "containers/string.h"
+#include "containers/vector.h"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+using namespace bstr;
+using namespace bstr::core;
+using namespace bstr::tests;
+
+TEST(string_id_round_trips_through_the_interner)
+{
+    StringId id = intern_string("test_string_id/images/duck.jpg");
+    CHECK(id == "test_string_id/images/duck.jpg"_sid);
+    const char* str = find_interned_string(id);
+    CHECK(str && strcmp(str, "test_string_id/images/duck.jpg") == 0);
+
+    // Interning again finds the same copy
+    CHECK(intern_string("test_string_id/images/duck.jpg") == id);
+    CHECK(find_interned_string(id) == str);
+
+    // Ids of literals are only known once their string is interned
+    CHECK(find_interned_string("test_string_id/never interned"_sid) == nullptr);
+
+    // Only the bytes of the view are interned
+    string_view prefix = string_view("test_string_id/prefix and the rest", 21);
+    StringId prefix_id = intern_string(prefix);
+    CHECK(prefix_id == "test_string_id/prefix"_sid);
+    const char* prefix_str = find_interned_string(prefix_id);
+    CHECK(prefix_str && strcmp(prefix_str, "test_string_id/prefix") == 0);
+}
+
+TEST(string_id_interns_the_same_strings_from_many_threads)
+{
+    static constexpr u32 THREAD_COUNT = 8;
+    static constexpr u32 STRING_COUNT = 2000;
+
+    vector<string> strings;
+    for (u32 i = 0; i < STRING_COUNT; ++i)
+    {
+        strings.push_back("test_string_id/threads/" + std::to_string(i));
+    }
+
+    // Every thread interns every string, each starting at a different one, so that threads race on the same slots
+    std::atomic<u32> ready_count{};
+    std::atomic<u32> mismatch_count{};
+    vector<vector<const char*>> seen(THREAD_COUNT, vector<const char*>(STRING_COUNT));
+    vector<std::thread> threads;
+    for (u32 t = 0; t < THREAD_COUNT; ++t)
+    {
+        threads.emplace_back([&, t] {
+            ready_count.fetch_add(1);
+            while (ready_count.load() < THREAD_COUNT)
+            {
+            }
+            for (u32 i = 0; i < STRING_COUNT; ++i)
+            {
+                u32 index = (i + t * STRING_COUNT / THREAD_COUNT) % STRING_COUNT;
+                const string& str = strings[index];
+                StringId id = intern_string(str);
+                const char* interned = find_interned_string(id);
+                seen[t][index] = interned;
+                if (id != make_string_id(str.data(), str.size()) || !interned || str != interned)
+                {
+                    mismatch_count.fetch_add(1);
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(mismatch_count.load() == 0);
+
+    // Only one copy of each string was kept, whichever thread won, and every thread found that one
+    u32 shared_count = 0;
+    for (u32 i = 0; i < STRING_COUNT; ++i)
+    {
+        bool is_shared = seen[0][i] == find_interned_string(make_string_id(strings[i].data(), strings[i].size()));
+        for (u32 t = 1; t < THREAD_COUNT; ++t)
+        {
+            is_shared = is_shared && seen[t][i] == seen[0][i];
+        }
+        shared_count += is_shared ? 1 : 0;
+    }
+    CHECK(shared_count == STRING_COUNT);
+}
@@ -0,0 +1,124 @@
+#include "test.h"
+#include "utf8.h"
+#include "containers/vector.h"
+
+#include <random>
+
+using namespace bstr;
+using namespace bstr::core;
+using namespace bstr::tests;
+
+static constexpr u32 REPLACEMENT = UNICODE_REPLACEMENT_CHARACTER;
+
+static vector<u32> decode_all(string_view text)
+{
+    vector<u32> result;
+    usz index = 0;
+    while (index < text.size())
+    {
+        result.push_back(utf8_decode_next(text, &index));
+    }
+    return result;
+}
+
+// Decodes the first codepoint of the text and returns how many bytes it took
+static u32 decode_first(string_view text, usz* out_length)
+{
+    usz index = 0;
+    u32 result = utf8_decode_next(text, &index);
+    *out_length = index;
+    return result;
+}
+
+TEST(utf8_decodes_every_sequence_length)
+{
+    CHECK(decode_all("A\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80") == vector<u32>({ 'A', 0xE9, 0x20AC, 0x1F600 }));
+
+    // The first and last codepoints of every length
+    CHECK(decode_all(string_view("\x00\x7F", 2)) == vector<u32>({ 0, 0x7F }));
+    CHECK(decode_all("\xC2\x80\xDF\xBF") == vector<u32>({ 0x80, 0x7FF }));
+    CHECK(decode_all("\xE0\xA0\x80\xEF\xBF\xBF") == vector<u32>({ 0x800, 0xFFFF }));
+    CHECK(decode_all("\xF0\x90\x80\x80\xF4\x8F\xBF\xBF") == vector<u32>({ 0x10000, 0x10FFFF }));
+}
+
+TEST(utf8_rejects_overlong_encodings)
+{
+    // Each of these encodes a codepoint that fits in a shorter sequence
+    const char* overlong[] = {
+        "\xC0\x80", // U+0000 in two bytes
+        "\xC1\xBF", // U+007F in two bytes
+        "\xE0\x80\x80", // U+0000 in three bytes
+        "\xE0\x9F\xBF", // U+07FF in three bytes
+        "\xF0\x80\x80\x80", // U+0000 in four bytes
+        "\xF0\x8F\xBF\xBF", // U+FFFF in four bytes
+    };
+    for (const char* text : overlong)
+    {
+        usz length = 0;
+        CHECK(decode_first(text, &length) == REPLACEMENT);
+        CHECK(length == 1);
+    }
+}
+
+TEST(utf8_rejects_surrogates_and_values_past_the_unicode_range)
+{
+    const char* invalid[] = {
+        "\xED\xA0\x80", // U+D800, the first high surrogate
+        "\xED\xB0\x80", // U+DC00, the first low surrogate
+        "\xED\xBF\xBF", // U+DFFF, the last low surrogate
+        "\xF4\x90\x80\x80", // U+110000
+        "\xF7\xBF\xBF\xBF", // U+1FFFFF, the largest value of four bytes
+    };
+    for (const char* text : invalid)
+    {
+        usz length = 0;
+        CHECK(decode_first(text, &length) == REPLACEMENT);
+        CHECK(length == 1);
+    }
+
+    // The codepoints just outside the surrogates are fine
+    CHECK(decode_all("\xED\x9F\xBF\xEE\x80\x80") == vector<u32>({ 0xD7FF, 0xE000 }));
+}
+
+TEST(utf8_replaces_malformed_bytes_one_at_a_time)
+{
+    // A lone continuation byte, and lead bytes that no sequence starts with
+    CHECK(decode_all("\x80" "A") == vector<u32>({ REPLACEMENT, 'A' }));
+    CHECK(decode_all("\xF8\xFF" "A") == vector<u32>({ REPLACEMENT, REPLACEMENT, 'A' }));
+
+    // A sequence cut short by an ASCII byte resumes at that byte
+    CHECK(decode_all("\xC3" "A") == vector<u32>({ REPLACEMENT, 'A' }));
+    CHECK(decode_all("\xE2\x82" "A") == vector<u32>({ REPLACEMENT, REPLACEMENT, 'A' }));
+
+    // A sequence cut short by the end of the text
+    CHECK(decode_all("A\xF0\x9F\x98") == vector<u32>({ 'A', REPLACEMENT, REPLACEMENT, REPLACEMENT }));
+
+    // The end of the view is respected even when the bytes after it would complete the sequence
+    string_view truncated = string_view("\xE2\x82\xAC", 2);
+    CHECK(decode_all(truncated) == vector<u32>({ REPLACEMENT, REPLACEMENT }));
+}
+
+TEST(utf8_always_progresses_on_random_bytes)
+{
+    std::mt19937 random(1);
+    for (u32 iteration = 0; iteration < 1000; ++iteration)
+    {
+        char bytes[32];
+        usz size = random() % (sizeof(bytes) + 1);
+        for (usz i = 0; i < size; ++i)
+        {
+            // Mostly bytes above ASCII, so that multibyte sequences come up often
+            bytes[i] = (char)(random() % 4 == 0 ? random() & 0x7F : 0x80 | random());
+        }
+        string_view text(bytes, size);
+
+        usz index = 0;
+        while (index < text.size())
+        {
+            usz previous = index;
+            u32 codepoint = utf8_decode_next(text, &index);
+            CHECK(index > previous && index <= text.size());
+            CHECK(codepoint <= 0x10FFFF && !(codepoint >= 0xD800 && codepoint <= 0xDFFF));
+        }
+    }
+}